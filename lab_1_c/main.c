@@ -1,9 +1,10 @@
 /*
-* SPLPv1.c
+* main.c
 * The file is part of practical task for System programming course.
-* This file contains validation of SPLPv1 protocol.
-*
-* DON'T EDIT THIS FILE !!!
+* This file contains the test program of the SPLPv1 validator: it loads
+* test files and captures, runs the validator over them in the selected
+* mode (batch, per message, parallel, speculative or streaming) and
+* reports the wrong answers and the timings.
 */
 #define _CRT_SECURE_NO_WARNINGS
 
@@ -11,63 +12,129 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
 #include "splpv1.h"
+#include "splp_dfa.h"
+#include "splp_charclass.h"
+#include "splp_platform.h"
+#include "splptest.h"
+#include "splp_corpus.h"
+#include "splp_histogram.h"
+#include "splp_stats.h"
+#include "splp_spec.h"
+#include "splp_replay.h"
+#include "splp_sessions.h"
+#include "splp_ring.h"
+#include "splp_perf.h"
+
 
 
 
-#define SPLP_INVALID_MSG_INDEX    0xffffffff
 #define DEFAULT_CYCLE_COUNT       100
 #define DEFAULT_TEST_FILENAME     "test.txt"
+#define DEFAULT_TRIAL_COUNT       1
 
 
 
 
-typedef enum _SPLP_STATUS
+/* SPLP_TEST_STATISTICS
+* This structure holds the statistics about a test. If the test
+* completed successfully, the 'falsePositive' and 'falseNegative'
+* members of the structure are zero.
+* If there are some errors in validate_message() implementation,
+* firstWrongMsg member will contain the index of the first message
+* where expected result wasn't equal to one returned by
+* validate_message().
+* Times are measured with a monotonic clock, in nanoseconds. Messages
+* and bytes are counted with 64 bits, so long runs over big files don't
+* overflow.
+*/
+typedef struct _SPLP_TEST_STATISTICS
 {
-    SPLP_STATUS_OK,
-    SPLP_STATUS_ERROR
-} SPLP_STATUS;
+    uint64_t     truePositive;
+    uint64_t     trueNegative;
+    uint64_t     falsePositive;
+    uint64_t     falseNegative;
+    uint64_t     duration;          /* time of all trials */
+
+    uint64_t     firstWrongMsg;
+
+    uint64_t*       trialDurations; /* time of each trial */
+    PSPLP_HISTOGRAM latency;        /* latency histograms, NULL if not measured */
+    unsigned int    latencyCount;   /* amount of histograms in latency */
+    uint64_t        timerOverhead;  /* time between two back to back clock reads */
+
+    struct SplpStats counters;      /* validator counters of the measured cycles */
+    unsigned int    segmentCount;   /* parallel test: segments the messages were cut into */
+    uint64_t*       scalingDurations; /* parallel test: time of all trials by thread count */
+    uint64_t        decodedSize;    /* decode engine: B64: data decoded per cycle */
+    uint64_t        connectionCount; /* capture: connections in the file */
+    uint64_t        wrongCount;     /* capture: connections with wrong answers */
+    struct splp_connection* wrongConnections; /* capture: these connections, by ID */
+    uint64_t        storePeak;      /* capture: most sessions the store held at once */
+    uint64_t        storeMemory;    /* capture: memory of the store, in bytes */
+    uint64_t        streamBatches;  /* stream: batches of a pass over the file */
+    uint64_t        streamMemory;   /* stream: memory of the batches, in bytes */
+    struct MessageView streamWrongMsg; /* stream: copy of the first wrong message, the text is allocated */
+    enum test_status streamWrongExpected; /* stream: answer expected for it */
+    uint64_t        streamWrongConnection; /* stream: its connection, for a capture */
+    struct splp_perf hardware;      /* hardware counters of the measured cycles, for --counters */
+    uint64_t        snapshotCount;  /* capture: snapshot files written, the full one and the deltas */
+    uint64_t        snapshotBytes;  /* capture: their total size */
+    uint64_t        snapshotDuration; /* capture: time of writing them */
+    uint64_t        restoreCount;   /* capture: snapshot files a restore reads */
+    uint64_t        restoreDuration; /* capture: time of the first restore */
+    uint64_t        evictCount;     /* capture: epochs started in the measured cycles */
+    uint64_t        evictedSessions; /* capture: idle sessions removed then */
+    uint64_t        evictDuration;  /* capture: time of starting the epochs and removing them */
+    uint64_t        evictSessions[ 2 ]; /* capture: sessions before and after the last removal */
+    uint64_t        evictMemory[ 2 ]; /* capture: memory of the store before and after it */
+
+}SPLP_TEST_STATISTICS, *PSPLP_TEST_STATISTICS;
 
 
 
 
-/* SPLP_TEST_MESSAGE
-* This is a utility data structure which holds a message to evaluate
-* by validate_message() and the answer which is expected to be.
-* if the result returned by validate_message() for msg member is NOT
-* the same as  expectedTestStatus,  the function is implemented with
-* mistakes.
+/* SPLP_TEST_ENGINE
+* Validator implementation to test
 */
-typedef struct _SPLP_TEST_MESSAGE
+typedef enum _SPLP_TEST_ENGINE
 {
-    enum test_status  expectedTestStatus;  /* Correct answer */
-    struct Message    msg;                 /* Message */
-
-}SPLP_TEST_MESSAGE, *PSPLP_TEST_MESSAGE;
+    SPLP_ENGINE_SWITCH,         /* validate_message() */
+    SPLP_ENGINE_DFA,            /* automaton from splp_dfa.c */
+    SPLP_ENGINE_DECODE          /* splp_validate_view_decode(), B64: payloads are decoded too */
+} SPLP_TEST_ENGINE;
 
 
 
 
-/* SPLP_TEST_STATISTICS
-* This structure holds the statistics about a test. If the test
-* completed successfully, the 'falsePositive' and 'falseNegative'
-* members of the structure are zero.
-* If there are some errors in validate_message() implementation,
-* firstWrongMsg member will contain the index of the first message
-* where expected result wasn't equal to one returned by
-* validate_message().
+/* SPLP_LATENCY_MODE
+* What latency is measured for
 */
-typedef struct _SPLP_TEST_STATISTICS
+typedef enum _SPLP_LATENCY_MODE
 {
-    unsigned int truePositive;
-    unsigned int trueNegative;
-    unsigned int falsePositive;
-    unsigned int falseNegative;
-    clock_t      duration;
+    SPLP_LATENCY_OFF,           /* throughput only */
+    SPLP_LATENCY_MESSAGE,       /* every message, by message type */
+    SPLP_LATENCY_BATCH          /* every pass over the whole test file */
+} SPLP_LATENCY_MODE;
 
-    unsigned int firstWrongMsg;
 
-}SPLP_TEST_STATISTICS, *PSPLP_TEST_STATISTICS;
+
+
+/* SplpMessageKeywords
+* Message types latency is reported for. A message is of the type of its
+* first word, counted separately for each direction, the last entry is
+* for messages starting with anything else.
+*/
+static const char* const SplpMessageKeywords[ ] =
+{
+    "CONNECT", "CONNECT_OK", "GET_VER", "VERSION", "GET_DATA", "GET_COMMAND",
+    "GET_FILE", "GET_B64", "B64:", "DISCONNECT", "DISCONNECT_OK", "(other)"
+};
+
+#define SPLP_MSG_KEYWORD_COUNT    ( sizeof( SplpMessageKeywords ) / sizeof( SplpMessageKeywords[ 0 ] ) )
+#define SPLP_MSG_TYPE_COUNT       ( 2 * SPLP_MSG_KEYWORD_COUNT )
 
 
 
@@ -77,8 +144,25 @@ typedef struct _SPLP_TEST_STATISTICS
 */
 typedef struct _SPLP_TEST_OPTIONS
 {
-    const char*  testFileName;  /* path to the file with test messages */
-    unsigned int cycleCount;    /* how many times should the file be evaluated */
+    const char*      testFileName;  /* path to the file with test messages */
+    unsigned int     cycleCount;    /* how many times should the file be evaluated */
+    SPLP_TEST_ENGINE engine;        /* validator to evaluate */
+    const char*      convertFileName; /* if set, save messages as a binary corpus instead of testing */
+    SPLP_LATENCY_MODE latencyMode;  /* what latency is measured for */
+    unsigned int     warmupCount;   /* cycles run before measuring */
+    unsigned int     trialCount;    /* how many times should cycleCount cycles be measured */
+    unsigned int     threadCount;   /* threads of the parallel test, 0 - don't cut the messages */
+    int              scaling;       /* compare the parallel test with fewer threads */
+    int              speculative;   /* validate the messages as one stream on threadCount threads */
+    int              capture;       /* the test file is a capture of many connections */
+    int              compactStore;  /* keep the sessions of a capture in splp_sessions */
+    int              stream;        /* don't load the file, read it through a pipeline on every cycle */
+    int              perfCounters;  /* read the hardware counters during the measured cycles */
+    const char*      snapshotFileName; /* capture: save the sessions of the compact store here */
+    unsigned int     snapshotEvery; /* capture: also save them every so many messages, 0 - only at the end */
+    const char*      restoreFileName; /* capture: start every pass from the sessions saved here */
+    unsigned int     evictEvery;    /* capture: start a new epoch of the compact store every so many messages */
+    unsigned int     evictIdle;     /* capture: epochs a session may stay idle before it is removed */
 
 }SPLP_TEST_OPTIONS, *PSPLP_TEST_OPTIONS;
 
@@ -86,20 +170,108 @@ typedef struct _SPLP_TEST_OPTIONS
 
 
 /* SPLP_TEST_DATA
-* This structure contains data for a test
+* This structure contains data for a test. The answers expected from
+* validate_message() are kept as a verdict bitmap (see splpv1.h), so
+* that a whole batch of results can be checked at once. If a result
+* returned for a message is NOT the same as its expected bit, the
+* function is implemented with mistakes.
+* Messages of a text test file are kept in MessageArray. A binary
+* corpus (see splp_corpus.h) is used in place: MessageArray is NULL and
+* MessageBlock and ExpectedVerdicts point into the mapped file.
+* A capture holds the messages of many connections interleaved, every
+* line starts with the ID of its connection: "connection expected
+* direction message".
+* A streamed test file isn't loaded at all: only streamFile is open and
+* the amounts are those of the first pass over it.
 */
 typedef struct _SPLP_TEST_DATA
 {
-    PSPLP_TEST_MESSAGE   MessageArray; /* test messages to evaluate */
-    unsigned int         size;         /* amount of messages in MessageArray */
-    unsigned int         dataSize;     /* total size of test data, in bytes  */
+    struct MessageView*  MessageArray;     /* test messages to evaluate */
+    struct MessageBlock  MessageBlock;     /* test messages of a binary corpus */
+    uint64_t*            ExpectedVerdicts; /* correct answers, one bit per message */
+    uint64_t*            ConnectionIds;    /* connection of every message of a capture, NULL otherwise */
+    uint64_t             expectedValid;    /* amount of MESSAGE_VALID answers */
+    uint64_t             size;             /* amount of messages in MessageArray */
+    uint64_t             dataSize;         /* total size of test data, in bytes  */
+    void*                mappedFile;       /* file the messages point into, if mapped */
+    size_t               mappedSize;       /* size of mappedFile, in bytes */
+    FILE*                streamFile;       /* test file read by the streaming test, NULL otherwise */
 
 }SPLP_TEST_DATA, *PSPLP_TEST_DATA;
 
 
 
 
+/* SplpExpectedStatus
+* Returns the answer expected for message msgIdx
+*/
+static enum test_status SplpExpectedStatus(
+    PSPLP_TEST_DATA pData,
+    uint64_t msgIdx )
+{
+    return ( pData->ExpectedVerdicts[ msgIdx / 64 ] >> ( msgIdx % 64 ) ) & 1 ?
+        MESSAGE_VALID : MESSAGE_INVALID;
+}
+
+
+
+
+/* SplpGetMessage
+* Returns message msgIdx, wherever it is stored
+*/
+static struct MessageView SplpGetMessage(
+    PSPLP_TEST_DATA pData,
+    uint64_t msgIdx )
+{
+    struct MessageView msg;
+    const struct MessageBlock* block = &pData->MessageBlock;
+
+    if ( pData->MessageArray )
+        return pData->MessageArray[ msgIdx ];
+
+    msg.direction = ( block->directions[ msgIdx / 64 ] >> ( msgIdx % 64 ) ) & 1 ? B_TO_A : A_TO_B;
+    msg.text = block->text + block->offsets[ msgIdx ];
+    msg.length = (size_t) ( block->offsets[ msgIdx + 1 ] - block->offsets[ msgIdx ] );
+    return msg;
+}
+
+
+
+
+/* SplpGetMessageType
+* Returns the type of the message, an index into SplpMessageKeywords
+* times two plus one for B_TO_A messages
+*/
+static unsigned int SplpGetMessageType(
+    const struct MessageView* pMsg )
+{
+    size_t wordLength = 0;
+    unsigned int keyword;
+
+    while ( wordLength < pMsg->length && pMsg->text[ wordLength ] != ' ' )
+        wordLength++;
+
+    for ( keyword = 0; keyword < SPLP_MSG_KEYWORD_COUNT - 1; keyword++ )
+    {
+        if ( strlen( SplpMessageKeywords[ keyword ] ) == wordLength &&
+            0 == memcmp( SplpMessageKeywords[ keyword ], pMsg->text, wordLength ) )
+        {
+            break;
+        }
+    }
+
+    return keyword * 2 + ( pMsg->direction == B_TO_A ? 1 : 0 );
+}
+
+
+
+
 SPLP_STATUS  SplpTestDataLoadFromFile(
+    const char* fileName,
+    int capture,
+    PSPLP_TEST_DATA testData );
+
+SPLP_STATUS  SplpTestDataOpenStream(
     const char* fileName,
     PSPLP_TEST_DATA testData );
 
@@ -112,6 +284,13 @@ void SplpTestDataFree(
 
 
 
+SPLP_STATUS  SplpTestDataSaveBinary(
+    const char* fileName,
+    PSPLP_TEST_DATA testData );
+
+
+
+
 SPLP_STATUS  SplpTestOptionsInitializeFromCmdLine(
     PSPLP_TEST_OPTIONS pTestOptions,
     int argc,
@@ -133,6 +312,11 @@ void SplpDoTest(
     PSPLP_TEST_STATISTICS pStat,
     PSPLP_TEST_DATA pData );
 
+void SplpDoStreamTest(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData );
+
 
 
 
@@ -141,7 +325,48 @@ void SplpPrintUsage( )
     printf( "usage:\n"
         "\ttest                 - run test program with default values.\n"
         "\ttest filename        - run with filename default cycles.\n"
-        "\ttest filename count  - run filename count>0 iterations.\n" );
+        "\ttest filename count  - run filename count>0 iterations.\n"
+        "\toptions (after the arguments above):\n"
+        "\t  --engine=switch     - test validate_message() (default).\n"
+        "\t  --engine=dfa        - test the automaton-based validator.\n"
+        "\t  --engine=decode     - test validation with decoding of B64: data.\n"
+        "\t  --convert=output    - save filename as a binary corpus, don't test.\n"
+        "\t  --latency=message   - measure latency of every message.\n"
+        "\t  --latency=batch     - measure latency of every pass over the file.\n"
+        "\t  --warmup=n          - run n cycles before measuring.\n"
+        "\t  --trials=n          - measure count cycles n times.\n"
+        "\t  --threads=n         - cut the messages at session boundaries and\n"
+        "\t                        validate them on n threads (no --latency).\n"
+        "\t  --scaling           - also run on 1, 2, 4... threads and compare.\n"
+        "\t  --speculative       - don't cut the messages, validate them as one\n"
+        "\t                        stream speculatively on --threads threads.\n"
+        "\t  --capture           - filename is a capture, every line starts with\n"
+        "\t                        a connection ID; each connection is validated\n"
+        "\t                        with its own session.\n"
+        "\t  --store=hash        - keep the sessions of a capture in a plain hash\n"
+        "\t                        table with counters (default).\n"
+        "\t  --store=compact     - keep them packed into a byte each.\n"
+        "\t  --stream            - don't load filename, read it on every cycle\n"
+        "\t                        while validating, with bounded memory (text\n"
+        "\t                        files, no --threads or --latency).\n"
+        "\t  --snapshot=file     - capture, compact store: save the sessions to\n"
+        "\t                        file after the check before the test.\n"
+        "\t  --snapshot-every=n  - also save them after every n messages: the\n"
+        "\t                        full snapshot to file, then deltas to file.1,\n"
+        "\t                        file.2...\n"
+        "\t  --restore=file      - capture, compact store: start the check and\n"
+        "\t                        every cycle from the sessions in file and its\n"
+        "\t                        deltas, as saved by --snapshot.\n"
+        "\t  --evict-every=n     - capture, compact store: start a new epoch after\n"
+        "\t                        every n messages (rounded up to 64), removing\n"
+        "\t                        the sessions idle for longer than --evict-idle;\n"
+        "\t                        a connection which comes back after that starts\n"
+        "\t                        anew and may get wrong answers.\n"
+        "\t  --evict-idle=k      - epochs a session may stay idle, 0 to 6 (6).\n"
+        "\t  --counters          - read the CPU performance counters (cycles,\n"
+        "\t                        instructions, branch, cache and TLB misses)\n"
+        "\t                        of the measured cycles, on all threads.\n"
+        "\tfilename may be a text test file or a binary corpus, a capture is text.\n" );
 }
 
 
@@ -151,19 +376,49 @@ int main( int argc, char* argv[ ] )
 {
     SPLP_TEST_DATA       TestData = { 0 };
     SPLP_TEST_OPTIONS    TestOptions = { 0 };
-    SPLP_TEST_STATISTICS TestStatistics = { 0, 0, 0, 0, 0, SPLP_INVALID_MSG_INDEX };
+    SPLP_TEST_STATISTICS TestStatistics = { 0 };
 
 
+    TestStatistics.firstWrongMsg = SPLP_INVALID_MSG_INDEX;
+
     if ( SPLP_STATUS_OK != SplpTestOptionsInitializeFromCmdLine( &TestOptions, argc, argv ) ||
-        SPLP_STATUS_OK != SplpTestDataLoadFromFile( TestOptions.testFileName, &TestData ) )
+        SPLP_STATUS_OK != ( TestOptions.stream ?
+        SplpTestDataOpenStream( TestOptions.testFileName, &TestData ) :
+        SplpTestDataLoadFromFile( TestOptions.testFileName, TestOptions.capture, &TestData ) ) )
+    {
+        exit( 1 );
+    }
+
+    if ( TestOptions.convertFileName )
+    {
+        SPLP_STATUS status = SplpTestDataSaveBinary( TestOptions.convertFileName, &TestData );
+        SplpTestDataFree( &TestData );
+        return status == SPLP_STATUS_OK ? 0 : 1;
+    }
+
+    if ( TestOptions.engine == SPLP_ENGINE_DFA && !splp_dfa_init( ) )
     {
+        printf( "***ERROR*** Protocol tables can't be compiled\n" );
+        SplpTestDataFree( &TestData );
         exit( 1 );
     }
 
+    // a counter which doesn't open is reported with the results, the test runs anyway
+    if ( TestOptions.perfCounters )
+        splp_perf_open( &TestStatistics.hardware );
+
     SplpDoTest( &TestOptions, &TestStatistics, &TestData );
+    splp_perf_read( &TestStatistics.hardware );
 
     SplpTestResultPrint( &TestOptions, &TestStatistics, &TestData );
 
+    splp_perf_close( &TestStatistics.hardware );
+
+    free( TestStatistics.trialDurations );
+    free( TestStatistics.scalingDurations );
+    free( TestStatistics.latency );
+    free( TestStatistics.wrongConnections );
+    free( (char*) TestStatistics.streamWrongMsg.text );
     SplpTestDataFree( &TestData );
 
     return 0;
@@ -172,279 +427,3096 @@ int main( int argc, char* argv[ ] )
 
 
 
-void SplpTestResultPrint(
-    PSPLP_TEST_OPTIONS pOptions,
-    PSPLP_TEST_STATISTICS pStat,
-    PSPLP_TEST_DATA pData )
+/* SplpCompareDurations
+* qsort() comparer for trial durations
+*/
+static int SplpCompareDurations(
+    const void* left,
+    const void* right )
 {
-    printf(
-        "======================================================================\n"
-        " TEST RESULTS:\n"
-        "======================================================================\n"
-        " Test Info:\n"
-        "\tTest file:        \"%s\"\n"
-        "\tMessages in file: \t%14u\n"
-        "\tCycles:           \t%14u\n\n",
-        pOptions->testFileName,
-        pData->size,
-        pOptions->cycleCount );
+    uint64_t l = *(const uint64_t*) left;
+    uint64_t r = *(const uint64_t*) right;
 
-
-    printf(
-        " Test correctness:\n"
-        "\tTotal messages:   \t%14u\n"
-        "\tCorrect:          \t%14u\n"
-        "\tWrong:            \t%14u\n\n",
-        pOptions->cycleCount * pData->size,
-        pStat->trueNegative + pStat->truePositive,
-        pStat->falseNegative + pStat->falsePositive );
+    return l < r ? -1 : l > r;
+}
 
 
-    if ( pStat->falseNegative || pStat->falsePositive )
-    {
-        printf(
-            " First wrong answer:\n"
-            "\tMsg #:            \t%14u\n"
-            "\tDirection:        \t%14s\n"
-            "\tExpected:         \t%14s\n"
-            "\tMessage:\n\t\t\"%s\"",
-            pStat->firstWrongMsg,
-            pData->MessageArray[ pStat->firstWrongMsg ].msg.direction == A_TO_B ?
-            "A->B" : "B->A",
-            pData->MessageArray[ pStat->firstWrongMsg ].expectedTestStatus == MESSAGE_VALID ?
-            "MESSAGE_VALID" : "MESSAGE_INVALID",
-            pData->MessageArray[ pStat->firstWrongMsg ].msg.text_message );
-    }
 
 
-    printf( "\n"
-        " Performance Results:\n"
-        "\tTest cycles:      \t%14u\n"
-        "\tTotal clocks:     \t%14u\n"
-        "\tTotal time (sec): \t%14.4f\n"
-        "\t per cycle (usec):\t%14.4f (usec = 10^(-6) second)\n"
-        "\tThroughput:	     \t%14.4f Mbps\n\n",
-        pOptions->cycleCount,
-        pStat->duration,
-        (float) pStat->duration / (float) CLOCKS_PER_SEC,
+/* SplpTrialsPrint
+* Prints the spread of throughput between the trials
+*/
+static void SplpTrialsPrint(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
+{
+    double bits = (double) pData->dataSize * (double) pOptions->cycleCount * 8.0;
+    uint64_t* durations = (uint64_t*) malloc( pOptions->trialCount * sizeof( uint64_t ) );
 
-        ( pOptions->cycleCount != 0 ) ?
-        ( (float) pStat->duration * 1000000.0f / (float) CLOCKS_PER_SEC / (float) ( pOptions->cycleCount ) ) : 0,
+    if ( !durations )
+        return;
 
-        ( pStat->duration != 0 ) ?
-        (float) pData->dataSize * (float) pOptions->cycleCount * 8.0f / ( (float) ( pStat->duration ) / (float) CLOCKS_PER_SEC ) / 1024.0 / 1024.0 : 0 );
+    memcpy( durations, pStat->trialDurations, pOptions->trialCount * sizeof( uint64_t ) );
+    qsort( durations, pOptions->trialCount, sizeof( uint64_t ), SplpCompareDurations );
 
-    printf( "======================================================================\n" );
+    // the slowest trial has the lowest throughput
+    printf(
+        " Trials:           \t%14u\n"
+        "\tThroughput min:   \t%14.4f Mbps\n"
+        "\tThroughput median:\t%14.4f Mbps\n"
+        "\tThroughput max:   \t%14.4f Mbps\n\n",
+        pOptions->trialCount,
+        bits / ( (double) durations[ pOptions->trialCount - 1 ] / 1e9 ) / 1024.0 / 1024.0,
+        bits / ( (double) durations[ pOptions->trialCount / 2 ] / 1e9 ) / 1024.0 / 1024.0,
+        bits / ( (double) durations[ 0 ] / 1e9 ) / 1024.0 / 1024.0 );
+
+    free( durations );
 }
 
 
 
 
-void SplpDoTest(
+/* SplpScalingPrint
+* Prints throughput of the parallel test by thread count
+*/
+static void SplpScalingPrint(
     PSPLP_TEST_OPTIONS pOptions,
     PSPLP_TEST_STATISTICS pStat,
     PSPLP_TEST_DATA pData )
 {
-    clock_t start = clock( );
-    unsigned int cycleIdx = 0;
-    unsigned int msgIdx = 0;
-
-    for ( cycleIdx = 0; cycleIdx < pOptions->cycleCount; cycleIdx++ )
-    {
-        for ( msgIdx = 0; msgIdx < pData->size; msgIdx++ )
-        {
-            if ( validate_message( &pData->MessageArray[ msgIdx ].msg ) != pData->MessageArray[ msgIdx ].expectedTestStatus )
-            {
-                // WRONG answer
-                if ( pStat->firstWrongMsg == SPLP_INVALID_MSG_INDEX )
-                    pStat->firstWrongMsg = msgIdx;
-
-                pData->MessageArray[ msgIdx ].expectedTestStatus == MESSAGE_VALID ?
-                    pStat->falseNegative++ :
-                    pStat->falsePositive++;
-            }
-            else
-            {
-                // CORRECT answer
-                pData->MessageArray[ msgIdx ].expectedTestStatus == MESSAGE_VALID ?
-                    pStat->truePositive++ :
-                    pStat->trueNegative++;
-            }
-        }
-    }
-
-    pStat->duration = clock( ) - start;
-}
+    double bits = (double) pData->dataSize * (double) pOptions->cycleCount * (double) pOptions->trialCount * 8.0;
+    double single = 0;
+    unsigned int threadCount;
 
+    printf(
+        " Scaling (%u segments):\n"
+        "\t%-8s%18s%12s%12s\n",
+        pStat->segmentCount,
+        "Threads", "Throughput", "Speedup", "Efficiency" );
 
+    for ( threadCount = 1; threadCount <= pOptions->threadCount; threadCount++ )
+    {
+        double mbps;
 
+        if ( !pStat->scalingDurations[ threadCount ] )
+            continue;
 
-void SplpTestDataFree(
-    PSPLP_TEST_DATA testData )
-{
-    unsigned int i = 0;
+        mbps = bits / ( (double) pStat->scalingDurations[ threadCount ] / 1e9 ) / 1024.0 / 1024.0;
+        if ( threadCount == 1 )
+            single = mbps;
 
-    if ( testData->MessageArray )
-    {
-        for ( i = 0; i<testData->size; i++ )
-        {
-            free( testData->MessageArray[ i ].msg.text_message );
-        }
-        free( testData->MessageArray );
+        printf( "\t%-8u%13.4f Mbps%12.2f%11.1f%%\n",
+            threadCount,
+            mbps,
+            single ? mbps / single : 0,
+            single ? mbps / single / threadCount * 100.0 : 0 );
     }
+
+    printf( "\n" );
 }
 
 
 
 
-unsigned int SplpGetMessageCount( FILE* fInput )
+/* SplpLatencyRowPrint
+* Prints percentiles of one latency histogram
+*/
+static void SplpLatencyRowPrint(
+    const char* name,
+    const char* direction,
+    const SPLP_HISTOGRAM* pHistogram )
 {
-    unsigned int result = 0;
-    fseek( fInput, 0, SEEK_SET );
-    if ( 1 == fscanf_s( fInput, "%u", &result ) )
-        return result;
-    return 0;
+    printf( "\t%-14s%-5s%12llu%10llu%10llu%10llu%10llu%10llu\n",
+        name,
+        direction,
+        (unsigned long long) pHistogram->count,
+        (unsigned long long) SplpHistogramPercentile( pHistogram, 50.0 ),
+        (unsigned long long) SplpHistogramPercentile( pHistogram, 90.0 ),
+        (unsigned long long) SplpHistogramPercentile( pHistogram, 99.0 ),
+        (unsigned long long) SplpHistogramPercentile( pHistogram, 99.9 ),
+        (unsigned long long) pHistogram->max );
 }
 
 
 
 
-SPLP_STATUS SplpReadMessage(
-    FILE* fInput,
-    PSPLP_TEST_MESSAGE pMsg )
+/* SplpLatencyPrint
+* Prints latency percentiles by message type
+*/
+static void SplpLatencyPrint(
+    PSPLP_TEST_STATISTICS pStat )
 {
-    int direction = 0, correct = 0;
+    unsigned int type;
 
-    if ( 2 == fscanf_s( fInput, "%d\t%d\t", &correct, &direction ) )
+    printf(
+        " Latency (nsec, including %llu nsec of timer overhead):\n"
+        "\t%-19s%12s%10s%10s%10s%10s%10s\n",
+        (unsigned long long) pStat->timerOverhead,
+        "Type", "Count", "p50", "p90", "p99", "p99.9", "max" );
+
+    if ( pStat->latencyCount == 1 )
     {
-        char buffer[ 8192 ];
-        pMsg->expectedTestStatus = ( correct == 1 ) ? MESSAGE_VALID : MESSAGE_INVALID;
-        pMsg->msg.direction = ( direction == 1 ) ? B_TO_A : A_TO_B;
-        if ( fgets( buffer, sizeof( buffer ), fInput ) )
-        {
-            unsigned int size = strlen( buffer );
+        SplpLatencyRowPrint( "(batch)", "", &pStat->latency[ 0 ] );
+    }
+    else
+    {
+        SPLP_HISTOGRAM* all = (SPLP_HISTOGRAM*) calloc( 1, sizeof( SPLP_HISTOGRAM ) );
 
-            char* pStrWalker;
-            for ( pStrWalker = buffer + size - 1; pStrWalker != buffer; pStrWalker-- )
-            {
-                if ( *pStrWalker == '\n' || *pStrWalker == '\r' )
-                {
-                    *pStrWalker = 0;
-                    size--;
-                }
-            }
+        for ( type = 0; type < pStat->latencyCount; type++ )
+        {
+            if ( pStat->latency[ type ].count == 0 )
+                continue;
 
-            pMsg->msg.text_message = (char *) malloc( size + 1 );
-            if ( pMsg->msg.text_message )
-            {
-                strncpy_s( pMsg->msg.text_message, size + 1, buffer, _TRUNCATE );
-                return SPLP_STATUS_OK;
-            }
+            SplpLatencyRowPrint( SplpMessageKeywords[ type / 2 ], type % 2 ? "B->A" : "A->B",
+                &pStat->latency[ type ] );
+            if ( all )
+                SplpHistogramMerge( all, &pStat->latency[ type ] );
         }
+
+        if ( all )
+            SplpLatencyRowPrint( "(all)", "", all );
+        free( all );
     }
-    return SPLP_STATUS_ERROR;
+
+    printf( "\n" );
 }
 
 
 
-unsigned int SplpGetTotalDataSize(
-    PSPLP_TEST_MESSAGE pMessages,
-    unsigned int msgCount )
+
+/* SplpCountersPrint
+* Prints the validator counters of the measured cycles (see splp_stats.h)
+*/
+static void SplpCountersPrint(
+    PSPLP_TEST_STATISTICS pStat )
 {
+    const struct SplpStats* pCounters = &pStat->counters;
     unsigned int i;
-    unsigned int result = 0;
-    for ( i = 0; i<msgCount; i++ )
+
+    printf( " Validator counters:\n" );
+    for ( i = 1; i < 8; i++ )
+        printf( "\tState %u:          \t%14llu\n", i, (unsigned long long) pCounters->states[ i ] );
+    for ( i = 1; i < 4; i++ )
+        printf( "\tCommand %u:        \t%14llu\n", i, (unsigned long long) pCounters->commands[ i ] );
+
+    printf( "\tAccepted:\n" );
+    for ( i = 0; i < SPLP_KEYWORD_COUNT; i++ )
     {
-        result += strlen( pMessages[ i ].msg.text_message );
+        if ( pCounters->keywords[ i ] )
+            printf( "\t  %-18s\t%14llu\n", splp_stats_keyword_name( i ), (unsigned long long) pCounters->keywords[ i ] );
     }
-    return result;
+
+    printf( "\tRejected by:\n" );
+    for ( i = 0; i < SPLP_REJECT_COUNT; i++ )
+    {
+        if ( pCounters->rejects[ i ] )
+            printf( "\t  %-18s\t%14llu\n", splp_stats_reject_name( i ), (unsigned long long) pCounters->rejects[ i ] );
+    }
+
+    printf(
+        "\tScanned bytes:\n"
+        "\t  data            \t%14llu\n"
+        "\t  base64          \t%14llu\n"
+        "\t  digits          \t%14llu\n\n",
+        (unsigned long long) pCounters->class_bytes[ SPLP_STATS_CLASS_INDEX( SPLP_CLASS_DATA ) ],
+        (unsigned long long) pCounters->class_bytes[ SPLP_STATS_CLASS_INDEX( SPLP_CLASS_BASE64 ) ],
+        (unsigned long long) pCounters->class_bytes[ SPLP_STATS_CLASS_INDEX( SPLP_CLASS_DIGIT ) ] );
 }
 
 
 
 
-SPLP_STATUS  SplpTestDataLoadFromFile(
-    const char* fileName,
-    PSPLP_TEST_DATA testData )
+/* SplpHardwarePrint
+* Prints the hardware counters of the measured cycles by message and by
+* byte of the messages validated
+*/
+static void SplpHardwarePrint(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
 {
-    FILE*  fInput = 0;
-    unsigned int fileSize = 0;
-    SPLP_STATUS status = SPLP_STATUS_ERROR;
+    const struct splp_perf* pPerf = &pStat->hardware;
+    uint64_t totalCycles = (uint64_t) pOptions->cycleCount * pOptions->trialCount;
+    double messages = (double) pData->size * (double) totalCycles;
+    double bytes = (double) pData->dataSize * (double) totalCycles;
+    unsigned int event;
 
+    printf( " Hardware counters:\n" );
 
-    if ( 0 == fopen_s( &fInput, fileName, "r" ) )
+    if ( !pPerf->open )
     {
-        unsigned int msgCount = SplpGetMessageCount( fInput );
-        PSPLP_TEST_MESSAGE testMessages;
+        printf( "\tnot available:    \t%s\n\n",
+            pPerf->error == EACCES || pPerf->error == EPERM ? "not allowed, see /proc/sys/kernel/perf_event_paranoid" :
+            pPerf->error == ENOENT || pPerf->error == EOPNOTSUPP ? "the CPU (or VM) has no such counters" :
+            pPerf->error ? strerror( pPerf->error ) : "not supported on this system" );
+        return;
+    }
 
-        if ( msgCount &&
-            NULL != ( testMessages = (PSPLP_TEST_MESSAGE) calloc( msgCount, sizeof( SPLP_TEST_MESSAGE ) ) ) )
+    printf( "\t                  \t         total   per message      per byte\n" );
+    for ( event = 0; event < SPLP_PERF_EVENT_COUNT; event++ )
+    {
+        if ( !( pPerf->open & ( 1u << event ) ) )
         {
-            unsigned int messagesRead;
-
-            for ( messagesRead = 0; messagesRead < msgCount; messagesRead++ )
-            {
-                if ( SPLP_STATUS_OK != SplpReadMessage( fInput, &testMessages[ messagesRead ] ) )
-                    break;
-            }
-
-            if ( messagesRead )
-            {
-                testData->size = messagesRead;
-                testData->MessageArray = testMessages;
-                testData->dataSize = SplpGetTotalDataSize( testMessages, messagesRead );
-            }
-
-            if ( messagesRead != msgCount )
-            {
-                printf( "***WARNING*** File \"%s\" wasn't loaded completely. Loaded %u out of %u\n",
-                    fileName, messagesRead, msgCount );
-            }
-
-            if ( messagesRead != 0 )
-                status = SPLP_STATUS_OK;
+            printf( "\t  %-16s\t%14s\n", splp_perf_event_name( event ), "n/a" );
+            continue;
         }
 
-        fclose( fInput );
-    }
-    else
-    {
-        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+        printf( "\t  %-16s\t%14llu %13.3f %13.4f", splp_perf_event_name( event ),
+            (unsigned long long) pPerf->values[ event ],
+            messages ? (double) pPerf->values[ event ] / messages : 0,
+            bytes ? (double) pPerf->values[ event ] / bytes : 0 );
+
+        // the kernel shared the counter with others, the count is extrapolated
+        if ( pPerf->running[ event ] < 0.999 )
+            printf( " (counted %.0f%% of the time)", pPerf->running[ event ] * 100 );
+        printf( "\n" );
     }
 
-    return status;
+    if ( ( pPerf->open & ( 1u << SPLP_PERF_CYCLES ) ) && ( pPerf->open & ( 1u << SPLP_PERF_INSTRUCTIONS ) ) &&
+        pPerf->values[ SPLP_PERF_CYCLES ] )
+        printf( "\tInstructions/cycle:\t%14.2f\n",
+            (double) pPerf->values[ SPLP_PERF_INSTRUCTIONS ] / (double) pPerf->values[ SPLP_PERF_CYCLES ] );
+    printf( "\n" );
 }
 
 
 
 
-SPLP_STATUS  SplpTestOptionsInitializeFromCmdLine(
-    PSPLP_TEST_OPTIONS pTestOptions,
-    int argc,
-    char* argv[ ] )
+#define SPLP_REPORT_CONNECTIONS   10
+
+
+/* SplpConnectionsPrint
+* Prints the per-connection results of a capture
+*/
+static void SplpConnectionsPrint(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
 {
-    SPLP_STATUS Status = SPLP_STATUS_OK;
+    uint64_t totalCycles = (uint64_t) pOptions->cycleCount * pOptions->trialCount;
+    uint64_t i;
 
-    pTestOptions->cycleCount = DEFAULT_CYCLE_COUNT;
-    pTestOptions->testFileName = DEFAULT_TEST_FILENAME;
+    printf( " Connections:\n" );
+
+    // a streamed capture in the compact store isn't counted by connection
+    if ( !pOptions->stream || !pOptions->compactStore )
+        printf(
+            "\tConnections:      \t%14llu\n"
+            "\tMessages each:    \t%14.4f\n",
+            (unsigned long long) pStat->connectionCount,
+            pStat->connectionCount ? (double) pData->size / (double) pStat->connectionCount : 0 );
+
+    printf(
+        "\tLookups/sec:      \t%14.0f\n"
+        "\tStore:            \t%14s\n"
+        "\tPeak sessions:    \t%14llu\n"
+        "\tStore memory:     \t%14llu bytes\n"
+        "\t per session:     \t%14.2f bytes\n",
+        pStat->duration ? (double) pData->size * (double) totalCycles * 1e9 / (double) pStat->duration : 0,
+        pOptions->compactStore ? "compact" : "hash",
+        (unsigned long long) pStat->storePeak,
+        (unsigned long long) pStat->storeMemory,
+        pStat->storePeak ? (double) pStat->storeMemory / (double) pStat->storePeak : 0 );
+
+    if ( pStat->restoreCount )
+        printf(
+            "\tRestored from:    \t%14llu files\n"
+            "\t  time (msec):    \t%14.3f\n",
+            (unsigned long long) pStat->restoreCount,
+            (double) pStat->restoreDuration / 1e6 );
 
-    if ( argc > 1 )
+    if ( pStat->evictCount )
+        printf(
+            "\tEpochs:           \t%14llu\n"
+            "\t  removed:        \t%14llu sessions\n"
+            "\t  time (msec):    \t%14.3f\n"
+            "\t  per epoch (usec):\t%14.3f\n"
+            "\t  last, sessions: \t%14llu -> %llu\n"
+            "\t  last, memory:   \t%14llu -> %llu bytes\n",
+            (unsigned long long) pStat->evictCount,
+            (unsigned long long) pStat->evictedSessions,
+            (double) pStat->evictDuration / 1e6,
+            (double) pStat->evictDuration / 1e3 / (double) pStat->evictCount,
+            (unsigned long long) pStat->evictSessions[ 0 ], (unsigned long long) pStat->evictSessions[ 1 ],
+            (unsigned long long) pStat->evictMemory[ 0 ], (unsigned long long) pStat->evictMemory[ 1 ] );
+
+    if ( pStat->snapshotCount )
+        printf(
+            "\tSnapshots:        \t%14llu files\n"
+            "\t  total size:     \t%14llu bytes\n"
+            "\t  time (msec):    \t%14.3f\n",
+            (unsigned long long) pStat->snapshotCount,
+            (unsigned long long) pStat->snapshotBytes,
+            (double) pStat->snapshotDuration / 1e6 );
+
+    if ( !pOptions->stream || !pOptions->compactStore )
+        printf( "\tWrong answers in: \t%14llu\n", (unsigned long long) pStat->wrongCount );
+
+    for ( i = 0; i < pStat->wrongCount && i < SPLP_REPORT_CONNECTIONS; i++ )
     {
-        pTestOptions->testFileName = argv[ 1 ];
+        const struct splp_connection* pConnection = &pStat->wrongConnections[ i ];
+
+        printf( "\t  #%-16llu\t%llu of %llu messages wrong\n", (unsigned long long) pConnection->id,
+            (unsigned long long) pConnection->wrong, (unsigned long long) pConnection->messages );
     }
+    if ( pStat->wrongCount > SPLP_REPORT_CONNECTIONS )
+        printf( "\t  ... and %llu more\n", (unsigned long long) ( pStat->wrongCount - SPLP_REPORT_CONNECTIONS ) );
 
-    if ( argc == 3 )
-    {
-        unsigned long cycleCount = strtoul( argv[ 2 ], NULL, 0 );
-        if ( cycleCount > 0 && cycleCount < ULONG_MAX )
-        {
-            pTestOptions->cycleCount = cycleCount;
-        }
-        else
-        {
-            SplpPrintUsage( );
-            Status = SPLP_STATUS_ERROR;
-        }
+    printf( "\n" );
+}
+
+
+
+
+void SplpTestResultPrint(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
+{
+    uint64_t totalCycles = (uint64_t) pOptions->cycleCount * pOptions->trialCount;
+    double seconds = (double) pStat->duration / 1e9;
+
+    printf(
+        "======================================================================\n"
+        " TEST RESULTS:\n"
+        "======================================================================\n"
+        " Test Info:\n"
+        "\tTest file:        \"%s\"\n"
+        "\tMessages in file: \t%14llu\n"
+        "\tBytes in file:    \t%14llu\n"
+        "\tCycles:           \t%14u\n"
+        "\tEngine:           \t%14s\n\n",
+        pOptions->testFileName,
+        (unsigned long long) pData->size,
+        (unsigned long long) pData->dataSize,
+        pOptions->cycleCount,
+        pOptions->engine == SPLP_ENGINE_DFA ? "dfa" :
+        pOptions->engine == SPLP_ENGINE_DECODE ? "decode" : "switch" );
+
+    if ( pOptions->threadCount )
+        printf( "\tThreads:          \t%14u%s\n\n", pOptions->threadCount,
+            pOptions->speculative ? " (speculative)" : "" );
+
+    if ( pOptions->stream )
+        printf( "\tBatches per pass: \t%14llu\n"
+            "\tStream memory:    \t%14llu bytes\n\n",
+            (unsigned long long) pStat->streamBatches,
+            (unsigned long long) pStat->streamMemory );
+
+
+    printf(
+        " Test correctness:\n"
+        "\tTotal messages:   \t%14llu\n"
+        "\tCorrect:          \t%14llu\n"
+        "\tWrong:            \t%14llu\n\n",
+        (unsigned long long) ( totalCycles * pData->size ),
+        (unsigned long long) ( pStat->trueNegative + pStat->truePositive ),
+        (unsigned long long) ( pStat->falseNegative + pStat->falsePositive ) );
+
+
+    if ( pStat->falseNegative || pStat->falsePositive )
+    {
+        // a streamed message isn't kept, only its copy
+        struct MessageView wrongMsg = pOptions->stream ?
+            pStat->streamWrongMsg : SplpGetMessage( pData, pStat->firstWrongMsg );
+        enum test_status expected = pOptions->stream ?
+            pStat->streamWrongExpected : SplpExpectedStatus( pData, pStat->firstWrongMsg );
+
+        printf(
+            " First wrong answer:\n"
+            "\tMsg #:            \t%14llu\n",
+            (unsigned long long) pStat->firstWrongMsg );
+        if ( pOptions->capture )
+            printf( "\tConnection:       \t%14llu\n", (unsigned long long) ( pOptions->stream ?
+                pStat->streamWrongConnection : pData->ConnectionIds[ pStat->firstWrongMsg ] ) );
+        printf(
+            "\tDirection:        \t%14s\n"
+            "\tExpected:         \t%14s\n"
+            "\tMessage:\n\t\t\"%.*s\"",
+            wrongMsg.direction == A_TO_B ?
+            "A->B" : "B->A",
+            expected == MESSAGE_VALID ?
+            "MESSAGE_VALID" : "MESSAGE_INVALID",
+            (int) wrongMsg.length,
+            wrongMsg.text );
+    }
+
+
+    printf( "\n"
+        " Performance Results:\n"
+        "\tWarmup cycles:    \t%14u\n"
+        "\tTest cycles:      \t%14llu\n"
+        "\tTotal time (sec): \t%14.4f\n"
+        "\t per cycle (usec):\t%14.4f (usec = 10^(-6) second)\n"
+        "\tThroughput:	     \t%14.4f Mbps\n\n",
+        pOptions->warmupCount,
+        (unsigned long long) totalCycles,
+        seconds,
+
+        ( totalCycles != 0 ) ?
+        ( seconds * 1000000.0 / (double) totalCycles ) : 0,
+
+        ( pStat->duration != 0 ) ?
+        (double) pData->dataSize * (double) totalCycles * 8.0 / seconds / 1024.0 / 1024.0 : 0 );
+
+    if ( pOptions->engine == SPLP_ENGINE_DECODE )
+        printf( "\tDecoded per cycle:\t%14llu bytes\n\n", (unsigned long long) pStat->decodedSize );
+
+    if ( pOptions->capture )
+        SplpConnectionsPrint( pOptions, pStat, pData );
+
+    if ( pOptions->trialCount > 1 )
+        SplpTrialsPrint( pOptions, pStat, pData );
+
+    if ( pStat->latency )
+        SplpLatencyPrint( pStat );
+
+    if ( pStat->scalingDurations )
+        SplpScalingPrint( pOptions, pStat, pData );
+
+    if ( pOptions->perfCounters )
+        SplpHardwarePrint( pOptions, pStat, pData );
+
+    if ( splp_stats_enabled( ) )
+        SplpCountersPrint( pStat );
+
+    printf( "======================================================================\n" );
+}
+
+
+
+
+/* SPLP_TEST_RUN
+* State of a running test
+*/
+typedef struct _SPLP_TEST_RUN
+{
+    PSPLP_TEST_OPTIONS    pOptions;
+    PSPLP_TEST_STATISTICS pStat;
+    PSPLP_TEST_DATA       pData;
+    struct SplpSession    session;
+    uint64_t*             verdicts;     /* answers of the last cycle */
+    struct MessageView*   views;        /* messages of a binary corpus, for the speculative test */
+    unsigned char*        msgTypes;     /* type of every message, for SPLP_LATENCY_MESSAGE */
+    unsigned char*        decoded;      /* data of a B64: message, for SPLP_ENGINE_DECODE */
+    struct splp_replay    replay;       /* sessions of the connections of a capture */
+    struct splp_sessions  sessions;     /* the same sessions in the compact store, for --store=compact */
+    struct splp_sessions  restored;     /* sessions of --restore, every cycle starts with a copy of them */
+
+} SPLP_TEST_RUN, *PSPLP_TEST_RUN;
+
+
+
+
+/* SplpMeasureTimerOverhead
+* Returns the shortest time between two back to back clock reads
+*/
+static uint64_t SplpMeasureTimerOverhead( )
+{
+    uint64_t overhead = UINT64_MAX;
+    unsigned int i;
+
+    for ( i = 0; i < 1000; i++ )
+    {
+        uint64_t start = splp_clock_ns( );
+        uint64_t end = splp_clock_ns( );
+
+        if ( end - start < overhead )
+            overhead = end - start;
+    }
+
+    return overhead;
+}
+
+
+
+
+/* SplpRunMessages
+* Validates the messages one by one, recording the latency of each one
+* if 'measure' is set
+*/
+static void SplpRunMessages(
+    PSPLP_TEST_RUN pRun,
+    int measure )
+{
+    PSPLP_TEST_DATA pData = pRun->pData;
+    enum test_status ( *validateView )( struct SplpSession*, const struct MessageView* ) =
+        pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view : splp_validate_view;
+    uint64_t msgIdx;
+    uint64_t word = 0;
+
+    for ( msgIdx = 0; msgIdx < pData->size; msgIdx++ )
+    {
+        struct MessageView msg = SplpGetMessage( pData, msgIdx );
+        uint64_t start = splp_clock_ns( );
+        enum test_status status = validateView( &pRun->session, &msg );
+        uint64_t end = splp_clock_ns( );
+
+        if ( measure )
+            SplpHistogramRecord( &pRun->pStat->latency[ pRun->msgTypes[ msgIdx ] ], end - start );
+
+        word |= (uint64_t) ( status == MESSAGE_VALID ) << ( msgIdx % 64 );
+        if ( msgIdx % 64 == 63 || msgIdx + 1 == pData->size )
+        {
+            pRun->verdicts[ msgIdx / 64 ] = word;
+            word = 0;
+        }
+    }
+}
+
+
+
+
+/* SplpRunDecode
+* Validates the messages one by one, decoding the data of B64: messages
+*/
+static void SplpRunDecode(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_DATA pData = pRun->pData;
+    uint64_t msgIdx;
+    uint64_t word = 0;
+    uint64_t decodedSize = 0;
+
+    for ( msgIdx = 0; msgIdx < pData->size; msgIdx++ )
+    {
+        struct MessageView msg = SplpGetMessage( pData, msgIdx );
+        size_t length;
+        enum test_status status = splp_validate_view_decode( &pRun->session, &msg, pRun->decoded, &length );
+
+        decodedSize += length;
+        word |= (uint64_t) ( status == MESSAGE_VALID ) << ( msgIdx % 64 );
+        if ( msgIdx % 64 == 63 || msgIdx + 1 == pData->size )
+        {
+            pRun->verdicts[ msgIdx / 64 ] = word;
+            word = 0;
+        }
+    }
+
+    pRun->pStat->decodedSize = decodedSize;
+}
+
+
+
+
+/* SplpSnapshotName
+* Puts the name of snapshot index of the chain saved to fileName into
+* name, which holds strlen( fileName ) + 16 characters: the full snapshot
+* is fileName itself, delta n is "fileName.n"
+*/
+static void SplpSnapshotName(
+    char* name,
+    const char* fileName,
+    unsigned int index )
+{
+    if ( index )
+        sprintf( name, "%s.%u", fileName, index );
+    else
+        strcpy( name, fileName );
+}
+
+
+
+
+/* SplpSessionsRestore
+* Makes the restored sessions of the run from the ones saved by
+* --snapshot: maps the full snapshot and applies the deltas after it, as
+* long as there are any. Returns the amount of files read in pFiles.
+*/
+static SPLP_STATUS SplpSessionsRestore(
+    PSPLP_TEST_RUN pRun,
+    uint64_t* pFiles )
+{
+    const char* fileName = pRun->pOptions->restoreFileName;
+    char* name = (char*) malloc( strlen( fileName ) + 16 );
+    unsigned int index;
+
+    if ( !name || !splp_sessions_restore( &pRun->restored, fileName ) )
+    {
+        free( name );
+        return SPLP_STATUS_ERROR;
+    }
+
+    for ( index = 1; ; index++ )
+    {
+        FILE* file;
+
+        // the chain ends before the first delta which isn't there
+        SplpSnapshotName( name, fileName, index );
+        file = fopen( name, "rb" );
+        if ( !file )
+            break;
+        fclose( file );
+
+        if ( !splp_sessions_apply( &pRun->restored, name ) )
+        {
+            printf( "***ERROR*** Snapshot \"%s\" doesn't follow the ones before it\n", name );
+            splp_sessions_free( &pRun->restored );
+            free( name );
+            return SPLP_STATUS_ERROR;
+        }
+    }
+
+    *pFiles = index;
+    free( name );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpSessionsStart
+* Makes the compact store ready for the next cycle over the capture:
+* empty, or a copy of the sessions of --restore. It is called between the
+* measured cycles, so the hardware counters are stopped while it runs.
+*/
+static SPLP_STATUS SplpSessionsStart(
+    PSPLP_TEST_RUN pRun,
+    int measure )
+{
+    int ready = 1;
+
+    if ( !pRun->pData->ConnectionIds || !pRun->pOptions->compactStore )
+        return SPLP_STATUS_OK;
+
+    if ( measure )
+        splp_perf_disable( &pRun->pStat->hardware );
+    if ( pRun->restored.groups )
+        ready = splp_sessions_copy( &pRun->sessions, &pRun->restored );
+    else
+        splp_sessions_clear( &pRun->sessions );
+    if ( measure )
+        splp_perf_enable( &pRun->pStat->hardware );
+
+    if ( !ready )
+    {
+        printf( "***ERROR*** Not enough memory for the connections\n" );
+        return SPLP_STATUS_ERROR;
+    }
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpSessionsValidate
+* Validates count messages of the capture, from first on, with the
+* compact store. With --evict-every a new epoch starts after every so
+* many messages of the capture, which removes the sessions idle for
+* longer than --evict-idle epochs; the measured cycles count them and
+* the time it takes. first must be a multiple of 64.
+*/
+static int SplpSessionsValidate(
+    PSPLP_TEST_RUN pRun,
+    uint64_t first,
+    uint64_t count,
+    int measure )
+{
+    PSPLP_TEST_OPTIONS pOptions = pRun->pOptions;
+    PSPLP_TEST_STATISTICS pStat = pRun->pStat;
+    PSPLP_TEST_DATA pData = pRun->pData;
+    splp_view_validator validate = pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view : splp_validate_view;
+    // the verdicts of a part have to start at a word
+    uint64_t every = ( (uint64_t) pOptions->evictEvery + 63 ) / 64 * 64;
+    uint64_t end = first + count;
+    uint64_t msgIdx = first;
+
+    while ( msgIdx < end )
+    {
+        uint64_t next = pOptions->evictEvery && ( msgIdx / every + 1 ) * every < end ?
+            ( msgIdx / every + 1 ) * every : end;
+        uint64_t sessions, memory, start;
+        size_t removed;
+
+        if ( !splp_sessions_validate( &pRun->sessions, pData->MessageArray + msgIdx, pData->ConnectionIds + msgIdx,
+            (size_t) ( next - msgIdx ), pRun->verdicts + msgIdx / 64, validate ) )
+            return 0;
+        msgIdx = next;
+        if ( !pOptions->evictEvery || msgIdx % every )
+            continue;
+
+        sessions = pRun->sessions.count;
+        memory = splp_sessions_memory( &pRun->sessions );
+        start = splp_clock_ns( );
+        removed = splp_sessions_advance( &pRun->sessions, pOptions->evictIdle );
+        if ( !measure )
+            continue;
+
+        pStat->evictDuration += splp_clock_ns( ) - start;
+        pStat->evictCount++;
+        pStat->evictedSessions += removed;
+        pStat->evictSessions[ 0 ] = sessions;
+        pStat->evictSessions[ 1 ] = pRun->sessions.count;
+        pStat->evictMemory[ 0 ] = memory;
+        pStat->evictMemory[ 1 ] = splp_sessions_memory( &pRun->sessions );
+    }
+
+    return 1;
+}
+
+
+
+
+/* SplpRunCycle
+* Validates all the test messages once
+*/
+static void SplpRunCycle(
+    PSPLP_TEST_RUN pRun,
+    int measure )
+{
+    PSPLP_TEST_DATA pData = pRun->pData;
+    SPLP_LATENCY_MODE latencyMode = pRun->pOptions->latencyMode;
+    uint64_t start = 0;
+
+    if ( latencyMode == SPLP_LATENCY_MESSAGE )
+    {
+        SplpRunMessages( pRun, measure );
+        return;
+    }
+
+    if ( pRun->pOptions->speculative )
+    {
+        splp_validate_speculative( &pRun->session, pData->MessageArray ? pData->MessageArray : pRun->views,
+            (size_t) pData->size, pRun->verdicts,
+            pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view : splp_validate_view,
+            pRun->pOptions->threadCount );
+        return;
+    }
+
+    if ( latencyMode == SPLP_LATENCY_BATCH )
+        start = splp_clock_ns( );
+
+    if ( pData->ConnectionIds && pRun->pOptions->compactStore )
+    {
+        SplpSessionsValidate( pRun, 0, pData->size, measure );
+    }
+    else if ( pData->ConnectionIds )
+    {
+        splp_replay_reset( &pRun->replay );
+        splp_replay_views( &pRun->replay, pData->MessageArray, pData->ConnectionIds, (size_t) pData->size,
+            pRun->verdicts, pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view : splp_validate_view,
+            NULL );
+    }
+    else if ( pRun->pOptions->engine == SPLP_ENGINE_DECODE )
+    {
+        SplpRunDecode( pRun );
+    }
+    else if ( pData->MessageArray )
+    {
+        ( pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view_batch : splp_validate_view_batch )(
+            &pRun->session, pData->MessageArray, (size_t) pData->size, pRun->verdicts );
+    }
+    else
+    {
+        ( pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_block : splp_validate_block )(
+            &pRun->session, &pData->MessageBlock, pRun->verdicts );
+    }
+
+    if ( latencyMode == SPLP_LATENCY_BATCH && measure )
+        SplpHistogramRecord( &pRun->pStat->latency[ 0 ], splp_clock_ns( ) - start );
+}
+
+
+
+
+/* SplpCheckVerdicts
+* Compares the answers of the last cycle with the expected ones
+*/
+static void SplpCheckVerdicts(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_STATISTICS pStat = pRun->pStat;
+    PSPLP_TEST_DATA pData = pRun->pData;
+    uint64_t wordIdx = 0;
+    uint64_t wordCount = SPLP_VERDICT_WORDS( pData->size );
+    uint64_t falseNegative = 0;
+    uint64_t falsePositive = 0;
+
+    for ( wordIdx = 0; wordIdx < wordCount; wordIdx++ )
+    {
+        uint64_t expected = pData->ExpectedVerdicts[ wordIdx ];
+        uint64_t wrong = pRun->verdicts[ wordIdx ] ^ expected;
+
+        if ( wrong )
+        {
+            // WRONG answers
+            if ( pStat->firstWrongMsg == SPLP_INVALID_MSG_INDEX )
+                pStat->firstWrongMsg = wordIdx * 64 + splp_ctz64( wrong );
+
+            falseNegative += splp_popcount64( wrong & expected );
+            falsePositive += splp_popcount64( wrong & ~expected );
+        }
+    }
+
+    pStat->falseNegative += falseNegative;
+    pStat->falsePositive += falsePositive;
+    pStat->truePositive += pData->expectedValid - falseNegative;
+    pStat->trueNegative += pData->size - pData->expectedValid - falsePositive;
+}
+
+
+
+
+/* SplpCompareConnections
+* Orders connections by ID
+*/
+static int SplpCompareConnections(
+    const void* a,
+    const void* b )
+{
+    uint64_t idA = ( (const struct splp_connection*) a )->id;
+    uint64_t idB = ( (const struct splp_connection*) b )->id;
+
+    return idA < idB ? -1 : idA > idB;
+}
+
+
+
+
+/* SplpReplayCollect
+* Counts the connections of the replay and keeps the ones which got any
+* wrong answers, by ID
+*/
+static SPLP_STATUS SplpReplayCollect(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_STATISTICS pStat = pRun->pStat;
+    const struct splp_replay* pReplay = &pRun->replay;
+    size_t slot;
+
+    pStat->connectionCount = pReplay->count;
+    for ( slot = 0; slot < pReplay->capacity; slot++ )
+    {
+        if ( pReplay->slots[ slot ].used && pReplay->slots[ slot ].wrong )
+            pStat->wrongCount++;
+    }
+    if ( !pStat->wrongCount )
+        return SPLP_STATUS_OK;
+
+    pStat->wrongConnections = (struct splp_connection*) malloc( (size_t) pStat->wrongCount * sizeof( struct splp_connection ) );
+    if ( !pStat->wrongConnections )
+        return SPLP_STATUS_ERROR;
+
+    pStat->wrongCount = 0;
+    for ( slot = 0; slot < pReplay->capacity; slot++ )
+    {
+        if ( pReplay->slots[ slot ].used && pReplay->slots[ slot ].wrong )
+            pStat->wrongConnections[ pStat->wrongCount++ ] = pReplay->slots[ slot ];
+    }
+    qsort( pStat->wrongConnections, (size_t) pStat->wrongCount, sizeof( struct splp_connection ), SplpCompareConnections );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpReplayCheck
+* Replays the capture once before measuring, counting the wrong answers
+* of every connection, and keeps the connections which got any. The
+* connection table reaches its full size here, so the measured cycles
+* don't grow it.
+*/
+static SPLP_STATUS SplpReplayCheck(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_DATA pData = pRun->pData;
+
+    if ( !splp_replay_views( &pRun->replay, pData->MessageArray, pData->ConnectionIds, (size_t) pData->size,
+        pRun->verdicts, pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view : splp_validate_view,
+        pData->ExpectedVerdicts ) )
+    {
+        return SPLP_STATUS_ERROR;
+    }
+
+    return SplpReplayCollect( pRun );
+}
+
+
+
+
+/* SplpReplaySeed
+* Starts the connections of the capture in the replay with the sessions
+* restored into the compact store, so that the replay checks the same
+* answers
+*/
+static SPLP_STATUS SplpReplaySeed(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_DATA pData = pRun->pData;
+    uint64_t msgIdx;
+
+    for ( msgIdx = 0; msgIdx < pData->size; msgIdx++ )
+    {
+        struct splp_connection* pConnection = splp_replay_connection( &pRun->replay, pData->ConnectionIds[ msgIdx ] );
+
+        if ( !pConnection )
+            return SPLP_STATUS_ERROR;
+        if ( !pConnection->messages )
+            splp_sessions_get( &pRun->sessions, pData->ConnectionIds[ msgIdx ], &pConnection->session );
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpSessionsCheck
+* Validates the capture once with the compact store before measuring.
+* With --snapshot the sessions are saved at the end, and with
+* --snapshot-every also after every so many messages: the full snapshot
+* first, then the deltas.
+*/
+static SPLP_STATUS SplpSessionsCheck(
+    PSPLP_TEST_RUN pRun )
+{
+    PSPLP_TEST_OPTIONS pOptions = pRun->pOptions;
+    PSPLP_TEST_STATISTICS pStat = pRun->pStat;
+    PSPLP_TEST_DATA pData = pRun->pData;
+    // the verdicts of a part have to start at a word
+    uint64_t every = pOptions->snapshotEvery ? ( (uint64_t) pOptions->snapshotEvery + 63 ) / 64 * 64 : pData->size;
+    char* name = NULL;
+    uint64_t msgIdx;
+
+    if ( pOptions->snapshotFileName )
+    {
+        name = (char*) malloc( strlen( pOptions->snapshotFileName ) + 16 );
+        if ( !name )
+        {
+            printf( "***ERROR*** Not enough memory for the connections\n" );
+            return SPLP_STATUS_ERROR;
+        }
+    }
+
+    for ( msgIdx = 0; msgIdx < pData->size; msgIdx += every )
+    {
+        size_t count = (size_t) ( pData->size - msgIdx < every ? pData->size - msgIdx : every );
+        uint64_t start, size;
+
+        if ( !SplpSessionsValidate( pRun, msgIdx, count, 0 ) )
+        {
+            printf( "***ERROR*** Not enough memory for the connections\n" );
+            free( name );
+            return SPLP_STATUS_ERROR;
+        }
+        if ( !name )
+            continue;
+
+        SplpSnapshotName( name, pOptions->snapshotFileName, (unsigned int) pStat->snapshotCount );
+        start = splp_clock_ns( );
+        size = pStat->snapshotCount ?
+            splp_sessions_save_delta( &pRun->sessions, name ) : splp_sessions_save( &pRun->sessions, name );
+        pStat->snapshotDuration += splp_clock_ns( ) - start;
+        if ( !size )
+        {
+            printf( "***ERROR*** Snapshot \"%s\" can't be written\n", name );
+            free( name );
+            return SPLP_STATUS_ERROR;
+        }
+        pStat->snapshotCount++;
+        pStat->snapshotBytes += size;
+    }
+
+    // a delta left by an earlier run would be taken for the next one of this chain
+    if ( name )
+    {
+        SplpSnapshotName( name, pOptions->snapshotFileName, (unsigned int) pStat->snapshotCount );
+        remove( name );
+    }
+
+    free( name );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/*
+* Parallel test. Every invalid message and every DISCONNECT_OK returns
+* the protocol to the INIT state, so the test file can be cut after any
+* of them into segments which can be validated independently, each one
+* with a new session. The expected answers tell where these messages
+* are. Cycles times segments give the tasks, every worker gets a range
+* of them. A worker takes tasks from the front of its range and, when
+* the range is empty, steals from the back of the others' ranges.
+*/
+
+#define SPLP_MAX_THREADS          64
+#define SPLP_SEGMENTS_PER_THREAD  16
+#define SPLP_SEGMENT_BATCH        256
+
+
+/* SPLP_PARALLEL_RUN
+* State of a parallel test run shared by the workers
+*/
+typedef struct _SPLP_PARALLEL_RUN
+{
+    PSPLP_TEST_OPTIONS   pOptions;
+    PSPLP_TEST_DATA      pData;
+    const uint64_t*      segments;      /* first message of every segment, then pData->size */
+    unsigned int         segmentCount;
+    unsigned int         threadCount;
+    struct _SPLP_WORKER* workers;
+
+} SPLP_PARALLEL_RUN, *PSPLP_PARALLEL_RUN;
+
+
+/* SPLP_WORKER
+* A thread of a parallel test run and its part of the statistics
+*/
+typedef struct SPLP_CACHE_ALIGNED _SPLP_WORKER
+{
+    PSPLP_PARALLEL_RUN  pRun;
+    volatile uint64_t   tasks;          /* first task << 32 | end of the range */
+    unsigned int        index;
+    uint64_t            falseNegative;
+    uint64_t            falsePositive;
+    uint64_t            firstWrongMsg;
+    unsigned int        stolen;         /* tasks taken from other workers */
+    struct SplpStats    counters;       /* validator counters of the thread */
+
+} SPLP_WORKER, *PSPLP_WORKER;
+
+
+
+
+/* SplpIsSegmentStart
+* Returns non-zero if the protocol is expected to be in the INIT state
+* before message msgIdx
+*/
+static int SplpIsSegmentStart(
+    PSPLP_TEST_DATA pData,
+    uint64_t msgIdx )
+{
+    struct MessageView prev;
+
+    if ( msgIdx == 0 || SplpExpectedStatus( pData, msgIdx - 1 ) == MESSAGE_INVALID )
+        return 1;
+
+    prev = SplpGetMessage( pData, msgIdx - 1 );
+    return prev.direction == B_TO_A && prev.length == 13 && 0 == memcmp( prev.text, "DISCONNECT_OK", 13 );
+}
+
+
+
+
+/* SplpPlanSegments
+* Cuts the test messages into about segmentCount segments. Returns the
+* first message of every segment followed by pData->size, or NULL.
+*/
+static uint64_t* SplpPlanSegments(
+    PSPLP_TEST_DATA pData,
+    unsigned int segmentCount,
+    unsigned int* pCount )
+{
+    uint64_t* segments = (uint64_t*) malloc( ( segmentCount + 1 ) * sizeof( uint64_t ) );
+    uint64_t step = pData->size / segmentCount ? pData->size / segmentCount : 1;
+    unsigned int count = 0;
+    uint64_t msgIdx = 0;
+
+    if ( !segments )
+        return NULL;
+
+    while ( msgIdx < pData->size && count < segmentCount )
+    {
+        segments[ count++ ] = msgIdx;
+        msgIdx = msgIdx + step < pData->size ? msgIdx + step : pData->size;
+        while ( msgIdx < pData->size && !SplpIsSegmentStart( pData, msgIdx ) )
+            msgIdx++;
+    }
+    segments[ count ] = pData->size;
+
+    *pCount = count;
+    return segments;
+}
+
+
+
+
+/* SplpExpectedBits
+* Returns the expected answers of the 64 messages starting at msgIdx
+*/
+static uint64_t SplpExpectedBits(
+    PSPLP_TEST_DATA pData,
+    uint64_t msgIdx )
+{
+    uint64_t wordIdx = msgIdx / 64;
+    unsigned int shift = (unsigned int) ( msgIdx % 64 );
+    uint64_t bits = pData->ExpectedVerdicts[ wordIdx ] >> shift;
+
+    if ( shift && wordIdx + 1 < SPLP_VERDICT_WORDS( pData->size ) )
+        bits |= pData->ExpectedVerdicts[ wordIdx + 1 ] << ( 64 - shift );
+    return bits;
+}
+
+
+
+
+/* SplpRunSegment
+* Validates one segment starting in the INIT state
+*/
+static void SplpRunSegment(
+    PSPLP_WORKER pWorker,
+    unsigned int segmentIdx )
+{
+    PSPLP_PARALLEL_RUN pRun = pWorker->pRun;
+    PSPLP_TEST_DATA pData = pRun->pData;
+    void ( *validateBatch )( struct SplpSession*, const struct MessageView*, size_t, uint64_t* ) =
+        pRun->pOptions->engine == SPLP_ENGINE_DFA ? splp_dfa_validate_view_batch : splp_validate_view_batch;
+    struct MessageView views[ SPLP_SEGMENT_BATCH ];
+    uint64_t verdicts[ SPLP_SEGMENT_BATCH / 64 ];
+    struct SplpSession session;
+    uint64_t msgIdx = pRun->segments[ segmentIdx ];
+    uint64_t end = pRun->segments[ segmentIdx + 1 ];
+
+    splp_session_init( &session );
+
+    while ( msgIdx < end )
+    {
+        unsigned int count = end - msgIdx < SPLP_SEGMENT_BATCH ? (unsigned int) ( end - msgIdx ) : SPLP_SEGMENT_BATCH;
+        const struct MessageView* batch = pData->MessageArray + msgIdx;
+        unsigned int i;
+
+        if ( !pData->MessageArray )
+        {
+            for ( i = 0; i < count; i++ )
+                views[ i ] = SplpGetMessage( pData, msgIdx + i );
+            batch = views;
+        }
+
+        validateBatch( &session, batch, count, verdicts );
+
+        for ( i = 0; i < count; i += 64 )
+        {
+            uint64_t mask = count - i >= 64 ? ~(uint64_t) 0 : ( (uint64_t) 1 << ( count - i ) ) - 1;
+            uint64_t expected = SplpExpectedBits( pData, msgIdx + i ) & mask;
+            uint64_t wrong = ( verdicts[ i / 64 ] ^ expected ) & mask;
+
+            if ( wrong )
+            {
+                // WRONG answers
+                if ( msgIdx + i + splp_ctz64( wrong ) < pWorker->firstWrongMsg )
+                    pWorker->firstWrongMsg = msgIdx + i + splp_ctz64( wrong );
+
+                pWorker->falseNegative += splp_popcount64( wrong & expected );
+                pWorker->falsePositive += splp_popcount64( wrong & ~expected );
+            }
+        }
+
+        msgIdx += count;
+    }
+}
+
+
+
+
+/* SplpTakeTask
+* Takes a task from the front of the worker's own range, or from the
+* back of the range of another worker. Returns 0 if there are no tasks.
+*/
+static int SplpTakeTask(
+    PSPLP_WORKER pWorker,
+    unsigned int* pTask )
+{
+    PSPLP_PARALLEL_RUN pRun = pWorker->pRun;
+    unsigned int i;
+
+    for ( ;; )
+    {
+        uint64_t tasks = pWorker->tasks;
+        uint64_t first = tasks >> 32, end = tasks & 0xffffffff;
+
+        if ( first >= end )
+            break;
+        if ( tasks == splp_atomic_cas64( &pWorker->tasks, tasks, ( first + 1 ) << 32 | end ) )
+        {
+            *pTask = (unsigned int) first;
+            return 1;
+        }
+    }
+
+    for ( i = 1; i < pRun->threadCount; i++ )
+    {
+        PSPLP_WORKER pVictim = &pRun->workers[ ( pWorker->index + i ) % pRun->threadCount ];
+
+        for ( ;; )
+        {
+            uint64_t tasks = pVictim->tasks;
+            uint64_t first = tasks >> 32, end = tasks & 0xffffffff;
+
+            if ( first >= end )
+                break;
+            if ( tasks == splp_atomic_cas64( &pVictim->tasks, tasks, first << 32 | ( end - 1 ) ) )
+            {
+                *pTask = (unsigned int) ( end - 1 );
+                pWorker->stolen++;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+static splp_thread_result_t SPLP_THREAD_CALL SplpWorkerThread(
+    void* arg )
+{
+    PSPLP_WORKER pWorker = (PSPLP_WORKER) arg;
+    unsigned int task;
+
+    splp_stats_reset( );
+
+    while ( SplpTakeTask( pWorker, &task ) )
+        SplpRunSegment( pWorker, task % pWorker->pRun->segmentCount );
+
+    splp_stats_get( &pWorker->counters );
+    return 0;
+}
+
+
+
+
+/* SplpRunParallel
+* Runs cycleCount cycles on threadCount threads, adding the results to
+* pStat if it is not NULL. Returns the time it took.
+*/
+static uint64_t SplpRunParallel(
+    PSPLP_PARALLEL_RUN pRun,
+    unsigned int threadCount,
+    unsigned int cycleCount,
+    PSPLP_TEST_STATISTICS pStat )
+{
+    SPLP_WORKER workers[ SPLP_MAX_THREADS ];
+    splp_thread_t threads[ SPLP_MAX_THREADS ];
+    uint64_t taskCount = (uint64_t) cycleCount * pRun->segmentCount;
+    uint64_t falseNegative = 0, falsePositive = 0;
+    unsigned int started, i;
+    uint64_t start;
+
+    pRun->threadCount = threadCount;
+    pRun->workers = workers;
+    memset( workers, 0, sizeof( workers ) );
+    for ( i = 0; i < threadCount; i++ )
+    {
+        workers[ i ].pRun = pRun;
+        workers[ i ].index = i;
+        workers[ i ].firstWrongMsg = SPLP_INVALID_MSG_INDEX;
+        workers[ i ].tasks = ( taskCount * i / threadCount ) << 32 | ( taskCount * ( i + 1 ) / threadCount );
+    }
+
+    start = splp_clock_ns( );
+
+    // the calling thread is worker 0
+    for ( started = 1; started < threadCount; started++ )
+    {
+        if ( !splp_thread_create( &threads[ started ], SplpWorkerThread, &workers[ started ] ) )
+            break;
+    }
+    SplpWorkerThread( &workers[ 0 ] );
+    for ( i = 1; i < started; i++ )
+        splp_thread_join( threads[ i ] );
+
+    // the tasks of workers which didn't start were stolen by the others
+    start = splp_clock_ns( ) - start;
+
+    for ( i = 0; pStat && i < threadCount; i++ )
+    {
+        falseNegative += workers[ i ].falseNegative;
+        falsePositive += workers[ i ].falsePositive;
+        if ( workers[ i ].firstWrongMsg < pStat->firstWrongMsg )
+            pStat->firstWrongMsg = workers[ i ].firstWrongMsg;
+        splp_stats_add( &pStat->counters, &workers[ i ].counters );
+    }
+
+    if ( pStat )
+    {
+        pStat->falseNegative += falseNegative;
+        pStat->falsePositive += falsePositive;
+        pStat->truePositive += cycleCount * pRun->pData->expectedValid - falseNegative;
+        pStat->trueNegative += cycleCount * ( pRun->pData->size - pRun->pData->expectedValid ) - falsePositive;
+    }
+
+    return start;
+}
+
+
+
+
+/* SplpDoParallelTest
+* Same as SplpDoTest( ) on pOptions->threadCount threads. With
+* pOptions->scaling the test is also run on fewer threads for comparison.
+*/
+static void SplpDoParallelTest(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
+{
+    SPLP_PARALLEL_RUN run = { 0 };
+    uint64_t* segments;
+    unsigned int threadCount, trialIdx;
+
+    segments = SplpPlanSegments( pData, pOptions->threadCount * SPLP_SEGMENTS_PER_THREAD, &run.segmentCount );
+    pStat->trialDurations = (uint64_t*) calloc( pOptions->trialCount, sizeof( uint64_t ) );
+    if ( pOptions->scaling )
+        pStat->scalingDurations = (uint64_t*) calloc( pOptions->threadCount + 1, sizeof( uint64_t ) );
+
+    if ( !segments || !pStat->trialDurations || ( pOptions->scaling && !pStat->scalingDurations ) )
+    {
+        printf( "***ERROR*** Not enough memory for %u segments\n", pOptions->threadCount * SPLP_SEGMENTS_PER_THREAD );
+        free( segments );
+        return;
+    }
+    if ( (uint64_t) pOptions->cycleCount * run.segmentCount > 0xffffffff ||
+        (uint64_t) pOptions->warmupCount * run.segmentCount > 0xffffffff )
+    {
+        printf( "***ERROR*** Too many cycles for %u segments\n", run.segmentCount );
+        free( segments );
+        return;
+    }
+
+    run.pOptions = pOptions;
+    run.pData = pData;
+    run.segments = segments;
+    pStat->segmentCount = run.segmentCount;
+
+    if ( pOptions->warmupCount )
+        SplpRunParallel( &run, pOptions->threadCount, pOptions->warmupCount, NULL );
+
+    // 1, 2, 4 ... threads, then threadCount
+    for ( threadCount = 1; pOptions->scaling && threadCount < pOptions->threadCount; threadCount *= 2 )
+    {
+        for ( trialIdx = 0; trialIdx < pOptions->trialCount; trialIdx++ )
+            pStat->scalingDurations[ threadCount ] += SplpRunParallel( &run, threadCount, pOptions->cycleCount, NULL );
+    }
+
+    // the workers start inside and are counted too
+    splp_perf_enable( &pStat->hardware );
+    for ( trialIdx = 0; trialIdx < pOptions->trialCount; trialIdx++ )
+    {
+        pStat->trialDurations[ trialIdx ] = SplpRunParallel( &run, pOptions->threadCount, pOptions->cycleCount, pStat );
+        pStat->duration += pStat->trialDurations[ trialIdx ];
+    }
+    splp_perf_disable( &pStat->hardware );
+    if ( pStat->scalingDurations )
+        pStat->scalingDurations[ pOptions->threadCount ] = pStat->duration;
+
+    free( segments );
+}
+
+
+
+
+/* SplpTestRunFree
+* Frees what a test run has allocated
+*/
+static void SplpTestRunFree(
+    PSPLP_TEST_RUN pRun )
+{
+    free( pRun->verdicts );
+    free( pRun->msgTypes );
+    free( pRun->views );
+    free( pRun->decoded );
+    splp_replay_free( &pRun->replay );
+    splp_sessions_free( &pRun->sessions );
+    splp_sessions_free( &pRun->restored );
+}
+
+
+
+
+void SplpDoTest(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
+{
+    SPLP_TEST_RUN run = { 0 };
+    SPLP_STATUS status = SPLP_STATUS_OK;
+    unsigned int cycleIdx, trialIdx;
+    uint64_t msgIdx;
+
+    if ( pOptions->stream )
+    {
+        SplpDoStreamTest( pOptions, pStat, pData );
+        return;
+    }
+
+    if ( pOptions->threadCount && !pOptions->speculative )
+    {
+        SplpDoParallelTest( pOptions, pStat, pData );
+        return;
+    }
+
+    run.pOptions = pOptions;
+    run.pStat = pStat;
+    run.pData = pData;
+
+    run.verdicts = (uint64_t*) malloc( (size_t) SPLP_VERDICT_WORDS( pData->size ) * sizeof( uint64_t ) );
+    pStat->trialDurations = (uint64_t*) calloc( pOptions->trialCount, sizeof( uint64_t ) );
+    if ( pOptions->latencyMode != SPLP_LATENCY_OFF )
+    {
+        pStat->latencyCount = pOptions->latencyMode == SPLP_LATENCY_MESSAGE ? SPLP_MSG_TYPE_COUNT : 1;
+        pStat->latency = (PSPLP_HISTOGRAM) calloc( pStat->latencyCount, sizeof( SPLP_HISTOGRAM ) );
+        pStat->timerOverhead = SplpMeasureTimerOverhead( );
+    }
+    if ( pOptions->latencyMode == SPLP_LATENCY_MESSAGE )
+        run.msgTypes = (unsigned char*) malloc( (size_t) pData->size );
+    if ( pOptions->speculative && !pData->MessageArray )
+        run.views = (struct MessageView*) malloc( (size_t) pData->size * sizeof( struct MessageView ) );
+    if ( pOptions->engine == SPLP_ENGINE_DECODE )
+    {
+        size_t maxLength = 0;
+
+        for ( msgIdx = 0; msgIdx < pData->size; msgIdx++ )
+        {
+            struct MessageView msg = SplpGetMessage( pData, msgIdx );
+
+            if ( msg.length > maxLength )
+                maxLength = msg.length;
+        }
+        run.decoded = (unsigned char*) malloc( SPLP_BASE64_DECODED_MAX( maxLength ) + 1 );
+    }
+
+    if ( pData->ConnectionIds )
+        splp_replay_init( &run.replay, 0 );
+    if ( pData->ConnectionIds && pOptions->compactStore && !pOptions->restoreFileName )
+        splp_sessions_init( &run.sessions, 0 );
+
+    if ( !run.verdicts || !pStat->trialDurations ||
+        ( pData->ConnectionIds && !run.replay.slots ) ||
+        ( pData->ConnectionIds && pOptions->compactStore && !pOptions->restoreFileName && !run.sessions.groups ) ||
+        ( pOptions->latencyMode != SPLP_LATENCY_OFF && !pStat->latency ) ||
+        ( pOptions->latencyMode == SPLP_LATENCY_MESSAGE && !run.msgTypes ) ||
+        ( pOptions->speculative && !pData->MessageArray && !run.views ) ||
+        ( pOptions->engine == SPLP_ENGINE_DECODE && !run.decoded ) )
+    {
+        printf( "***ERROR*** Not enough memory for %llu verdicts\n", (unsigned long long) pData->size );
+        SplpTestRunFree( &run );
+        return;
+    }
+
+    for ( msgIdx = 0; run.views && msgIdx < pData->size; msgIdx++ )
+        run.views[ msgIdx ] = SplpGetMessage( pData, msgIdx );
+
+    for ( msgIdx = 0; run.msgTypes && msgIdx < pData->size; msgIdx++ )
+    {
+        struct MessageView msg = SplpGetMessage( pData, msgIdx );
+        run.msgTypes[ msgIdx ] = (unsigned char) SplpGetMessageType( &msg );
+    }
+
+    splp_session_init( &run.session );
+
+    if ( pData->ConnectionIds && pOptions->restoreFileName )
+    {
+        uint64_t start = splp_clock_ns( );
+
+        if ( SPLP_STATUS_OK != SplpSessionsRestore( &run, &pStat->restoreCount ) )
+        {
+            printf( "***ERROR*** Sessions can't be restored from \"%s\"\n", pOptions->restoreFileName );
+            SplpTestRunFree( &run );
+            return;
+        }
+        pStat->restoreDuration = splp_clock_ns( ) - start;
+
+        if ( !splp_sessions_copy( &run.sessions, &run.restored ) )
+        {
+            printf( "***ERROR*** Not enough memory for the connections\n" );
+            SplpTestRunFree( &run );
+            return;
+        }
+    }
+
+    if ( pData->ConnectionIds &&
+        ( ( pOptions->restoreFileName && SPLP_STATUS_OK != SplpReplaySeed( &run ) ) ||
+        SPLP_STATUS_OK != SplpReplayCheck( &run ) ) )
+    {
+        printf( "***ERROR*** Not enough memory for the connections\n" );
+        SplpTestRunFree( &run );
+        return;
+    }
+
+    if ( pData->ConnectionIds && pOptions->compactStore && SPLP_STATUS_OK != SplpSessionsCheck( &run ) )
+    {
+        SplpTestRunFree( &run );
+        return;
+    }
+
+    // the compact store has grown to its full size above and is measured alone
+    if ( pOptions->compactStore )
+        splp_replay_free( &run.replay );
+
+    // every cycle over a capture starts with the sessions it started with before, which isn't measured
+    for ( cycleIdx = 0; cycleIdx < pOptions->warmupCount && SPLP_STATUS_OK == status; cycleIdx++ )
+    {
+        status = SplpSessionsStart( &run, 0 );
+        if ( SPLP_STATUS_OK == status )
+            SplpRunCycle( &run, 0 );
+    }
+    splp_stats_reset( );
+    splp_perf_enable( &pStat->hardware );
+
+    for ( trialIdx = 0; trialIdx < pOptions->trialCount && SPLP_STATUS_OK == status; trialIdx++ )
+    {
+        for ( cycleIdx = 0; cycleIdx < pOptions->cycleCount; cycleIdx++ )
+        {
+            uint64_t start;
+
+            status = SplpSessionsStart( &run, 1 );
+            if ( SPLP_STATUS_OK != status )
+                break;
+
+            start = splp_clock_ns( );
+            SplpRunCycle( &run, 1 );
+            SplpCheckVerdicts( &run );
+            pStat->trialDurations[ trialIdx ] += splp_clock_ns( ) - start;
+        }
+
+        pStat->duration += pStat->trialDurations[ trialIdx ];
+    }
+    splp_perf_disable( &pStat->hardware );
+
+    if ( SPLP_STATUS_OK != status )
+    {
+        SplpTestRunFree( &run );
+        return;
+    }
+
+    if ( pData->ConnectionIds && pOptions->compactStore )
+    {
+        pStat->storePeak = run.sessions.peak;
+        pStat->storeMemory = splp_sessions_memory( &run.sessions );
+    }
+    else if ( pData->ConnectionIds )
+    {
+        pStat->storePeak = run.replay.count;
+        pStat->storeMemory = sizeof( run.replay ) + run.replay.capacity * sizeof( struct splp_connection );
+    }
+
+    splp_stats_get( &pStat->counters );
+    SplpTestRunFree( &run );
+}
+
+
+
+
+void SplpTestDataFree(
+    PSPLP_TEST_DATA testData )
+{
+    uint64_t i = 0;
+
+    if ( testData->MessageArray )
+    {
+        for ( i = 0; i<testData->size && !testData->mappedFile; i++ )
+        {
+            free( (char*) testData->MessageArray[ i ].text );
+        }
+        free( testData->MessageArray );
+        free( testData->ExpectedVerdicts );
+        free( testData->ConnectionIds );
+    }
+
+    if ( testData->mappedFile )
+    {
+        splp_unmap_file( testData->mappedFile, testData->mappedSize );
+    }
+
+    if ( testData->streamFile )
+    {
+        fclose( testData->streamFile );
+    }
+}
+
+
+
+
+/* SplpIsBlankLine
+* Returns non-zero if the line holds whitespace only
+*/
+static int SplpIsBlankLine(
+    const char* line,
+    const char* lineEnd )
+{
+    for ( ; line != lineEnd; line++ )
+    {
+        if ( *line != ' ' && *line != '\t' && *line != '\r' )
+            return 0;
+    }
+    return 1;
+}
+
+
+
+
+/* SplpParseInt
+* Parses a decimal integer at *pPos, skipping leading blanks
+*/
+static SPLP_STATUS SplpParseInt(
+    const char** pPos,
+    const char* lineEnd,
+    int64_t* pValue )
+{
+    const char* pos = *pPos;
+    int64_t sign = 1;
+    uint64_t value = 0;
+
+    while ( pos != lineEnd && ( *pos == ' ' || *pos == '\t' ) )
+        pos++;
+    if ( pos != lineEnd && ( *pos == '-' || *pos == '+' ) )
+        sign = ( *pos++ == '-' ) ? -1 : 1;
+    if ( pos == lineEnd || *pos < '0' || *pos > '9' )
+        return SPLP_STATUS_ERROR;
+    while ( pos != lineEnd && *pos >= '0' && *pos <= '9' )
+    {
+        if ( value > ( INT64_MAX - 9 ) / 10 )
+            return SPLP_STATUS_ERROR;
+        value = value * 10 + (unsigned int) ( *pos++ - '0' );
+    }
+
+    *pValue = sign * (int64_t) value;
+    *pPos = pos;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpParseMessageLine
+* Parses "expected direction message" line, or "connection expected
+* direction message" line of a capture if pConnection isn't NULL. As with
+* the fscanf() based loader, blanks before the message are skipped and
+* the message ends at the first '\r'.
+*/
+static SPLP_STATUS SplpParseMessageLine(
+    const char* line,
+    const char* lineEnd,
+    struct MessageView* pMsg,
+    enum test_status* pExpected,
+    uint64_t* pConnection )
+{
+    int64_t direction = 0, correct = 0, connection = 0;
+    const char* text;
+
+    if ( pConnection )
+    {
+        if ( SPLP_STATUS_OK != SplpParseInt( &line, lineEnd, &connection ) || connection < 0 )
+            return SPLP_STATUS_ERROR;
+        *pConnection = (uint64_t) connection;
+    }
+
+    if ( SPLP_STATUS_OK != SplpParseInt( &line, lineEnd, &correct ) ||
+        SPLP_STATUS_OK != SplpParseInt( &line, lineEnd, &direction ) )
+    {
+        return SPLP_STATUS_ERROR;
+    }
+
+    while ( line != lineEnd && ( *line == ' ' || *line == '\t' ) )
+        line++;
+    text = memchr( line, '\r', lineEnd - line );
+
+    *pExpected = ( correct == 1 ) ? MESSAGE_VALID : MESSAGE_INVALID;
+    pMsg->direction = ( direction == 1 ) ? B_TO_A : A_TO_B;
+    pMsg->text = line;
+    pMsg->length = ( text ? text : lineEnd ) - line;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+#if defined( __linux__ )
+
+/*
+* The test file is mapped into memory and the messages point straight
+* into the mapping, so loading doesn't allocate or copy anything per
+* message. The file body is split into chunks which are scanned by one
+* thread each: first every thread counts the lines of its chunk, then,
+* knowing where its messages start, it parses them into MessageArray.
+*/
+
+#define SPLP_LOAD_MAX_THREADS     64
+#define SPLP_LOAD_MIN_CHUNK       ( 1024 * 1024 )
+
+
+/* SPLP_LOAD_CHUNK
+* Part of the test file scanned by one loader thread
+*/
+typedef struct _SPLP_LOAD_CHUNK
+{
+    const char*     begin;          /* first line starting in the chunk */
+    const char*     end;            /* end of the chunk */
+    PSPLP_TEST_DATA testData;       /* where to store the messages */
+    uint64_t        msgCount;       /* amount of messages to store in total */
+    uint64_t        firstMsg;       /* index of the first message of the chunk */
+    uint64_t        lineCount;      /* non-empty lines in the chunk */
+    uint64_t        badLine;        /* index of the first malformed message */
+    uint64_t        expectedValid;  /* MESSAGE_VALID answers in the chunk */
+    uint64_t        dataSize;       /* size of the messages in the chunk */
+
+} SPLP_LOAD_CHUNK, *PSPLP_LOAD_CHUNK;
+
+
+
+
+static splp_thread_result_t SPLP_THREAD_CALL SplpCountLinesThread(
+    void* arg )
+{
+    PSPLP_LOAD_CHUNK chunk = (PSPLP_LOAD_CHUNK) arg;
+    const char* line = chunk->begin;
+
+    chunk->lineCount = 0;
+    while ( line < chunk->end )
+    {
+        const char* lineEnd = memchr( line, '\n', chunk->end - line );
+        if ( !lineEnd )
+            lineEnd = chunk->end;
+        if ( !SplpIsBlankLine( line, lineEnd ) )
+            chunk->lineCount++;
+        line = lineEnd + 1;
+    }
+    return 0;
+}
+
+
+
+
+static splp_thread_result_t SPLP_THREAD_CALL SplpParseLinesThread(
+    void* arg )
+{
+    PSPLP_LOAD_CHUNK chunk = (PSPLP_LOAD_CHUNK) arg;
+    PSPLP_TEST_DATA testData = chunk->testData;
+    const char* line = chunk->begin;
+    uint64_t msgIdx = chunk->firstMsg;
+    uint64_t expectedWord = 0;
+
+    chunk->badLine = SPLP_INVALID_MSG_INDEX;
+    chunk->expectedValid = 0;
+    chunk->dataSize = 0;
+
+    while ( line < chunk->end && msgIdx < chunk->msgCount )
+    {
+        const char* lineEnd = memchr( line, '\n', chunk->end - line );
+        if ( !lineEnd )
+            lineEnd = chunk->end;
+
+        if ( !SplpIsBlankLine( line, lineEnd ) )
+        {
+            enum test_status expected;
+
+            if ( SPLP_STATUS_OK != SplpParseMessageLine( line, lineEnd, &testData->MessageArray[ msgIdx ], &expected,
+                testData->ConnectionIds ? &testData->ConnectionIds[ msgIdx ] : NULL ) )
+            {
+                chunk->badLine = msgIdx;
+                break;
+            }
+
+            if ( expected == MESSAGE_VALID )
+            {
+                expectedWord |= (uint64_t) 1 << ( msgIdx % 64 );
+                chunk->expectedValid++;
+            }
+            chunk->dataSize += testData->MessageArray[ msgIdx ].length;
+
+            msgIdx++;
+            if ( msgIdx % 64 == 0 )
+            {
+                // words on the chunk borders are shared with the neighbours
+                splp_atomic_or64( &testData->ExpectedVerdicts[ msgIdx / 64 - 1 ], expectedWord );
+                expectedWord = 0;
+            }
+        }
+        line = lineEnd + 1;
+    }
+
+    if ( expectedWord )
+        splp_atomic_or64( &testData->ExpectedVerdicts[ msgIdx / 64 ], expectedWord );
+    return 0;
+}
+
+
+
+
+/* SplpRunLoadThreads
+* Runs proc for every chunk, in parallel
+*/
+static void SplpRunLoadThreads(
+    splp_thread_proc_t proc,
+    PSPLP_LOAD_CHUNK chunks,
+    unsigned int chunkCount )
+{
+    splp_thread_t threads[ SPLP_LOAD_MAX_THREADS ];
+    int started[ SPLP_LOAD_MAX_THREADS ];
+    unsigned int i;
+
+    for ( i = 1; i < chunkCount; i++ )
+        started[ i ] = splp_thread_create( &threads[ i ], proc, &chunks[ i ] );
+
+    proc( &chunks[ 0 ] );
+
+    for ( i = 1; i < chunkCount; i++ )
+    {
+        if ( started[ i ] )
+            splp_thread_join( threads[ i ] );
+        else
+            proc( &chunks[ i ] );
+    }
+}
+
+
+
+
+static SPLP_STATUS  SplpTestDataLoadText(
+    const char* fileName,
+    void* mapping,
+    size_t mappingSize,
+    int capture,
+    PSPLP_TEST_DATA testData )
+{
+    SPLP_LOAD_CHUNK chunks[ SPLP_LOAD_MAX_THREADS ];
+    unsigned int chunkCount, i;
+    uint64_t msgIdx, msgCount = 0, messagesRead = 0, expectedValid = 0, dataSize = 0;
+    const char *file, *body, *fileEnd;
+
+    file = (const char*) mapping;
+    fileEnd = file + mappingSize;
+
+    // the first line holds the amount of messages
+    body = memchr( file, '\n', fileEnd - file );
+    body = body ? body + 1 : fileEnd;
+    {
+        const char* pos = file;
+        int64_t count = 0;
+        if ( SPLP_STATUS_OK == SplpParseInt( &pos, body, &count ) && count > 0 )
+            msgCount = (uint64_t) count;
+    }
+
+    if ( !msgCount || msgCount > SIZE_MAX / sizeof( struct MessageView ) ||
+        NULL == ( testData->MessageArray = (struct MessageView*) calloc( (size_t) msgCount, sizeof( struct MessageView ) ) ) ||
+        NULL == ( testData->ExpectedVerdicts = (uint64_t*) calloc( (size_t) SPLP_VERDICT_WORDS( msgCount ), sizeof( uint64_t ) ) ) ||
+        ( capture && NULL == ( testData->ConnectionIds = (uint64_t*) malloc( (size_t) msgCount * sizeof( uint64_t ) ) ) ) )
+    {
+        free( testData->MessageArray );
+        free( testData->ExpectedVerdicts );
+        testData->MessageArray = NULL;
+        testData->ExpectedVerdicts = NULL;
+        splp_unmap_file( mapping, mappingSize );
+        return SPLP_STATUS_ERROR;
+    }
+
+    // split the body into chunks starting at line boundaries
+    chunkCount = splp_cpu_count( );
+    if ( chunkCount > SPLP_LOAD_MAX_THREADS )
+        chunkCount = SPLP_LOAD_MAX_THREADS;
+    if ( chunkCount > (size_t) ( fileEnd - body ) / SPLP_LOAD_MIN_CHUNK + 1 )
+        chunkCount = (unsigned int) ( ( fileEnd - body ) / SPLP_LOAD_MIN_CHUNK + 1 );
+
+    for ( i = 0; i < chunkCount; i++ )
+    {
+        const char* begin = body + ( fileEnd - body ) / chunkCount * i;
+        if ( i != 0 )
+        {
+            const char* lineEnd = memchr( begin - 1, '\n', fileEnd - begin + 1 );
+            begin = lineEnd ? lineEnd + 1 : fileEnd;
+        }
+        chunks[ i ].begin = begin;
+        chunks[ i ].testData = testData;
+        chunks[ i ].msgCount = msgCount;
+        if ( i != 0 )
+            chunks[ i - 1 ].end = begin;
+    }
+    chunks[ chunkCount - 1 ].end = fileEnd;
+
+    SplpRunLoadThreads( SplpCountLinesThread, chunks, chunkCount );
+
+    for ( i = 0; i < chunkCount; i++ )
+    {
+        chunks[ i ].firstMsg = messagesRead;
+        messagesRead += chunks[ i ].lineCount;
+    }
+    if ( messagesRead > msgCount )
+        messagesRead = msgCount;
+
+    SplpRunLoadThreads( SplpParseLinesThread, chunks, chunkCount );
+
+    // messages after a malformed one are dropped, as the fscanf() loader does
+    for ( i = 0; i < chunkCount; i++ )
+    {
+        if ( chunks[ i ].badLine != SPLP_INVALID_MSG_INDEX )
+        {
+            messagesRead = chunks[ i ].badLine;
+            break;
+        }
+        expectedValid += chunks[ i ].expectedValid;
+        dataSize += chunks[ i ].dataSize;
+    }
+    if ( i != chunkCount )
+    {
+        // recount the loaded part and clear the answers of dropped messages
+        expectedValid = 0;
+        dataSize = 0;
+        for ( msgIdx = 0; msgIdx < messagesRead; msgIdx++ )
+        {
+            expectedValid += ( testData->ExpectedVerdicts[ msgIdx / 64 ] >> ( msgIdx % 64 ) ) & 1;
+            dataSize += testData->MessageArray[ msgIdx ].length;
+        }
+        for ( msgIdx = messagesRead; msgIdx < msgCount; msgIdx++ )
+            testData->ExpectedVerdicts[ msgIdx / 64 ] &= ~( (uint64_t) 1 << ( msgIdx % 64 ) );
+    }
+
+    if ( messagesRead != msgCount )
+    {
+        printf( "***WARNING*** File \"%s\" wasn't loaded completely. Loaded %llu out of %llu\n",
+            fileName, (unsigned long long) messagesRead, (unsigned long long) msgCount );
+    }
+
+    if ( !messagesRead )
+    {
+        free( testData->MessageArray );
+        free( testData->ExpectedVerdicts );
+        free( testData->ConnectionIds );
+        testData->MessageArray = NULL;
+        testData->ExpectedVerdicts = NULL;
+        testData->ConnectionIds = NULL;
+        splp_unmap_file( mapping, mappingSize );
+        return SPLP_STATUS_ERROR;
+    }
+
+    testData->size = messagesRead;
+    testData->expectedValid = expectedValid;
+    testData->dataSize = dataSize;
+    testData->mappedFile = mapping;
+    testData->mappedSize = mappingSize;
+    return SPLP_STATUS_OK;
+}
+
+#else /* !__linux__ */
+
+uint64_t SplpGetMessageCount( FILE* fInput )
+{
+    unsigned long long result = 0;
+    fseek( fInput, 0, SEEK_SET );
+    if ( 1 == fscanf_s( fInput, "%llu", &result ) )
+        return result;
+    return 0;
+}
+
+
+
+
+SPLP_STATUS SplpReadMessage(
+    FILE* fInput,
+    struct MessageView* pMsg,
+    enum test_status* pExpected,
+    uint64_t* pConnection )
+{
+    int direction = 0, correct = 0;
+    unsigned long long connection = 0;
+
+    // a capture line starts with the connection ID
+    if ( pConnection && 1 != fscanf_s( fInput, "%llu", &connection ) )
+        return SPLP_STATUS_ERROR;
+    if ( pConnection )
+        *pConnection = connection;
+
+    if ( 2 == fscanf_s( fInput, "%d\t%d\t", &correct, &direction ) )
+    {
+        size_t capacity = 256;
+        size_t size = 0;
+        char* text = (char*) malloc( capacity );
+        int c = EOF;
+
+        *pExpected = ( correct == 1 ) ? MESSAGE_VALID : MESSAGE_INVALID;
+        pMsg->direction = ( direction == 1 ) ? B_TO_A : A_TO_B;
+
+        // the line may be of any length, the buffer grows twice at a time
+        while ( text && EOF != ( c = getc( fInput ) ) && c != '\n' )
+        {
+            if ( size + 1 == capacity )
+            {
+                char* grown = capacity <= SIZE_MAX / 2 ? (char*) realloc( text, capacity * 2 ) : NULL;
+                if ( !grown )
+                {
+                    free( text );
+                    return SPLP_STATUS_ERROR;
+                }
+                text = grown;
+                capacity *= 2;
+            }
+            text[ size++ ] = (char) c;
+        }
+
+        if ( text && ( size || c == '\n' ) )
+        {
+            // the message ends at the first '\r', as with the mapped loader
+            char* cr = (char*) memchr( text, '\r', size );
+            if ( cr )
+                size = cr - text;
+            text[ size ] = 0;
+            pMsg->text = text;
+            pMsg->length = size;
+            return SPLP_STATUS_OK;
+        }
+        free( text );
+    }
+    return SPLP_STATUS_ERROR;
+}
+
+
+
+uint64_t SplpGetTotalDataSize(
+    struct MessageView* pMessages,
+    uint64_t msgCount )
+{
+    uint64_t i;
+    uint64_t result = 0;
+    for ( i = 0; i<msgCount; i++ )
+    {
+        result += pMessages[ i ].length;
+    }
+    return result;
+}
+
+
+
+
+static SPLP_STATUS  SplpTestDataLoadText(
+    const char* fileName,
+    void* mapping,
+    size_t mappingSize,
+    int capture,
+    PSPLP_TEST_DATA testData )
+{
+    FILE*  fInput = 0;
+    SPLP_STATUS status = SPLP_STATUS_ERROR;
+
+    /* the stream reader below doesn't use the mapping */
+    splp_unmap_file( mapping, mappingSize );
+
+    if ( 0 == fopen_s( &fInput, fileName, "r" ) )
+    {
+        uint64_t msgCount = SplpGetMessageCount( fInput );
+        struct MessageView* testMessages = NULL;
+        uint64_t* expectedVerdicts = NULL;
+        uint64_t* connectionIds = NULL;
+
+        if ( msgCount && msgCount <= SIZE_MAX / sizeof( struct MessageView ) &&
+            NULL != ( testMessages = (struct MessageView*) calloc( (size_t) msgCount, sizeof( struct MessageView ) ) ) &&
+            NULL != ( expectedVerdicts = (uint64_t*) calloc( (size_t) SPLP_VERDICT_WORDS( msgCount ), sizeof( uint64_t ) ) ) &&
+            ( !capture || NULL != ( connectionIds = (uint64_t*) malloc( (size_t) msgCount * sizeof( uint64_t ) ) ) ) )
+        {
+            uint64_t messagesRead;
+            uint64_t expectedValid = 0;
+
+            for ( messagesRead = 0; messagesRead < msgCount; messagesRead++ )
+            {
+                enum test_status expected;
+
+                if ( SPLP_STATUS_OK != SplpReadMessage( fInput, &testMessages[ messagesRead ], &expected,
+                    connectionIds ? &connectionIds[ messagesRead ] : NULL ) )
+                    break;
+
+                if ( expected == MESSAGE_VALID )
+                {
+                    expectedVerdicts[ messagesRead / 64 ] |= (uint64_t) 1 << ( messagesRead % 64 );
+                    expectedValid++;
+                }
+            }
+
+            if ( messagesRead )
+            {
+                testData->size = messagesRead;
+                testData->MessageArray = testMessages;
+                testData->ExpectedVerdicts = expectedVerdicts;
+                testData->ConnectionIds = connectionIds;
+                testData->expectedValid = expectedValid;
+                testData->dataSize = SplpGetTotalDataSize( testMessages, messagesRead );
+            }
+            else
+            {
+                free( testMessages );
+                free( expectedVerdicts );
+                free( connectionIds );
+            }
+
+            if ( messagesRead != msgCount )
+            {
+                printf( "***WARNING*** File \"%s\" wasn't loaded completely. Loaded %llu out of %llu\n",
+                    fileName, (unsigned long long) messagesRead, (unsigned long long) msgCount );
+            }
+
+            if ( messagesRead != 0 )
+                status = SPLP_STATUS_OK;
+        }
+        else
+        {
+            free( testMessages );
+            free( expectedVerdicts );
+        }
+
+        fclose( fInput );
+    }
+    else
+    {
+        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+    }
+
+    return status;
+}
+
+
+
+
+#endif /* !__linux__ */
+
+
+
+
+/* SplpTestDataLoadBinary
+* Uses a mapped binary corpus in place
+*/
+static SPLP_STATUS  SplpTestDataLoadBinary(
+    const char* fileName,
+    void* mapping,
+    size_t mappingSize,
+    PSPLP_TEST_DATA testData )
+{
+    SPLP_CORPUS corpus;
+
+    if ( SPLP_STATUS_OK != SplpCorpusAttach( &corpus, mapping, mappingSize ) ||
+        corpus.header->messageCount >= SPLP_INVALID_MSG_INDEX ||
+        corpus.header->messageCount > SIZE_MAX / sizeof( struct MessageView ) )
+    {
+        printf( "***ERROR*** File \"%s\" is not a valid binary corpus\n", fileName );
+        splp_unmap_file( mapping, mappingSize );
+        return SPLP_STATUS_ERROR;
+    }
+
+    testData->MessageArray = NULL;
+    testData->MessageBlock = corpus.block;
+    testData->ExpectedVerdicts = (uint64_t*) corpus.expected;
+    testData->expectedValid = corpus.header->expectedValid;
+    testData->size = corpus.header->messageCount;
+    testData->dataSize = corpus.header->textSize;
+    testData->mappedFile = mapping;
+    testData->mappedSize = mappingSize;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+SPLP_STATUS  SplpTestDataLoadFromFile(
+    const char* fileName,
+    int capture,
+    PSPLP_TEST_DATA testData )
+{
+    size_t mappingSize = 0;
+    void* mapping = splp_map_file( fileName, &mappingSize );
+
+    if ( mapping && SplpCorpusIsBinary( mapping, mappingSize ) )
+    {
+        if ( capture )
+        {
+            // a binary corpus has no connection IDs
+            printf( "***ERROR*** File \"%s\" is a binary corpus, not a capture\n", fileName );
+            splp_unmap_file( mapping, mappingSize );
+            return SPLP_STATUS_ERROR;
+        }
+        return SplpTestDataLoadBinary( fileName, mapping, mappingSize, testData );
+    }
+
+    if ( !mapping )
+    {
+        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    return SplpTestDataLoadText( fileName, mapping, mappingSize, capture, testData );
+}
+
+
+
+
+SPLP_STATUS  SplpTestDataSaveBinary(
+    const char* fileName,
+    PSPLP_TEST_DATA testData )
+{
+    SPLP_CORPUS_WRITER writer;
+    uint64_t msgIdx;
+
+    if ( SPLP_STATUS_OK != SplpCorpusWriterOpen( &writer, fileName ) )
+        return SPLP_STATUS_ERROR;
+
+    for ( msgIdx = 0; msgIdx < testData->size; msgIdx++ )
+    {
+        struct MessageView msg = SplpGetMessage( testData, msgIdx );
+        SplpCorpusWriterAdd( &writer, &msg, SplpExpectedStatus( testData, msgIdx ) );
+    }
+
+    if ( SPLP_STATUS_OK != SplpCorpusWriterClose( &writer ) )
+    {
+        printf( "***ERROR*** File \"%s\" can't be written\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    printf( "Saved %llu messages to \"%s\"\n", (unsigned long long) testData->size, fileName );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/*
+* Streaming test. The test file isn't loaded: on every cycle a reader
+* thread reads it block by block into batches and parses the messages of
+* each batch, the validator takes the batches in order, and a statistics
+* thread checks their answers and gives them back to the reader. The
+* stages pass the batches over single producer, single consumer rings,
+* so reading, validation and checking of different batches overlap. The
+* batches are taken from a fixed pool, so memory doesn't depend on the
+* size of the file, and nothing is allocated in the steady state: a batch
+* only grows to hold the longest line seen, and keeps that size.
+*/
+
+#define SPLP_STREAM_BATCHES       8
+#define SPLP_STREAM_BATCH_SIZE    ( 1024 * 1024 )   /* text of a batch at first */
+#define SPLP_STREAM_BATCH_MESSAGES ( 64 * 1024 )
+#define SPLP_STREAM_SPINS         1000              /* polls of an empty ring before yielding */
+
+
+/* SPLP_STREAM_BATCH
+* Lines of the test file and the messages parsed from them
+*/
+typedef struct _SPLP_STREAM_BATCH
+{
+    char*               text;           /* the lines, the messages point into it */
+    size_t              textCapacity;
+    uint64_t            count;          /* messages in the batch */
+    uint64_t            firstMsg;       /* index of the first one in the file */
+    uint64_t            expectedValid;  /* MESSAGE_VALID answers in the batch */
+    int                 last;           /* the last batch of the pass */
+    struct MessageView  views[ SPLP_STREAM_BATCH_MESSAGES ];
+    uint64_t            connections[ SPLP_STREAM_BATCH_MESSAGES ]; /* capture: connection of every message */
+    uint64_t            expected[ SPLP_VERDICT_WORDS( SPLP_STREAM_BATCH_MESSAGES ) ];
+    uint64_t            verdicts[ SPLP_VERDICT_WORDS( SPLP_STREAM_BATCH_MESSAGES ) ];
+
+} SPLP_STREAM_BATCH, *PSPLP_STREAM_BATCH;
+
+
+
+
+/* SPLP_STREAM
+* The pipeline of a streaming test
+*/
+typedef struct _SPLP_STREAM
+{
+    PSPLP_TEST_RUN      pRun;
+    struct splp_ring    loaded;         /* reader -> validator */
+    struct splp_ring    validated;      /* validator -> statistics */
+    struct splp_ring    free;           /* statistics -> reader */
+    PSPLP_STREAM_BATCH  batches[ SPLP_STREAM_BATCHES ];
+    int                 measure;        /* check the answers of the pass */
+
+    // reader
+    char*               carry;          /* start of a line which didn't fit into the last batch */
+    size_t              carrySize;
+    size_t              carryCapacity;
+    uint64_t            msgCount;       /* amount of messages the file starts with */
+    uint64_t            messagesRead;
+    uint64_t            dataSize;
+    int                 stopped;        /* a malformed line or msgCount messages were read */
+    int                 readFailed;
+    int                 readNoMemory;
+
+    // validator
+    int                 validateNoMemory;
+
+    // statistics
+    uint64_t            batchCount;
+
+} SPLP_STREAM, *PSPLP_STREAM;
+
+
+
+
+/* SplpStreamTake
+* Takes the next batch from the ring, waiting for it
+*/
+static PSPLP_STREAM_BATCH SplpStreamTake(
+    struct splp_ring* pRing )
+{
+    unsigned int spins = 0;
+    void* item;
+
+    while ( NULL == ( item = splp_ring_pop( pRing ) ) )
+    {
+        if ( ++spins > SPLP_STREAM_SPINS )
+            splp_thread_yield( );
+    }
+    return (PSPLP_STREAM_BATCH) item;
+}
+
+
+
+
+/* SplpStreamPut
+* Puts the batch into the ring. Every ring has room for all the
+* batches, so this waits only if the ring is shared wrongly.
+*/
+static void SplpStreamPut(
+    struct splp_ring* pRing,
+    PSPLP_STREAM_BATCH pBatch )
+{
+    while ( !splp_ring_push( pRing, pBatch ) )
+        splp_thread_yield( );
+}
+
+
+
+
+/* SplpStreamGrow
+* Makes the buffer hold at least size bytes, doubling it
+*/
+static SPLP_STATUS SplpStreamGrow(
+    char** pBuffer,
+    size_t* pCapacity,
+    size_t size )
+{
+    size_t capacity = *pCapacity ? *pCapacity : SPLP_STREAM_BATCH_SIZE;
+    char* grown;
+
+    while ( capacity < size )
+    {
+        if ( capacity > SIZE_MAX / 2 )
+            return SPLP_STATUS_ERROR;
+        capacity *= 2;
+    }
+    if ( capacity == *pCapacity )
+        return SPLP_STATUS_OK;
+
+    grown = (char*) realloc( *pBuffer, capacity );
+    if ( !grown )
+        return SPLP_STATUS_ERROR;
+    *pBuffer = grown;
+    *pCapacity = capacity;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpStreamParse
+* Parses the whole lines of text into the batch while it has room,
+* returns where it stopped. At the end of the file the last line needs
+* no '\n'.
+*/
+static const char* SplpStreamParse(
+    PSPLP_STREAM pStream,
+    PSPLP_STREAM_BATCH pBatch,
+    const char* line,
+    const char* end,
+    int eof )
+{
+    int capture = pStream->pRun->pOptions->capture;
+
+    while ( line < end && pBatch->count < SPLP_STREAM_BATCH_MESSAGES )
+    {
+        const char* lineEnd = memchr( line, '\n', end - line );
+
+        if ( !lineEnd && !eof )
+            break;
+        if ( !lineEnd )
+            lineEnd = end;
+
+        if ( !SplpIsBlankLine( line, lineEnd ) )
+        {
+            uint64_t msgIdx = pBatch->count;
+            enum test_status expected;
+
+            // lines after the amount of messages or after a malformed one aren't messages, as with the loader
+            if ( pStream->messagesRead == pStream->msgCount ||
+                SPLP_STATUS_OK != SplpParseMessageLine( line, lineEnd, &pBatch->views[ msgIdx ], &expected,
+                capture ? &pBatch->connections[ msgIdx ] : NULL ) )
+            {
+                pStream->stopped = 1;
+                break;
+            }
+
+            if ( expected == MESSAGE_VALID )
+            {
+                pBatch->expected[ msgIdx / 64 ] |= (uint64_t) 1 << ( msgIdx % 64 );
+                pBatch->expectedValid++;
+            }
+            pStream->dataSize += pBatch->views[ msgIdx ].length;
+            pStream->messagesRead++;
+            pBatch->count++;
+        }
+        line = lineEnd == end ? end : lineEnd + 1;
+    }
+
+    return line;
+}
+
+
+
+
+/* SplpStreamReaderThread
+* First stage: reads the test file into batches
+*/
+static splp_thread_result_t SPLP_THREAD_CALL SplpStreamReaderThread(
+    void* arg )
+{
+    PSPLP_STREAM pStream = (PSPLP_STREAM) arg;
+    FILE* file = pStream->pRun->pData->streamFile;
+    int eof = 0;
+    int last = 0;
+
+    while ( !last )
+    {
+        PSPLP_STREAM_BATCH pBatch = SplpStreamTake( &pStream->free );
+        const char* line = NULL;
+        const char* end = NULL;
+        size_t size;
+
+        pBatch->count = 0;
+        pBatch->firstMsg = pStream->messagesRead;
+        pBatch->expectedValid = 0;
+        memset( pBatch->expected, 0, sizeof( pBatch->expected ) );
+
+        // the unfinished line of the last batch goes first
+        if ( SPLP_STATUS_OK != SplpStreamGrow( &pBatch->text, &pBatch->textCapacity, pStream->carrySize ) )
+        {
+            pStream->readNoMemory = 1;
+            pBatch->last = 1;
+            SplpStreamPut( &pStream->loaded, pBatch );
+            break;
+        }
+        memcpy( pBatch->text, pStream->carry, pStream->carrySize );
+        size = pStream->carrySize;
+        pStream->carrySize = 0;
+
+        for ( ;; )
+        {
+            if ( !eof && size < pBatch->textCapacity )
+            {
+                size_t wanted = pBatch->textCapacity - size;
+                size_t got = fread( pBatch->text + size, 1, wanted, file );
+
+                size += got;
+                if ( got < wanted )
+                {
+                    eof = 1;
+                    pStream->readFailed = ferror( file ) != 0;
+                }
+            }
+
+            end = pBatch->text + size;
+            line = SplpStreamParse( pStream, pBatch, pBatch->text, end, eof );
+            if ( line != pBatch->text || eof || pStream->stopped )
+                break;
+
+            // not a single line fits, the batch grows to hold it
+            if ( SPLP_STATUS_OK != SplpStreamGrow( &pBatch->text, &pBatch->textCapacity, pBatch->textCapacity + 1 ) )
+            {
+                pStream->readNoMemory = 1;
+                break;
+            }
+        }
+
+        last = pStream->stopped || pStream->readFailed || pStream->readNoMemory || ( eof && line == end );
+        if ( !last )
+        {
+            if ( SPLP_STATUS_OK == SplpStreamGrow( &pStream->carry, &pStream->carryCapacity, end - line ) )
+            {
+                pStream->carrySize = end - line;
+                memcpy( pStream->carry, line, pStream->carrySize );
+            }
+            else
+            {
+                pStream->readNoMemory = 1;
+                last = 1;
+            }
+        }
+
+        pBatch->last = last;
+        SplpStreamPut( &pStream->loaded, pBatch );
+    }
+
+    return 0;
+}
+
+
+
+
+/* SplpStreamCheckBatch
+* Compares the answers of the batch with the expected ones, keeping a
+* copy of the first wrong message
+*/
+static void SplpStreamCheckBatch(
+    PSPLP_STREAM pStream,
+    PSPLP_STREAM_BATCH pBatch )
+{
+    PSPLP_TEST_STATISTICS pStat = pStream->pRun->pStat;
+    uint64_t wordIdx;
+    uint64_t falseNegative = 0;
+    uint64_t falsePositive = 0;
+
+    for ( wordIdx = 0; wordIdx < SPLP_VERDICT_WORDS( pBatch->count ); wordIdx++ )
+    {
+        uint64_t expected = pBatch->expected[ wordIdx ];
+        uint64_t wrong = pBatch->verdicts[ wordIdx ] ^ expected;
+
+        if ( wrong )
+        {
+            if ( pStat->firstWrongMsg == SPLP_INVALID_MSG_INDEX )
+            {
+                uint64_t msgIdx = wordIdx * 64 + splp_ctz64( wrong );
+                const struct MessageView* pMsg = &pBatch->views[ msgIdx ];
+                char* text = (char*) malloc( pMsg->length + 1 );
+
+                pStat->firstWrongMsg = pBatch->firstMsg + msgIdx;
+                pStat->streamWrongMsg = *pMsg;
+                pStat->streamWrongMsg.text = text;
+                pStat->streamWrongMsg.length = text ? pMsg->length : 0;
+                pStat->streamWrongExpected = ( expected >> ( msgIdx % 64 ) ) & 1 ? MESSAGE_VALID : MESSAGE_INVALID;
+                pStat->streamWrongConnection = pBatch->connections[ msgIdx ];
+                if ( text )
+                    memcpy( text, pMsg->text, pMsg->length );
+            }
+
+            falseNegative += splp_popcount64( wrong & expected );
+            falsePositive += splp_popcount64( wrong & ~expected );
+        }
+    }
+
+    pStat->falseNegative += falseNegative;
+    pStat->falsePositive += falsePositive;
+    pStat->truePositive += pBatch->expectedValid - falseNegative;
+    pStat->trueNegative += pBatch->count - pBatch->expectedValid - falsePositive;
+}
+
+
+
+
+/* SplpStreamStatisticsThread
+* Last stage: checks the answers and recycles the batches
+*/
+static splp_thread_result_t SPLP_THREAD_CALL SplpStreamStatisticsThread(
+    void* arg )
+{
+    PSPLP_STREAM pStream = (PSPLP_STREAM) arg;
+    int last = 0;
+
+    while ( !last )
+    {
+        PSPLP_STREAM_BATCH pBatch = SplpStreamTake( &pStream->validated );
+
+        if ( pStream->measure )
+            SplpStreamCheckBatch( pStream, pBatch );
+        pStream->batchCount++;
+
+        // the reader may refill the batch as soon as it is put back
+        last = pBatch->last;
+        SplpStreamPut( &pStream->free, pBatch );
+    }
+
+    return 0;
+}
+
+
+
+
+/* SplpStreamValidate
+* Middle stage: validates the batch, going on with the sessions of the
+* last one
+*/
+static void SplpStreamValidate(
+    PSPLP_STREAM pStream,
+    PSPLP_STREAM_BATCH pBatch )
+{
+    PSPLP_TEST_RUN pRun = pStream->pRun;
+    int dfa = pRun->pOptions->engine == SPLP_ENGINE_DFA;
+
+    if ( !pBatch->count || pStream->validateNoMemory )
+    {
+        memset( pBatch->verdicts, 0, (size_t) SPLP_VERDICT_WORDS( pBatch->count ) * sizeof( uint64_t ) );
+    }
+    else if ( pRun->pOptions->capture && pRun->pOptions->compactStore )
+    {
+        pStream->validateNoMemory = !splp_sessions_validate( &pRun->sessions, pBatch->views, pBatch->connections,
+            (size_t) pBatch->count, pBatch->verdicts, dfa ? splp_dfa_validate_view : splp_validate_view );
+    }
+    else if ( pRun->pOptions->capture )
+    {
+        // the wrong answers of every connection are counted on the way
+        pStream->validateNoMemory = !splp_replay_views( &pRun->replay, pBatch->views, pBatch->connections,
+            (size_t) pBatch->count, pBatch->verdicts, dfa ? splp_dfa_validate_view : splp_validate_view,
+            pBatch->expected );
+    }
+    else
+    {
+        ( dfa ? splp_dfa_validate_view_batch : splp_validate_view_batch )(
+            &pRun->session, pBatch->views, (size_t) pBatch->count, pBatch->verdicts );
+    }
+}
+
+
+
+
+/* SplpStreamRewind
+* Goes back to the start of the file and reads the amount of messages
+*/
+static SPLP_STATUS SplpStreamRewind(
+    FILE* file,
+    uint64_t* pMsgCount )
+{
+    char line[ 64 ];
+    const char* pos = line;
+    int64_t count = 0;
+    int c;
+
+    rewind( file );
+    if ( !fgets( line, sizeof( line ), file ) )
+        return SPLP_STATUS_ERROR;
+    if ( !strchr( line, '\n' ) )
+    {
+        while ( EOF != ( c = getc( file ) ) && c != '\n' )
+            ;
+    }
+
+    if ( SPLP_STATUS_OK != SplpParseInt( &pos, line + strlen( line ), &count ) || count <= 0 )
+        return SPLP_STATUS_ERROR;
+    *pMsgCount = (uint64_t) count;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpStreamPass
+* Reads and validates the whole file once
+*/
+static SPLP_STATUS SplpStreamPass(
+    PSPLP_STREAM pStream,
+    int measure )
+{
+    PSPLP_TEST_RUN pRun = pStream->pRun;
+    PSPLP_TEST_DATA pData = pRun->pData;
+    const char* fileName = pRun->pOptions->testFileName;
+    splp_thread_t reader, statistics;
+    int last = 0;
+
+    if ( SPLP_STATUS_OK != SplpStreamRewind( pData->streamFile, &pStream->msgCount ) )
+    {
+        printf( "***ERROR*** File \"%s\" can't be read\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    pStream->measure = measure;
+    pStream->carrySize = 0;
+    pStream->messagesRead = 0;
+    pStream->dataSize = 0;
+    pStream->stopped = 0;
+    pStream->batchCount = 0;
+
+    // the connections of a capture start anew, a test file goes on with its session as in SplpRunCycle( )
+    if ( pRun->pOptions->capture && pRun->pOptions->compactStore )
+        splp_sessions_clear( &pRun->sessions );
+    else if ( pRun->pOptions->capture )
+        splp_replay_reset( &pRun->replay );
+
+    if ( !splp_thread_create( &statistics, SplpStreamStatisticsThread, pStream ) )
+    {
+        printf( "***ERROR*** Threads can't be started\n" );
+        return SPLP_STATUS_ERROR;
+    }
+    if ( !splp_thread_create( &reader, SplpStreamReaderThread, pStream ) )
+    {
+        // the statistics thread is waiting for the last batch
+        PSPLP_STREAM_BATCH pBatch = SplpStreamTake( &pStream->free );
+
+        pBatch->count = 0;
+        pBatch->last = 1;
+        SplpStreamPut( &pStream->validated, pBatch );
+        splp_thread_join( statistics );
+        printf( "***ERROR*** Threads can't be started\n" );
+        return SPLP_STATUS_ERROR;
+    }
+
+    while ( !last )
+    {
+        PSPLP_STREAM_BATCH pBatch = SplpStreamTake( &pStream->loaded );
+
+        SplpStreamValidate( pStream, pBatch );
+        last = pBatch->last;
+        SplpStreamPut( &pStream->validated, pBatch );
+    }
+
+    splp_thread_join( reader );
+    splp_thread_join( statistics );
+
+    if ( pStream->readFailed || pStream->readNoMemory || pStream->validateNoMemory )
+    {
+        printf( pStream->readFailed ? "***ERROR*** File \"%s\" can't be read\n" :
+            "***ERROR*** Not enough memory to stream \"%s\"\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    // the first pass tells what is in the file
+    if ( !pData->size )
+    {
+        if ( pStream->messagesRead != pStream->msgCount )
+        {
+            printf( "***WARNING*** File \"%s\" wasn't read completely. Read %llu out of %llu\n",
+                fileName, (unsigned long long) pStream->messagesRead, (unsigned long long) pStream->msgCount );
+        }
+        if ( !pStream->messagesRead )
+        {
+            printf( "***ERROR*** File \"%s\" has no messages\n", fileName );
+            return SPLP_STATUS_ERROR;
+        }
+        pData->size = pStream->messagesRead;
+        pData->dataSize = pStream->dataSize;
+        pRun->pStat->streamBatches = pStream->batchCount;
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+void SplpDoStreamTest(
+    PSPLP_TEST_OPTIONS pOptions,
+    PSPLP_TEST_STATISTICS pStat,
+    PSPLP_TEST_DATA pData )
+{
+    SPLP_TEST_RUN run = { 0 };
+    SPLP_STREAM stream = { 0 };
+    SPLP_STATUS status = SPLP_STATUS_OK;
+    unsigned int cycleIdx, trialIdx, batchIdx;
+    int ready;
+
+    run.pOptions = pOptions;
+    run.pStat = pStat;
+    run.pData = pData;
+    stream.pRun = &run;
+    splp_session_init( &run.session );
+
+    pStat->trialDurations = (uint64_t*) calloc( pOptions->trialCount, sizeof( uint64_t ) );
+    ready = pStat->trialDurations &&
+        splp_ring_init( &stream.loaded, SPLP_STREAM_BATCHES ) &&
+        splp_ring_init( &stream.validated, SPLP_STREAM_BATCHES ) &&
+        splp_ring_init( &stream.free, SPLP_STREAM_BATCHES ) &&
+        SPLP_STATUS_OK == SplpStreamGrow( &stream.carry, &stream.carryCapacity, SPLP_STREAM_BATCH_SIZE );
+    for ( batchIdx = 0; ready && batchIdx < SPLP_STREAM_BATCHES; batchIdx++ )
+    {
+        stream.batches[ batchIdx ] = (PSPLP_STREAM_BATCH) calloc( 1, sizeof( SPLP_STREAM_BATCH ) );
+        ready = stream.batches[ batchIdx ] &&
+            SPLP_STATUS_OK == SplpStreamGrow( &stream.batches[ batchIdx ]->text,
+            &stream.batches[ batchIdx ]->textCapacity, SPLP_STREAM_BATCH_SIZE );
+        if ( ready )
+            SplpStreamPut( &stream.free, stream.batches[ batchIdx ] );
+    }
+    if ( ready && pOptions->capture )
+        ready = pOptions->compactStore ? splp_sessions_init( &run.sessions, 0 ) : splp_replay_init( &run.replay, 0 );
+
+    if ( !ready )
+    {
+        printf( "***ERROR*** Not enough memory for the stream batches\n" );
+        status = SPLP_STATUS_ERROR;
+    }
+
+    for ( cycleIdx = 0; status == SPLP_STATUS_OK && cycleIdx < pOptions->warmupCount; cycleIdx++ )
+        status = SplpStreamPass( &stream, 0 );
+    splp_stats_reset( );
+    splp_perf_enable( &pStat->hardware );
+
+    for ( trialIdx = 0; status == SPLP_STATUS_OK && trialIdx < pOptions->trialCount; trialIdx++ )
+    {
+        uint64_t start = splp_clock_ns( );
+
+        for ( cycleIdx = 0; status == SPLP_STATUS_OK && cycleIdx < pOptions->cycleCount; cycleIdx++ )
+            status = SplpStreamPass( &stream, 1 );
+
+        pStat->trialDurations[ trialIdx ] = splp_clock_ns( ) - start;
+        pStat->duration += pStat->trialDurations[ trialIdx ];
+    }
+    splp_perf_disable( &pStat->hardware );
+
+    if ( status == SPLP_STATUS_OK && pOptions->capture && pOptions->compactStore )
+    {
+        pStat->storePeak = run.sessions.peak;
+        pStat->storeMemory = splp_sessions_memory( &run.sessions );
+    }
+    else if ( status == SPLP_STATUS_OK && pOptions->capture )
+    {
+        if ( SPLP_STATUS_OK != SplpReplayCollect( &run ) )
+            printf( "***ERROR*** Not enough memory for the connections\n" );
+        pStat->storePeak = run.replay.count;
+        pStat->storeMemory = sizeof( run.replay ) + run.replay.capacity * sizeof( struct splp_connection );
+    }
+
+    pStat->streamMemory = stream.carryCapacity;
+    for ( batchIdx = 0; batchIdx < SPLP_STREAM_BATCHES; batchIdx++ )
+    {
+        if ( stream.batches[ batchIdx ] )
+        {
+            pStat->streamMemory += sizeof( SPLP_STREAM_BATCH ) + stream.batches[ batchIdx ]->textCapacity;
+            free( stream.batches[ batchIdx ]->text );
+            free( stream.batches[ batchIdx ] );
+        }
+    }
+
+    splp_stats_get( &pStat->counters );
+    free( stream.carry );
+    splp_ring_free( &stream.loaded );
+    splp_ring_free( &stream.validated );
+    splp_ring_free( &stream.free );
+    splp_replay_free( &run.replay );
+    splp_sessions_free( &run.sessions );
+}
+
+
+
+
+/* SplpTestDataOpenStream
+* Opens a text test file for the streaming test, which reads it on every
+* cycle
+*/
+SPLP_STATUS  SplpTestDataOpenStream(
+    const char* fileName,
+    PSPLP_TEST_DATA testData )
+{
+    SPLP_CORPUS_HEADER header;
+    uint64_t msgCount;
+    FILE* file = fopen( fileName, "rb" );
+
+    if ( !file )
+    {
+        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    // a binary corpus is mapped and used in place, there is nothing to stream
+    if ( SplpCorpusIsBinary( &header, fread( &header, 1, sizeof( header ), file ) ) )
+    {
+        printf( "***ERROR*** File \"%s\" is a binary corpus, only text files are streamed\n", fileName );
+        fclose( file );
+        return SPLP_STATUS_ERROR;
+    }
+
+    if ( SPLP_STATUS_OK != SplpStreamRewind( file, &msgCount ) )
+    {
+        printf( "***ERROR*** File \"%s\" doesn't start with the amount of messages\n", fileName );
+        fclose( file );
+        return SPLP_STATUS_ERROR;
+    }
+
+    testData->streamFile = file;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpParseCount
+* Parses a decimal option value which is not less than minimum
+*/
+static SPLP_STATUS SplpParseCount(
+    const char* text,
+    unsigned int minimum,
+    unsigned int* pCount )
+{
+    char* end;
+    unsigned long count = strtoul( text, &end, 10 );
+
+    if ( !*text || *end || count < minimum || count > UINT_MAX / DEFAULT_CYCLE_COUNT )
+        return SPLP_STATUS_ERROR;
+
+    *pCount = (unsigned int) count;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+SPLP_STATUS  SplpTestOptionsInitializeFromCmdLine(
+    PSPLP_TEST_OPTIONS pTestOptions,
+    int argc,
+    char* argv[ ] )
+{
+    SPLP_STATUS Status = SPLP_STATUS_OK;
+    int argIdx;
+    int positionalIdx = 0;
+
+    pTestOptions->cycleCount = DEFAULT_CYCLE_COUNT;
+    pTestOptions->testFileName = DEFAULT_TEST_FILENAME;
+    pTestOptions->engine = SPLP_ENGINE_SWITCH;
+    pTestOptions->trialCount = DEFAULT_TRIAL_COUNT;
+    pTestOptions->evictIdle = SPLP_SESSIONS_MAX_IDLE;
+
+    for ( argIdx = 1; argIdx < argc && Status == SPLP_STATUS_OK; argIdx++ )
+    {
+        const char* arg = argv[ argIdx ];
+
+        if ( 0 == strncmp( arg, "--", 2 ) )
+        {
+            if ( 0 == strcmp( arg, "--engine=switch" ) )
+            {
+                pTestOptions->engine = SPLP_ENGINE_SWITCH;
+            }
+            else if ( 0 == strcmp( arg, "--engine=dfa" ) )
+            {
+                pTestOptions->engine = SPLP_ENGINE_DFA;
+            }
+            else if ( 0 == strcmp( arg, "--engine=decode" ) )
+            {
+                pTestOptions->engine = SPLP_ENGINE_DECODE;
+            }
+            else if ( 0 == strncmp( arg, "--convert=", 10 ) && arg[ 10 ] )
+            {
+                pTestOptions->convertFileName = arg + 10;
+            }
+            else if ( 0 == strcmp( arg, "--latency=message" ) )
+            {
+                pTestOptions->latencyMode = SPLP_LATENCY_MESSAGE;
+            }
+            else if ( 0 == strcmp( arg, "--latency=batch" ) )
+            {
+                pTestOptions->latencyMode = SPLP_LATENCY_BATCH;
+            }
+            else if ( 0 == strncmp( arg, "--warmup=", 9 ) )
+            {
+                Status = SplpParseCount( arg + 9, 0, &pTestOptions->warmupCount );
+            }
+            else if ( 0 == strncmp( arg, "--trials=", 9 ) )
+            {
+                Status = SplpParseCount( arg + 9, 1, &pTestOptions->trialCount );
+            }
+            else if ( 0 == strncmp( arg, "--threads=", 10 ) )
+            {
+                Status = SplpParseCount( arg + 10, 1, &pTestOptions->threadCount );
+                if ( pTestOptions->threadCount > SPLP_MAX_THREADS )
+                    Status = SPLP_STATUS_ERROR;
+            }
+            else if ( 0 == strcmp( arg, "--scaling" ) )
+            {
+                pTestOptions->scaling = 1;
+            }
+            else if ( 0 == strcmp( arg, "--speculative" ) )
+            {
+                pTestOptions->speculative = 1;
+            }
+            else if ( 0 == strcmp( arg, "--capture" ) )
+            {
+                pTestOptions->capture = 1;
+            }
+            else if ( 0 == strcmp( arg, "--store=hash" ) )
+            {
+                pTestOptions->compactStore = 0;
+            }
+            else if ( 0 == strcmp( arg, "--store=compact" ) )
+            {
+                pTestOptions->compactStore = 1;
+            }
+            else if ( 0 == strcmp( arg, "--stream" ) )
+            {
+                pTestOptions->stream = 1;
+            }
+            else if ( 0 == strcmp( arg, "--counters" ) )
+            {
+                pTestOptions->perfCounters = 1;
+            }
+            else if ( 0 == strncmp( arg, "--snapshot=", 11 ) && arg[ 11 ] )
+            {
+                pTestOptions->snapshotFileName = arg + 11;
+            }
+            else if ( 0 == strncmp( arg, "--snapshot-every=", 17 ) )
+            {
+                Status = SplpParseCount( arg + 17, 1, &pTestOptions->snapshotEvery );
+            }
+            else if ( 0 == strncmp( arg, "--restore=", 10 ) && arg[ 10 ] )
+            {
+                pTestOptions->restoreFileName = arg + 10;
+            }
+            else if ( 0 == strncmp( arg, "--evict-every=", 14 ) )
+            {
+                Status = SplpParseCount( arg + 14, 1, &pTestOptions->evictEvery );
+            }
+            else if ( 0 == strncmp( arg, "--evict-idle=", 13 ) )
+            {
+                Status = SplpParseCount( arg + 13, 0, &pTestOptions->evictIdle );
+                if ( pTestOptions->evictIdle > SPLP_SESSIONS_MAX_IDLE )
+                    Status = SPLP_STATUS_ERROR;
+            }
+            else
+            {
+                Status = SPLP_STATUS_ERROR;
+            }
+        }
+        else if ( positionalIdx == 0 )
+        {
+            pTestOptions->testFileName = arg;
+            positionalIdx++;
+        }
+        else if ( positionalIdx == 1 )
+        {
+            unsigned long cycleCount = strtoul( arg, NULL, 0 );
+            if ( cycleCount > 0 && cycleCount <= UINT_MAX )
+            {
+                pTestOptions->cycleCount = (unsigned int) cycleCount;
+            }
+            else
+            {
+                Status = SPLP_STATUS_ERROR;
+            }
+            positionalIdx++;
+        }
+        else
+        {
+            Status = SPLP_STATUS_ERROR;
+        }
+    }
+
+    if ( pTestOptions->threadCount && pTestOptions->latencyMode != SPLP_LATENCY_OFF )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->speculative && ( pTestOptions->scaling || pTestOptions->latencyMode != SPLP_LATENCY_OFF ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->engine == SPLP_ENGINE_DECODE &&
+        ( pTestOptions->threadCount || pTestOptions->scaling || pTestOptions->speculative ||
+        pTestOptions->latencyMode == SPLP_LATENCY_MESSAGE ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->compactStore && !pTestOptions->capture )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->capture &&
+        ( pTestOptions->threadCount || pTestOptions->scaling || pTestOptions->speculative || pTestOptions->convertFileName ||
+        pTestOptions->engine == SPLP_ENGINE_DECODE || pTestOptions->latencyMode == SPLP_LATENCY_MESSAGE ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->stream &&
+        ( pTestOptions->threadCount || pTestOptions->scaling || pTestOptions->speculative || pTestOptions->convertFileName ||
+        pTestOptions->engine == SPLP_ENGINE_DECODE || pTestOptions->latencyMode != SPLP_LATENCY_OFF ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( ( pTestOptions->snapshotFileName || pTestOptions->restoreFileName ) &&
+        ( !pTestOptions->compactStore || pTestOptions->stream ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->snapshotEvery && !pTestOptions->snapshotFileName )
+        Status = SPLP_STATUS_ERROR;
+    if ( pTestOptions->evictEvery && ( !pTestOptions->compactStore || pTestOptions->stream ) )
+        Status = SPLP_STATUS_ERROR;
+    // the snapshots would overwrite the chain which is restored, whatever name it is given by
+    if ( pTestOptions->snapshotFileName && pTestOptions->restoreFileName &&
+        ( 0 == strcmp( pTestOptions->snapshotFileName, pTestOptions->restoreFileName ) ||
+        splp_same_file( pTestOptions->snapshotFileName, pTestOptions->restoreFileName ) ) )
+        Status = SPLP_STATUS_ERROR;
+    if ( ( pTestOptions->scaling || pTestOptions->speculative ) && !pTestOptions->threadCount )
+        pTestOptions->threadCount = splp_cpu_count( ) < SPLP_MAX_THREADS ? splp_cpu_count( ) : SPLP_MAX_THREADS;
+
+    if ( Status != SPLP_STATUS_OK )
+    {
+        SplpPrintUsage( );
     }
 
     return Status;
@@ -0,0 +1,386 @@
+/*
+ * splp_charclass.c
+ * The file is part of practical task for System programming course.
+ * This file contains the SPLPv1 character class table and the scalar,
+ * SSE4.2 and AVX2 kernels which scan payloads against it, and the base64
+ * kernels which check and decode a B64: payload in one pass.
+ */
+
+#include "splp_charclass.h"
+
+#include <string.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define SPLP_X86_SIMD 1
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+#if defined( SPLP_X86_SIMD ) && defined( __GNUC__ )
+#define SPLP_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define SPLP_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+#define SPLP_TARGET_SSE42
+#define SPLP_TARGET_AVX2
+#endif
+
+
+const unsigned char splp_char_class[256] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x00 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x10 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 1, 2,   /* 0x20 */
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 0, 0, 0, 0, 0, 0,   /* 0x30 */
+	0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,   /* 0x40 */
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0,   /* 0x50 */
+	0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,   /* 0x60 */
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0,   /* 0x70 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x80 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0x90 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xA0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xB0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xC0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xD0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xE0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   /* 0xF0 */
+};
+
+
+/* 6-bit value of a base64 character, 0xff for other bytes */
+static unsigned int base64_value(unsigned char c) {
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 26;
+	if (c >= '0' && c <= '9')
+		return c - '0' + 52;
+	return c == '+' ? 62 : c == '/' ? 63 : 0xff;
+}
+
+
+static size_t class_span_scalar(const char* s, size_t length, unsigned char cls) {
+	const unsigned char* p = (const unsigned char*)s;
+	size_t i = 0;
+
+	while (i < length && (splp_char_class[p[i]] & cls))
+		i++;
+	return i;
+}
+
+
+#ifdef SPLP_X86_SIMD
+
+/*
+ * The vector kernels look classes up with two PSHUFB shuffles: every
+ * class is split into a table indexed by the low nibble of a byte, which
+ * holds one bit per high nibble 0..7, and a table indexed by the high
+ * nibble, which selects that bit. A byte belongs to the class when the
+ * AND of both lookups is not zero. All classes are ASCII, so high
+ * nibbles 8..F select nothing.
+ *
+ * nibble_low[] is derived from splp_char_class[]; nibble_tables_match()
+ * checks it before a vector kernel is selected.
+ */
+#define CLASS_COUNT 3
+
+static const unsigned char nibble_low[CLASS_COUNT][16] =
+{
+	/* SPLP_CLASS_DATA */
+	{ 0x88, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc8, 0xc0, 0x40, 0x40, 0x40, 0x44, 0x40 },
+	/* SPLP_CLASS_BASE64 */
+	{ 0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x54, 0x50, 0x50, 0x50, 0x54 },
+	/* SPLP_CLASS_DIGIT */
+	{ 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+static const unsigned char nibble_high[16] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+
+static int nibble_tables_match(void) {
+	int cls, c;
+
+	for (cls = 0; cls < CLASS_COUNT; cls++) {
+		for (c = 0; c < 256; c++) {
+			int in_class = (splp_char_class[c] & (1 << cls)) != 0;
+			int in_table = (nibble_low[cls][c & 15] & nibble_high[c >> 4]) != 0;
+			if (in_class != in_table)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static int class_index(unsigned char cls) {
+	return cls == SPLP_CLASS_DATA ? 0 : cls == SPLP_CLASS_BASE64 ? 1 : 2;
+}
+
+
+SPLP_TARGET_SSE42
+static size_t class_span_sse42(const char* s, size_t length, unsigned char cls) {
+	const __m128i low = _mm_loadu_si128((const __m128i*)nibble_low[class_index(cls)]);
+	const __m128i high = _mm_loadu_si128((const __m128i*)nibble_high);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i lo = _mm_shuffle_epi8(low, _mm_and_si128(v, mask));
+		__m128i hi = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		unsigned int miss = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero));
+
+		if (miss) {
+#if defined( _MSC_VER )
+			unsigned long index;
+			_BitScanForward(&index, miss);
+			return i + index;
+#else
+			return i + (size_t)__builtin_ctz(miss);
+#endif
+		}
+	}
+	return i + class_span_scalar(s + i, length - i, cls);
+}
+
+
+SPLP_TARGET_AVX2
+static size_t class_span_avx2(const char* s, size_t length, unsigned char cls) {
+	const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)nibble_low[class_index(cls)]));
+	const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)nibble_high));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(v, mask));
+		__m256i hi = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		unsigned int miss = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero));
+
+		if (miss) {
+#if defined( _MSC_VER )
+			unsigned long index;
+			_BitScanForward(&index, miss);
+			return i + index;
+#else
+			return i + (size_t)__builtin_ctz(miss);
+#endif
+		}
+	}
+	/* the upper halves are cleared, or the legacy SSE code stalls on them */
+	_mm256_zeroupper();
+	return i + class_span_sse42(s + i, length - i, cls);
+}
+
+
+/*
+ * The base64 kernels check a block with the SPLP_CLASS_BASE64 nibble
+ * tables, then turn the characters into 6-bit values by adding an offset
+ * chosen by the high nibble ('/' shares it with '+' and gets its own),
+ * and pack every 4 values into 3 bytes with two multiply-adds and a
+ * shuffle. A block with any other byte, '=' included, is left to the
+ * scalar code, which also handles the padded last quantum.
+ */
+static const signed char base64_offset[16] = { 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+static const signed char base64_pack[16] = { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 };
+
+
+/* decodes whole 16-byte blocks of base64 characters, returns the length decoded */
+SPLP_TARGET_SSE42
+static size_t base64_decode_sse42(const char* s, size_t length, unsigned char* decoded) {
+	const __m128i low = _mm_loadu_si128((const __m128i*)nibble_low[1]);
+	const __m128i high = _mm_loadu_si128((const __m128i*)nibble_high);
+	const __m128i offset = _mm_loadu_si128((const __m128i*)base64_offset);
+	const __m128i pack = _mm_loadu_si128((const __m128i*)base64_pack);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t tail;
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i nibble = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		__m128i lo = _mm_shuffle_epi8(low, _mm_and_si128(v, mask));
+		__m128i hi = _mm_shuffle_epi8(high, nibble);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)))
+			break;
+
+		v = _mm_add_epi8(v, _mm_shuffle_epi8(offset, _mm_add_epi8(nibble, _mm_cmpeq_epi8(v, slash))));
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, pack);
+		_mm_storel_epi64((__m128i*)(decoded + i / 4 * 3), v);
+		tail = (uint32_t)_mm_extract_epi32(v, 2);
+		memcpy(decoded + i / 4 * 3 + 8, &tail, sizeof(tail));
+	}
+	return i;
+}
+
+
+SPLP_TARGET_AVX2
+static size_t base64_decode_avx2(const char* s, size_t length, unsigned char* decoded) {
+	const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)nibble_low[1]));
+	const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)nibble_high));
+	const __m256i offset = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)base64_offset));
+	const __m256i pack = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)base64_pack));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i nibble = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+		__m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(v, mask));
+		__m256i hi = _mm256_shuffle_epi8(high, nibble);
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero)))
+			break;
+
+		v = _mm256_add_epi8(v, _mm256_shuffle_epi8(offset, _mm256_add_epi8(nibble, _mm256_cmpeq_epi8(v, slash))));
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, pack);
+		/* 12 bytes in each half, move them to the low 24 bytes */
+		v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm_storeu_si128((__m128i*)(decoded + i / 4 * 3), _mm256_castsi256_si128(v));
+		_mm_storel_epi64((__m128i*)(decoded + i / 4 * 3 + 16), _mm256_extracti128_si256(v, 1));
+	}
+	_mm256_zeroupper();
+	return i + base64_decode_sse42(s + i, length - i, decoded + i / 4 * 3);
+}
+
+
+static int cpu_has_avx2(void) {
+#if defined( _MSC_VER )
+	int info[4];
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+		return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static int cpu_has_sse42(void) {
+#if defined( _MSC_VER )
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#endif /* SPLP_X86_SIMD */
+
+
+static size_t class_span_detect(const char* s, size_t length, unsigned char cls);
+
+static size_t (*class_span_kernel)(const char*, size_t, unsigned char) = class_span_detect;
+
+static size_t class_span_detect(const char* s, size_t length, unsigned char cls) {
+	size_t (*kernel)(const char*, size_t, unsigned char) = class_span_scalar;
+
+#ifdef SPLP_X86_SIMD
+	if (nibble_tables_match()) {
+		if (cpu_has_avx2())
+			kernel = class_span_avx2;
+		else if (cpu_has_sse42())
+			kernel = class_span_sse42;
+	}
+#endif
+	class_span_kernel = kernel;
+	return kernel(s, length, cls);
+}
+
+
+size_t splp_class_span_vector(const char* s, size_t length, unsigned char cls) {
+	return class_span_kernel(s, length, cls);
+}
+
+
+static size_t base64_decode_none(const char* s, size_t length, unsigned char* decoded) {
+	(void)s;
+	(void)length;
+	(void)decoded;
+	return 0;
+}
+
+static size_t base64_decode_detect(const char* s, size_t length, unsigned char* decoded);
+
+static size_t (*base64_decode_kernel)(const char*, size_t, unsigned char*) = base64_decode_detect;
+
+static size_t base64_decode_detect(const char* s, size_t length, unsigned char* decoded) {
+	size_t (*kernel)(const char*, size_t, unsigned char*) = base64_decode_none;
+
+#ifdef SPLP_X86_SIMD
+	if (nibble_tables_match()) {
+		if (cpu_has_avx2())
+			kernel = base64_decode_avx2;
+		else if (cpu_has_sse42())
+			kernel = base64_decode_sse42;
+	}
+#endif
+	base64_decode_kernel = kernel;
+	return kernel(s, length, decoded);
+}
+
+
+ /* FUNCTION:  splp_base64_decode
+   *
+   * PURPOSE:
+   *    Checks a base64 string exactly as the B64: message is validated and
+   *    decodes it in the same pass
+   *
+   * PARAMETERS:
+   *    s - base64 string, the payload after "B64: "
+   *    length - length of s
+   *    decoded - SPLP_BASE64_DECODED_MAX(length) bytes receiving the data
+   *
+   * RETURN VALUE:
+   *    length of the decoded data, SPLP_BASE64_INVALID if s isn't valid
+   */
+size_t splp_base64_decode(const char* s, size_t length, unsigned char* decoded) {
+	const unsigned char* p = (const unsigned char*)s;
+	size_t i = 0;
+	size_t out;
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+
+	if (length % 4 != 0)
+		return SPLP_BASE64_INVALID;
+
+	if (length >= SPLP_CLASS_SPAN_VECTOR_MIN)
+		i = base64_decode_kernel(s, length, decoded);
+	SPLP_STATS_ADD(class_bytes[SPLP_STATS_CLASS_INDEX(SPLP_CLASS_BASE64)], i);
+	out = i / 4 * 3;
+
+	for (; i < length; i += 4) {
+		a = base64_value(p[i]);
+		b = base64_value(p[i + 1]);
+		c = base64_value(p[i + 2]);
+		d = base64_value(p[i + 3]);
+		if ((a | b | c | d) > 63)
+			break;
+		decoded[out++] = (unsigned char)(a << 2 | b >> 4);
+		decoded[out++] = (unsigned char)(b << 4 | c >> 2);
+		decoded[out++] = (unsigned char)(c << 6 | d);
+	}
+	if (i == length)
+		return out;
+
+	/* only the last quantum may be padded, with "=" or "==" */
+	if (i + 4 != length || (a | b) > 63 || p[i + 3] != '=')
+		return SPLP_BASE64_INVALID;
+	decoded[out++] = (unsigned char)(a << 2 | b >> 4);
+	if (c <= 63)
+		decoded[out++] = (unsigned char)(b << 4 | c >> 2);
+	else if (p[i + 2] != '=')
+		return SPLP_BASE64_INVALID;
+	return out;
+}
@@ -0,0 +1,62 @@
+/*
+ * splp_charclass.h
+ * The file is part of practical task for System programming course.
+ * This file contains declarations of the SPLPv1 character classes, of
+ * the vectorised class scanning used by the validator and of the base64
+ * payload decoding.
+ */
+
+#ifndef SPLP_CHARCLASS_H
+#define SPLP_CHARCLASS_H
+
+#include <stddef.h>
+#include "splp_stats.h"
+
+
+#define SPLP_CLASS_DATA     0x01    /* small latin letters, digits and '.' */
+#define SPLP_CLASS_BASE64   0x02    /* base64 alphabet, without '=' padding */
+#define SPLP_CLASS_DIGIT    0x04    /* decimal digits */
+
+
+/* class bits of every byte value */
+extern const unsigned char splp_char_class[256];
+
+
+/* shorter spans are scanned inline, longer ones by the vector kernels */
+#define SPLP_CLASS_SPAN_VECTOR_MIN  16
+
+extern size_t splp_class_span_vector( const char* s, size_t length, unsigned char cls );
+
+
+/* Returns the length of the longest prefix of s (at most length bytes)
+ * which consists of bytes of class cls only. Uses SSE4.2 or AVX2 when
+ * the CPU supports them.
+ */
+static __inline size_t splp_class_span( const char* s, size_t length, unsigned char cls )
+{
+	const unsigned char* p = (const unsigned char*) s;
+	size_t i = 0;
+
+	if ( length >= SPLP_CLASS_SPAN_VECTOR_MIN )
+		i = splp_class_span_vector( s, length, cls );
+	else
+	{
+		while ( i < length && ( splp_char_class[ p[ i ] ] & cls ) )
+			i++;
+	}
+	SPLP_STATS_ADD( class_bytes[ SPLP_STATS_CLASS_INDEX( cls ) ], i );
+	return i;
+}
+
+
+
+/* splp_base64_decode() returns SPLP_BASE64_INVALID for a malformed string,
+ * decoded length of a string of length bytes is at most
+ * SPLP_BASE64_DECODED_MAX(length).
+ */
+#define SPLP_BASE64_INVALID                 ( (size_t) -1 )
+#define SPLP_BASE64_DECODED_MAX( length )   ( ( length ) / 4 * 3 )
+
+extern size_t splp_base64_decode( const char* s, size_t length, unsigned char* decoded );
+
+#endif /* SPLP_CHARCLASS_H */
@@ -0,0 +1,22 @@
+/*
+ * splp_compiler.h
+ * The file is part of practical task for System programming course.
+ * This file contains the compiler-specific storage and inlining
+ * attributes. Unlike splp_platform.h it doesn't include any OS headers,
+ * so the validator itself can use it.
+ */
+
+#ifndef SPLP_COMPILER_H
+#define SPLP_COMPILER_H
+
+#if defined( _MSC_VER )
+#define SPLP_THREAD_LOCAL   __declspec( thread )
+#define SPLP_CACHE_ALIGNED  __declspec( align( 64 ) )
+#define SPLP_FORCE_INLINE   __forceinline
+#else
+#define SPLP_THREAD_LOCAL   __thread
+#define SPLP_CACHE_ALIGNED  __attribute__( ( aligned( 64 ) ) )
+#define SPLP_FORCE_INLINE   __inline __attribute__( ( always_inline ) )
+#endif
+
+#endif /* SPLP_COMPILER_H */
@@ -0,0 +1,244 @@
+/*
+ * splp_corpus.c
+ * The file is part of practical task for System programming course.
+ * This file contains writing and mapping of binary test corpora.
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <string.h>
+#include "splp_corpus.h"
+
+
+
+
+/* SplpCorpusAlign
+* Rounds offset up to SPLP_CORPUS_ALIGNMENT
+*/
+static uint64_t SplpCorpusAlign(
+    uint64_t offset )
+{
+    return ( offset + SPLP_CORPUS_ALIGNMENT - 1 ) & ~(uint64_t) ( SPLP_CORPUS_ALIGNMENT - 1 );
+}
+
+
+
+
+/* SplpCorpusSectionFits
+* Returns non-zero if the section lies inside the file
+*/
+static int SplpCorpusSectionFits(
+    uint64_t offset,
+    uint64_t size,
+    uint64_t fileSize )
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+
+
+
+int SplpCorpusIsBinary(
+    const void* data,
+    size_t size )
+{
+    return size >= sizeof( SPLP_CORPUS_HEADER ) &&
+        0 == memcmp( data, SPLP_CORPUS_MAGIC, sizeof( ( (PSPLP_CORPUS_HEADER) 0 )->magic ) );
+}
+
+
+
+
+SPLP_STATUS SplpCorpusAttach(
+    PSPLP_CORPUS pCorpus,
+    const void* data,
+    size_t size )
+{
+    const SPLP_CORPUS_HEADER* header = (const SPLP_CORPUS_HEADER*) data;
+    const char* file = (const char*) data;
+    uint64_t count, bitmapSize;
+
+    if ( !SplpCorpusIsBinary( data, size ) ||
+        header->version != SPLP_CORPUS_VERSION ||
+        header->headerSize != sizeof( SPLP_CORPUS_HEADER ) ||
+        header->fileSize != size )
+    {
+        return SPLP_STATUS_ERROR;
+    }
+
+    // the offsets themselves are trusted, only the sections are checked,
+    // so that mapping a corpus doesn't depend on the amount of messages
+    count = header->messageCount;
+    bitmapSize = SPLP_VERDICT_WORDS( count ) * sizeof( uint64_t );
+    if ( count == 0 || count > size ||
+        !SplpCorpusSectionFits( header->textOffset, header->textSize, size ) ||
+        !SplpCorpusSectionFits( header->offsetsOffset, ( count + 1 ) * sizeof( uint64_t ), size ) ||
+        !SplpCorpusSectionFits( header->directionsOffset, bitmapSize, size ) ||
+        !SplpCorpusSectionFits( header->expectedOffset, bitmapSize, size ) ||
+        ( header->offsetsOffset | header->directionsOffset | header->expectedOffset ) % sizeof( uint64_t ) ||
+        ( (const uint64_t*) ( file + header->offsetsOffset ) )[ count ] != header->textSize )
+    {
+        return SPLP_STATUS_ERROR;
+    }
+
+    pCorpus->header = header;
+    pCorpus->block.text = file + header->textOffset;
+    pCorpus->block.offsets = (const uint64_t*) ( file + header->offsetsOffset );
+    pCorpus->block.directions = (const uint64_t*) ( file + header->directionsOffset );
+    pCorpus->block.count = (size_t) count;
+    pCorpus->expected = (const uint64_t*) ( file + header->expectedOffset );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpCorpusWrite
+* Writes size bytes, remembering a failure in the writer
+*/
+static void SplpCorpusWrite(
+    PSPLP_CORPUS_WRITER pWriter,
+    const void* data,
+    size_t size )
+{
+    if ( pWriter->status == SPLP_STATUS_OK && size && 1 != fwrite( data, size, 1, pWriter->file ) )
+        pWriter->status = SPLP_STATUS_ERROR;
+}
+
+
+
+
+/* SplpCorpusPad
+* Pads the file up to offset with zeroes
+*/
+static void SplpCorpusPad(
+    PSPLP_CORPUS_WRITER pWriter,
+    uint64_t written,
+    uint64_t offset )
+{
+    static const char zeroes[ SPLP_CORPUS_ALIGNMENT ] = { 0 };
+    SplpCorpusWrite( pWriter, zeroes, (size_t) ( offset - written ) );
+}
+
+
+
+
+SPLP_STATUS SplpCorpusWriterOpen(
+    PSPLP_CORPUS_WRITER pWriter,
+    const char* fileName )
+{
+    memset( pWriter, 0, sizeof( *pWriter ) );
+
+    pWriter->file = fopen( fileName, "wb" );
+    if ( !pWriter->file )
+    {
+        printf( "***ERROR*** File \"%s\" can't be created\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    memcpy( pWriter->header.magic, SPLP_CORPUS_MAGIC, sizeof( pWriter->header.magic ) );
+    pWriter->header.version = SPLP_CORPUS_VERSION;
+    pWriter->header.headerSize = sizeof( SPLP_CORPUS_HEADER );
+    pWriter->header.textOffset = SplpCorpusAlign( sizeof( SPLP_CORPUS_HEADER ) );
+    pWriter->status = SPLP_STATUS_OK;
+
+    // the header is rewritten when the writer is closed
+    SplpCorpusWrite( pWriter, &pWriter->header, sizeof( pWriter->header ) );
+    SplpCorpusPad( pWriter, sizeof( pWriter->header ), pWriter->header.textOffset );
+    return pWriter->status;
+}
+
+
+
+
+SPLP_STATUS SplpCorpusWriterAdd(
+    PSPLP_CORPUS_WRITER pWriter,
+    const struct MessageView* pMsg,
+    enum test_status expected )
+{
+    uint64_t idx = pWriter->header.messageCount;
+
+    if ( idx + 1 >= pWriter->capacity )
+    {
+        uint64_t capacity = pWriter->capacity ? pWriter->capacity * 2 : 4096;
+        size_t words = (size_t) SPLP_VERDICT_WORDS( capacity );
+        uint64_t* offsets = (uint64_t*) realloc( pWriter->offsets, (size_t) capacity * sizeof( uint64_t ) );
+        uint64_t* directions = offsets ? (uint64_t*) realloc( pWriter->directions, words * sizeof( uint64_t ) ) : NULL;
+        uint64_t* expectedBits = directions ? (uint64_t*) realloc( pWriter->expected, words * sizeof( uint64_t ) ) : NULL;
+
+        if ( offsets )
+            pWriter->offsets = offsets;
+        if ( directions )
+            pWriter->directions = directions;
+        if ( !expectedBits )
+        {
+            pWriter->status = SPLP_STATUS_ERROR;
+            return SPLP_STATUS_ERROR;
+        }
+        pWriter->expected = expectedBits;
+
+        words -= (size_t) SPLP_VERDICT_WORDS( pWriter->capacity );
+        memset( pWriter->directions + SPLP_VERDICT_WORDS( pWriter->capacity ), 0, words * sizeof( uint64_t ) );
+        memset( pWriter->expected + SPLP_VERDICT_WORDS( pWriter->capacity ), 0, words * sizeof( uint64_t ) );
+        pWriter->capacity = capacity;
+    }
+
+    pWriter->offsets[ idx ] = pWriter->header.textSize;
+    if ( pMsg->direction == B_TO_A )
+        pWriter->directions[ idx / 64 ] |= (uint64_t) 1 << ( idx % 64 );
+    if ( expected == MESSAGE_VALID )
+    {
+        pWriter->expected[ idx / 64 ] |= (uint64_t) 1 << ( idx % 64 );
+        pWriter->header.expectedValid++;
+    }
+
+    SplpCorpusWrite( pWriter, pMsg->text, pMsg->length );
+    pWriter->header.textSize += pMsg->length;
+    pWriter->header.messageCount++;
+    return pWriter->status;
+}
+
+
+
+
+SPLP_STATUS SplpCorpusWriterClose(
+    PSPLP_CORPUS_WRITER pWriter )
+{
+    PSPLP_CORPUS_HEADER header = &pWriter->header;
+    uint64_t count = header->messageCount;
+    uint64_t bitmapSize = SPLP_VERDICT_WORDS( count ) * sizeof( uint64_t );
+    uint64_t textEnd = header->textOffset + header->textSize;
+    SPLP_STATUS status;
+
+    if ( pWriter->offsets )
+        pWriter->offsets[ count ] = header->textSize;
+
+    header->offsetsOffset = SplpCorpusAlign( textEnd );
+    header->directionsOffset = SplpCorpusAlign( header->offsetsOffset + ( count + 1 ) * sizeof( uint64_t ) );
+    header->expectedOffset = SplpCorpusAlign( header->directionsOffset + bitmapSize );
+    header->fileSize = header->expectedOffset + bitmapSize;
+
+    if ( !count )
+        pWriter->status = SPLP_STATUS_ERROR;
+
+    SplpCorpusPad( pWriter, textEnd, header->offsetsOffset );
+    SplpCorpusWrite( pWriter, pWriter->offsets, (size_t) ( count + 1 ) * sizeof( uint64_t ) );
+    SplpCorpusPad( pWriter, header->offsetsOffset + ( count + 1 ) * sizeof( uint64_t ), header->directionsOffset );
+    SplpCorpusWrite( pWriter, pWriter->directions, (size_t) bitmapSize );
+    SplpCorpusPad( pWriter, header->directionsOffset + bitmapSize, header->expectedOffset );
+    SplpCorpusWrite( pWriter, pWriter->expected, (size_t) bitmapSize );
+
+    if ( pWriter->status == SPLP_STATUS_OK && 0 != fseek( pWriter->file, 0, SEEK_SET ) )
+        pWriter->status = SPLP_STATUS_ERROR;
+    SplpCorpusWrite( pWriter, header, sizeof( *header ) );
+
+    if ( 0 != fclose( pWriter->file ) )
+        pWriter->status = SPLP_STATUS_ERROR;
+
+    free( pWriter->offsets );
+    free( pWriter->directions );
+    free( pWriter->expected );
+    status = pWriter->status;
+    memset( pWriter, 0, sizeof( *pWriter ) );
+    return status;
+}
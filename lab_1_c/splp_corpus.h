@@ -0,0 +1,125 @@
+/*
+ * splp_corpus.h
+ * The file is part of practical task for System programming course.
+ * This file contains the binary test corpus format. A binary corpus
+ * holds the same data as a text test file, but is laid out so that it
+ * can be used straight from a memory mapping, without any parsing.
+ */
+
+#ifndef SPLP_CORPUS_H
+#define SPLP_CORPUS_H
+
+#include <stdio.h>
+#include "splpv1.h"
+#include "splptest.h"
+
+
+
+#define SPLP_CORPUS_MAGIC         "SPLPBIN1"
+#define SPLP_CORPUS_VERSION       1
+#define SPLP_CORPUS_ALIGNMENT     64
+
+
+
+
+/* SPLP_CORPUS_HEADER
+* Starts a binary corpus. The sections follow the header in this order,
+* each one aligned to SPLP_CORPUS_ALIGNMENT bytes from the start of the
+* file:
+*   text       - all messages back to back, without separators
+*   offsets    - messageCount + 1 offsets of the messages in text
+*   directions - bitmap, bit i is set if message i goes B_TO_A
+*   expected   - bitmap, bit i is set if message i is MESSAGE_VALID
+* Bitmaps use the layout of verdict bitmaps (see splpv1.h). All numbers
+* are little-endian.
+*/
+typedef struct _SPLP_CORPUS_HEADER
+{
+    char        magic[ 8 ];         /* SPLP_CORPUS_MAGIC */
+    uint32_t    version;            /* SPLP_CORPUS_VERSION */
+    uint32_t    headerSize;         /* sizeof( SPLP_CORPUS_HEADER ) */
+    uint64_t    messageCount;
+    uint64_t    expectedValid;      /* amount of MESSAGE_VALID answers */
+    uint64_t    textOffset;
+    uint64_t    textSize;
+    uint64_t    offsetsOffset;
+    uint64_t    directionsOffset;
+    uint64_t    expectedOffset;
+    uint64_t    fileSize;
+
+} SPLP_CORPUS_HEADER, *PSPLP_CORPUS_HEADER;
+
+
+
+
+/* SPLP_CORPUS
+* A binary corpus mapped into memory
+*/
+typedef struct _SPLP_CORPUS
+{
+    const SPLP_CORPUS_HEADER* header;
+    struct MessageBlock       block;        /* the messages */
+    const uint64_t*           expected;     /* the correct answers */
+
+} SPLP_CORPUS, *PSPLP_CORPUS;
+
+
+
+
+/* SPLP_CORPUS_WRITER
+* Writes a binary corpus message by message. The text goes to the file
+* right away, offsets and bitmaps are kept in memory until the writer
+* is closed.
+*/
+typedef struct _SPLP_CORPUS_WRITER
+{
+    FILE*               file;
+    SPLP_CORPUS_HEADER  header;
+    uint64_t*           offsets;
+    uint64_t*           directions;
+    uint64_t*           expected;
+    uint64_t            capacity;   /* messages the arrays can hold */
+    SPLP_STATUS         status;     /* SPLP_STATUS_ERROR after a failed write */
+
+} SPLP_CORPUS_WRITER, *PSPLP_CORPUS_WRITER;
+
+
+
+
+/* returns non-zero if the data starts with a binary corpus header */
+int SplpCorpusIsBinary(
+    const void* data,
+    size_t size );
+
+
+
+
+/* checks the header of a mapped binary corpus and locates its sections */
+SPLP_STATUS SplpCorpusAttach(
+    PSPLP_CORPUS pCorpus,
+    const void* data,
+    size_t size );
+
+
+
+
+SPLP_STATUS SplpCorpusWriterOpen(
+    PSPLP_CORPUS_WRITER pWriter,
+    const char* fileName );
+
+
+
+
+SPLP_STATUS SplpCorpusWriterAdd(
+    PSPLP_CORPUS_WRITER pWriter,
+    const struct MessageView* pMsg,
+    enum test_status expected );
+
+
+
+
+/* writes the rest of the corpus and closes the file */
+SPLP_STATUS SplpCorpusWriterClose(
+    PSPLP_CORPUS_WRITER pWriter );
+
+#endif /* SPLP_CORPUS_H */
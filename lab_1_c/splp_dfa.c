@@ -0,0 +1,541 @@
+/*
+ * splp_dfa.c
+ * The file is part of practical task for System programming course.
+ * This file contains the automaton-based validator.
+ */
+
+/*
+ * The rules of a protocol grammar (see splp_grammar.h, SPLPv1 by
+ * default) are compiled into one deterministic automaton over message
+ * bytes:
+ *
+ *  - every (direction, state, command) combination which allows some
+ *    message has its own start node;
+ *  - keywords allowed in the same protocol state share a trie, so e.g.
+ *    "GET_" is read once no matter which GET_* command follows;
+ *  - payloads are small loops hanging off the keyword, after a chain of
+ *    nodes for their least length: one node for the digits of VERSION
+ *    and the data of GET_DATA/GET_COMMAND/GET_FILE (followed by the
+ *    echoed command), four base64 nodes counting the payload length
+ *    modulo 4 (plus two rows of '=' padding nodes) for B64;
+ *  - a node which accepts a message stores the protocol state and
+ *    command the session moves to.
+ *
+ * Node 0 is the dead node. Nodes whose verdict can't change any more
+ * (nodes which can't be left, like the dead node and the node after an
+ * echoed command, and nodes from which no accepting node is reachable)
+ * are final and end the scan early. Bytes with
+ * identical columns are merged into one byte class to keep the table
+ * small.
+ *
+ * Payload loops are also recorded per character class: if every byte of
+ * a class leads from a node around a cycle of at most 4 nodes (the data
+ * and digit loops, the four base64 nodes), a long run of such bytes is
+ * skipped with splp_class_span() and the node is advanced by the run
+ * length modulo 4. This is still a single pass over the message.
+ *
+ * Keywords are mostly chains of nodes with one live byte each (after
+ * "DISCONNECT" only "_OK" can follow). Such a chain is recorded at its
+ * first node and compared with memcmp() when the message is long enough
+ * to hold it, instead of taking a transition per byte.
+ */
+
+#include "splp_dfa.h"
+#include "splp_grammar.h"
+#include "splp_charclass.h"
+
+#include <string.h>
+
+
+#define DFA_MAX_NODES   256
+#define DFA_DEAD        0
+#define DFA_LITERAL_MAX 16
+
+/* dfa_flags bits, a node with none of them is handled by the table alone */
+#define DFA_FINAL       0x01
+#define DFA_SPAN        0x02
+#define DFA_LITERAL     0x04
+
+/* compiled automaton */
+static unsigned char dfa_byte_class[256];
+static unsigned char dfa_next[DFA_MAX_NODES * 256];   /* [node][byte class] */
+static unsigned int  dfa_class_count;
+static unsigned int  dfa_row_shift;                   /* rows are padded to 1 << dfa_row_shift classes */
+static unsigned char dfa_accept[DFA_MAX_NODES];       /* new state | new command << 4, 0 if rejected */
+static unsigned char dfa_type[DFA_MAX_NODES];         /* enum splp_keyword of the accepted message */
+static unsigned char dfa_final[DFA_MAX_NODES];        /* verdict doesn't depend on further bytes */
+static unsigned char dfa_start[2][8][4];              /* [direction][state][command] */
+static unsigned char dfa_span_class[DFA_MAX_NODES];   /* class looping from the node, 0 if none */
+static unsigned char dfa_span_next[DFA_MAX_NODES][4]; /* node after a run of n % 4 such bytes */
+static unsigned char dfa_flags[DFA_MAX_NODES];        /* DFA_* */
+static unsigned char dfa_literal_length[DFA_MAX_NODES];
+static unsigned char dfa_literal_next[DFA_MAX_NODES];  /* node after the literal */
+static char dfa_literal_text[DFA_MAX_NODES][DFA_LITERAL_MAX];
+static unsigned char dfa_reset_on_invalid;            /* see splp_grammar */
+
+/* uncompressed table used while compiling */
+static unsigned char build_next[DFA_MAX_NODES][256];
+static unsigned int  build_count;
+
+
+static int build_node(void) {
+	if (build_count >= DFA_MAX_NODES)
+		return -1;
+	memset(build_next[build_count], DFA_DEAD, 256);
+	dfa_accept[build_count] = 0;
+	dfa_type[build_count] = SPLP_KEYWORD_COUNT;
+	return (int)build_count++;
+}
+
+/* adds transition from -> to on byte c, fails if c already leads elsewhere */
+static int build_edge(int from, unsigned char c, int to) {
+	if (build_next[from][c] != DFA_DEAD && build_next[from][c] != to)
+		return 0;
+	build_next[from][c] = (unsigned char)to;
+	return 1;
+}
+
+static int build_class_edges(int from, unsigned char cls, int to) {
+	int c;
+	for (c = 0; c < 256; c++) {
+		if ((splp_char_class[c] & cls) && !build_edge(from, (unsigned char)c, to))
+			return 0;
+	}
+	return 1;
+}
+
+/* follows or extends the trie from node along text, returns the last node */
+static int build_string(int node, const char* text) {
+	for (; *text; text++) {
+		unsigned char c = (unsigned char)*text;
+		if (build_next[node][c] == DFA_DEAD) {
+			int next = build_node();
+			if (next < 0)
+				return -1;
+			build_next[node][c] = (unsigned char)next;
+		}
+		node = build_next[node][c];
+	}
+	return node;
+}
+
+/* marks the node as the end of a valid message, fails if another rule already ends there */
+static int build_accept(int node, unsigned char accept, enum splp_keyword type) {
+	if (dfa_accept[node] && (dfa_accept[node] != accept || dfa_type[node] != type))
+		return 0;
+	dfa_accept[node] = accept;
+	dfa_type[node] = (unsigned char)type;
+	return 1;
+}
+
+/* the message may end at node: adds the echo, if any, and accepts */
+static int build_end(const struct splp_grammar_rule* rule, int node, unsigned char accept) {
+	int c;
+
+	if (rule->echo) {
+		node = build_string(node, rule->echo);
+		if (node < 0)
+			return 0;
+	}
+	if (rule->open_end) {
+		for (c = 0; c < 256; c++) {
+			if (build_next[node][c] != DFA_DEAD)
+				return 0;
+		}
+		memset(build_next[node], node, 256);
+	}
+	return build_accept(node, accept, rule->type);
+}
+
+static int build_rule(const struct splp_grammar_rule* rule) {
+	const struct splp_grammar_payload* payload = &rule->payload;
+	unsigned char* start = &dfa_start[rule->direction][rule->state][rule->command];
+	unsigned char accept = (unsigned char)(rule->new_state | rule->new_command << 4);
+	int cycle[SPLP_GRAMMAR_MAX_BLOCK];
+	int pad[SPLP_GRAMMAR_MAX_BLOCK][SPLP_GRAMMAR_MAX_BLOCK];
+	unsigned int block = payload->block ? payload->block : 1;
+	unsigned int i, level;
+	int node;
+
+	if (rule->state < 1 || rule->state > SPLP_GRAMMAR_MAX_STATE ||
+		rule->new_state < 1 || rule->new_state > SPLP_GRAMMAR_MAX_STATE ||
+		rule->command > SPLP_GRAMMAR_MAX_COMMAND || rule->new_command > SPLP_GRAMMAR_MAX_COMMAND ||
+		(block != 1 && block != 2 && block != 4) || payload->pad_max >= SPLP_GRAMMAR_MAX_BLOCK)
+		return 0;
+
+	if (*start == DFA_DEAD) {
+		int root = build_node();
+		if (root < 0)
+			return 0;
+		*start = (unsigned char)root;
+	}
+
+	node = build_string(*start, rule->keyword);
+	if (node < 0)
+		return 0;
+	if (!payload->char_class)
+		return build_end(rule, node, accept);
+
+	/* the first min characters of the payload, then a loop of block nodes
+	 * counting the length modulo block, and pad_max rows of such nodes
+	 * for the padding after it */
+	for (i = 0; i < payload->min; i++) {
+		int next = build_node();
+		if (next < 0 || !build_class_edges(node, payload->char_class, next))
+			return 0;
+		node = next;
+	}
+	cycle[0] = node;
+	for (i = 1; i < block; i++) {
+		if ((cycle[i] = build_node()) < 0)
+			return 0;
+	}
+	for (i = 0; i < block; i++) {
+		for (level = 0; level < payload->pad_max; level++) {
+			if ((pad[level][i] = build_node()) < 0)
+				return 0;
+		}
+	}
+	for (i = 0; i < block; i++) {
+		if (!build_class_edges(cycle[i], payload->char_class, cycle[(i + 1) % block]))
+			return 0;
+		for (level = 0; level < payload->pad_max; level++) {
+			int from = level ? pad[level - 1][i] : cycle[i];
+			if (!build_edge(from, (unsigned char)payload->pad, pad[level][(i + 1) % block]))
+				return 0;
+		}
+	}
+
+	/* the length counted from cycle[0] is min, so lengths which are whole blocks end at these nodes */
+	for (i = 0; i < block; i++) {
+		if ((payload->min + i) % block)
+			continue;
+		if (!build_end(rule, cycle[i], accept))
+			return 0;
+		for (level = 0; level < payload->pad_max; level++) {
+			if (!build_end(rule, pad[level][i], accept))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static void build_finals(void) {
+	static unsigned char live[DFA_MAX_NODES];  /* an accepting node is reachable */
+	unsigned int node, c;
+	int changed = 1;
+
+	for (node = 0; node < build_count; node++)
+		live[node] = dfa_accept[node] != 0;
+
+	while (changed) {
+		changed = 0;
+		for (node = 0; node < build_count; node++) {
+			for (c = 0; c < 256 && !live[node]; c++) {
+				if (live[build_next[node][c]]) {
+					live[node] = 1;
+					changed = 1;
+				}
+			}
+		}
+	}
+
+	for (node = 0; node < build_count; node++) {
+		for (c = 0; c < 256 && build_next[node][c] == node; c++)
+			;
+		dfa_final[node] = (c == 256) || !live[node];
+	}
+}
+
+/* node every byte of class cls leads to, or -1 if they don't agree */
+static int build_class_target(unsigned int node, unsigned char cls) {
+	int target = -1;
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		if (!(splp_char_class[c] & cls))
+			continue;
+		if (target >= 0 && build_next[node][c] != target)
+			return -1;
+		target = build_next[node][c];
+	}
+	return target;
+}
+
+/* classes is the set of SPLP_CLASS_* bits payloads are made of */
+static void build_spans(unsigned char classes) {
+	unsigned int node, bit, step;
+
+	for (node = 0; node < build_count; node++) {
+		dfa_span_class[node] = 0;
+		if (dfa_final[node])
+			continue;
+
+		for (bit = 0; bit < 8 && !dfa_span_class[node]; bit++) {
+			unsigned char cls = (unsigned char)(1u << bit);
+			int cycle[5];
+			if (!(classes & cls))
+				continue;
+			cycle[0] = (int)node;
+			for (step = 1; step <= 4; step++) {
+				cycle[step] = build_class_target(cycle[step - 1], cls);
+				if (cycle[step] <= DFA_DEAD)
+					break;
+			}
+			if (step <= 4 || cycle[4] != (int)node)
+				continue;
+			dfa_span_class[node] = cls;
+			for (step = 0; step < 4; step++)
+				dfa_span_next[node][step] = (unsigned char)cycle[step];
+		}
+	}
+}
+
+/* the only byte which doesn't lead from node to the dead node, -1 if there are none or several */
+static int build_single_byte(unsigned int node) {
+	int single = -1;
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		if (build_next[node][c] == DFA_DEAD)
+			continue;
+		if (single >= 0)
+			return -1;
+		single = c;
+	}
+	return single;
+}
+
+static void build_literals(void) {
+	unsigned int node, length, next;
+	int c;
+
+	for (node = 0; node < build_count; node++) {
+		length = 0;
+		next = node;
+		while (length < DFA_LITERAL_MAX && !dfa_final[next] && !dfa_span_class[next]) {
+			c = build_single_byte(next);
+			if (c < 0)
+				break;
+			dfa_literal_text[node][length++] = (char)c;
+			next = build_next[next][c];
+		}
+		dfa_literal_length[node] = (unsigned char)(length >= 2 ? length : 0);
+		dfa_literal_next[node] = (unsigned char)next;
+		dfa_flags[node] = (unsigned char)((dfa_final[node] ? DFA_FINAL : 0)
+			| (dfa_span_class[node] ? DFA_SPAN : 0)
+			| (length >= 2 ? DFA_LITERAL : 0));
+	}
+}
+
+/* merges bytes with identical columns and fills the compressed table */
+static void build_classes(void) {
+	unsigned int c, other, node;
+
+	dfa_class_count = 0;
+	for (c = 0; c < 256; c++) {
+		for (other = 0; other < c; other++) {
+			for (node = 0; node < build_count; node++) {
+				if (build_next[node][c] != build_next[node][other])
+					break;
+			}
+			if (node == build_count)
+				break;
+		}
+		if (other < c) {
+			dfa_byte_class[c] = dfa_byte_class[other];
+			continue;
+		}
+		dfa_byte_class[c] = (unsigned char)dfa_class_count;
+		for (node = 0; node < build_count; node++)
+			dfa_next[node * 256 + dfa_class_count] = build_next[node][c];
+		dfa_class_count++;
+	}
+
+	/* repack rows with the final row length, a power of two so a row is found with a shift */
+	for (dfa_row_shift = 0; (1u << dfa_row_shift) < dfa_class_count; dfa_row_shift++)
+		;
+	for (node = 0; node < build_count; node++)
+		memmove(&dfa_next[node << dfa_row_shift], &dfa_next[node * 256], dfa_class_count);
+}
+
+
+int splp_dfa_compile(const struct splp_grammar* grammar) {
+	unsigned char classes = 0;
+	size_t i;
+
+	build_count = 0;
+	memset(dfa_start, DFA_DEAD, sizeof(dfa_start));
+	build_node();       /* DFA_DEAD */
+
+	for (i = 0; i < grammar->rule_count; i++) {
+		if (!build_rule(&grammar->rules[i]))
+			return 0;
+		classes |= grammar->rules[i].payload.char_class;
+	}
+
+	build_finals();
+	build_spans(classes);
+	build_literals();
+	build_classes();
+	dfa_reset_on_invalid = grammar->reset_on_invalid;
+	return 1;
+}
+
+
+int splp_dfa_init(void) {
+	return splp_dfa_compile(&splp_grammar_v1);
+}
+
+
+enum test_status splp_dfa_validate(struct SplpSession* session, const struct Message* msg) {
+	struct MessageView view;
+
+	view.direction = msg->direction;
+	view.text = msg->text_message;
+	view.length = strlen(msg->text_message);
+	return splp_dfa_validate_view(session, &view);
+}
+
+
+/* runs the automaton from node over [p, end) */
+static unsigned int dfa_run(unsigned int node, const unsigned char* p, const unsigned char* end) {
+	while (p != end) {
+		unsigned char flags = dfa_flags[node];
+
+		if (flags) {
+			if (flags & DFA_FINAL)
+				break;
+			if ((flags & DFA_LITERAL) && (size_t)(end - p) >= dfa_literal_length[node]) {
+				/* every other byte inside the chain leads to the dead node */
+				if (memcmp(p, dfa_literal_text[node], dfa_literal_length[node]) != 0)
+					return DFA_DEAD;
+				p += dfa_literal_length[node];
+				node = dfa_literal_next[node];
+				continue;
+			}
+			if ((flags & DFA_SPAN) && (size_t)(end - p) >= SPLP_CLASS_SPAN_VECTOR_MIN) {
+				size_t run = splp_class_span((const char*)p, end - p, dfa_span_class[node]);
+				node = dfa_span_next[node][run & 3];
+				p += run;
+				if (p == end)
+					break;
+			}
+		}
+		node = dfa_next[(node << dfa_row_shift) + dfa_byte_class[*p++]];
+	}
+	return node;
+}
+
+/* moves the session according to the node the message ended in */
+static enum test_status dfa_finish(struct SplpSession* session, unsigned int node) {
+	unsigned char accept = dfa_accept[node];
+
+	SPLP_STATS_MESSAGE(session->state, session->command, dfa_type[node]);
+	SPLP_STATS_ADD(rejects[SPLP_REJECT_TABLE], !accept);
+	session->position = 0;
+	if (!accept) {
+		if (dfa_reset_on_invalid) {
+			session->state = 1;
+			session->command = 0;
+		}
+		return MESSAGE_INVALID;
+	}
+	session->state = accept & 0x0f;
+	session->command = accept >> 4;
+	return MESSAGE_VALID;
+}
+
+
+enum test_status splp_dfa_validate_view(struct SplpSession* session, const struct MessageView* view) {
+	const unsigned char* p = (const unsigned char*)view->text;
+	unsigned int node = dfa_start[view->direction & 1][session->state & 7][session->command & 3];
+
+	return dfa_finish(session, dfa_run(node, p, p + view->length));
+}
+
+
+void splp_dfa_validate_batch(struct SplpSession* session, const struct Message* messages, size_t count, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	size_t i = 0;
+
+	while (i < count) {
+		size_t n = count - i < 64 ? count - i : 64;
+		uint64_t word = 0;
+		size_t bit;
+
+		for (bit = 0; bit < n; bit++) {
+			word |= (uint64_t)(splp_dfa_validate(&local, &messages[i + bit]) == MESSAGE_VALID) << bit;
+		}
+		*verdicts++ = word;
+		i += n;
+	}
+
+	*session = local;
+}
+
+
+void splp_dfa_validate_view_batch(struct SplpSession* session, const struct MessageView* messages, size_t count, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	size_t i = 0;
+
+	while (i < count) {
+		size_t n = count - i < 64 ? count - i : 64;
+		uint64_t word = 0;
+		size_t bit;
+
+		for (bit = 0; bit < n; bit++) {
+			word |= (uint64_t)(splp_dfa_validate_view(&local, &messages[i + bit]) == MESSAGE_VALID) << bit;
+		}
+		*verdicts++ = word;
+		i += n;
+	}
+
+	*session = local;
+}
+
+
+void splp_dfa_validate_block(struct SplpSession* session, const struct MessageBlock* block, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	struct MessageView view;
+	size_t i = 0;
+
+	while (i < block->count) {
+		size_t n = block->count - i < 64 ? block->count - i : 64;
+		uint64_t directions = block->directions[i / 64];
+		uint64_t word = 0;
+		size_t bit;
+
+		for (bit = 0; bit < n; bit++) {
+			view.direction = (directions >> bit) & 1 ? B_TO_A : A_TO_B;
+			view.text = block->text + block->offsets[i + bit];
+			view.length = (size_t)(block->offsets[i + bit + 1] - block->offsets[i + bit]);
+			word |= (uint64_t)(splp_dfa_validate_view(&local, &view) == MESSAGE_VALID) << bit;
+		}
+		*verdicts++ = word;
+		i += n;
+	}
+
+	*session = local;
+}
+
+
+void splp_stream_begin(struct SplpSession* session, enum Direction direction) {
+	session->position = dfa_start[direction & 1][session->state & 7][session->command & 3];
+}
+
+
+enum stream_status splp_stream_feed(struct SplpSession* session, const char* chunk, size_t length) {
+	const unsigned char* p = (const unsigned char*)chunk;
+	unsigned int node = dfa_run(session->position, p, p + length);
+
+	session->position = (unsigned char)node;
+	if (!dfa_final[node])
+		return STREAM_UNDECIDED;
+	return dfa_accept[node] ? STREAM_VALID : STREAM_INVALID;
+}
+
+
+enum test_status splp_stream_end(struct SplpSession* session) {
+	return dfa_finish(session, session->position);
+}
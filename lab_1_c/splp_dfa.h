@@ -0,0 +1,72 @@
+/*
+ * splp_dfa.h
+ * The file is part of practical task for System programming course.
+ * This file contains declarations of the automaton-based validator.
+ * It accepts exactly the same messages as validate_message(), but every
+ * message is consumed byte by byte in a single pass through one
+ * transition table compiled from a protocol grammar (splp_grammar.h).
+ * splp_validate_view() is faster on whole messages; the automaton is
+ * meant for messages which arrive in fragments (splp_stream_*()) and
+ * for grammars given at run time (splp_dfa_compile()).
+ */
+
+#ifndef SPLP_DFA_H
+#define SPLP_DFA_H
+
+#include "splpv1.h"
+#include "splp_grammar.h"
+
+
+/* Compiles the transition table of SPLPv1. Must be called once before
+ * any other splp_dfa_*() function and before other threads use the
+ * validator. Returns 1 on success, 0 if the protocol doesn't fit into
+ * the table.
+ */
+extern int splp_dfa_init( void );
+
+/* Same as splp_dfa_init() for another protocol. Returns 0 as well if the
+ * grammar is ambiguous: two rules of a state differ only after a byte
+ * one of them accepts as payload, or end a message in the same place
+ * with different new states. The validator must not be in use.
+ */
+extern int splp_dfa_compile( const struct splp_grammar* pGrammar );
+
+extern enum test_status splp_dfa_validate( struct SplpSession* pSession, const struct Message* pMessage );
+
+extern enum test_status splp_dfa_validate_view( struct SplpSession* pSession, const struct MessageView* pView );
+
+extern void splp_dfa_validate_batch( struct SplpSession* pSession, const struct Message* pMessages,
+	size_t count, uint64_t* pVerdicts );
+
+extern void splp_dfa_validate_view_batch( struct SplpSession* pSession, const struct MessageView* pViews,
+	size_t count, uint64_t* pVerdicts );
+
+extern void splp_dfa_validate_block( struct SplpSession* pSession, const struct MessageBlock* pBlock,
+	uint64_t* pVerdicts );
+
+
+/* Streaming validation
+ * A message which arrives in fragments is validated with
+ * splp_stream_begin(), any number of splp_stream_feed() calls and
+ * splp_stream_end(). The position inside the message is kept in the
+ * session, so nothing is buffered. splp_stream_feed() reports the
+ * verdict as soon as further bytes can't change it (e.g. on the first
+ * illegal byte); the remaining fragments may then be skipped.
+ * splp_stream_end() returns the verdict and moves the session to the
+ * next protocol state, exactly as splp_dfa_validate() would have done
+ * for the whole message.
+ */
+enum stream_status
+{
+	STREAM_INVALID = MESSAGE_INVALID,
+	STREAM_VALID = MESSAGE_VALID,
+	STREAM_UNDECIDED
+};
+
+extern void splp_stream_begin( struct SplpSession* pSession, enum Direction direction );
+
+extern enum stream_status splp_stream_feed( struct SplpSession* pSession, const char* chunk, size_t length );
+
+extern enum test_status splp_stream_end( struct SplpSession* pSession );
+
+#endif /* SPLP_DFA_H */
@@ -0,0 +1,62 @@
+/*
+ * splp_grammar.c
+ * The file is part of practical task for System programming course.
+ * This file contains the grammar of SPLPv1, the only place its rules
+ * are written. splpcompile turns it into splp_tables.h, the tables
+ * validate_message() and the speculative lanes run on, and
+ * splp_dfa_compile() turns it, or a variant of the protocol given at
+ * run time, into the transition table; no validator code has to change.
+ */
+
+#include "splp_grammar.h"
+#include "splp_charclass.h"
+
+
+/* payloads: character class, least length, block, padding, most padding */
+#define NO_PAYLOAD      { 0,                 0, 1, 0,   0 }
+#define NUMBER          { SPLP_CLASS_DIGIT,  1, 1, 0,   0 }
+#define DATA            { SPLP_CLASS_DATA,   0, 1, 0,   0 }
+#define BASE64          { SPLP_CLASS_BASE64, 0, 4, '=', 2 }
+
+
+/*
+ * States of SPLPv1:
+ *  1 INIT              initial state
+ *  2 CONNECTING        client is waiting for connection approval from server
+ *  3 CONNECTED         connection is established
+ *  4 WAITING_VER       client is waiting for server to provide version information
+ *  5 WAITING_DATA      client is waiting for a response from server, the command
+ *                      is the one it sent: 1 GET_DATA, 2 GET_COMMAND, 3 GET_FILE
+ *  6 WAITING_B64_DATA  client is waiting for a response from server
+ *  7 DISCONNECTING     client is waiting for server to close the connection
+ *
+ * In case of invalid message the state should be reset to 1 (INIT).
+ */
+static const struct splp_grammar_rule grammar_v1_rules[] =
+{
+	/* direction, state, command, keyword, payload, echo, open end, new state, new command, type */
+	{ A_TO_B, 1, 0, "CONNECT",       NO_PAYLOAD, NULL,           0, 2, 0, SPLP_KEYWORD_CONNECT },
+	{ B_TO_A, 2, 0, "CONNECT_OK",    NO_PAYLOAD, NULL,           0, 3, 0, SPLP_KEYWORD_CONNECT_OK },
+	{ A_TO_B, 3, 0, "GET_VER",       NO_PAYLOAD, NULL,           0, 4, 0, SPLP_KEYWORD_GET_VER },
+	{ A_TO_B, 3, 0, "GET_DATA",      NO_PAYLOAD, NULL,           0, 5, 1, SPLP_KEYWORD_GET_DATA },
+	{ A_TO_B, 3, 0, "GET_COMMAND",   NO_PAYLOAD, NULL,           0, 5, 2, SPLP_KEYWORD_GET_COMMAND },
+	{ A_TO_B, 3, 0, "GET_FILE",      NO_PAYLOAD, NULL,           0, 5, 3, SPLP_KEYWORD_GET_FILE },
+	{ A_TO_B, 3, 0, "GET_B64",       NO_PAYLOAD, NULL,           0, 6, 0, SPLP_KEYWORD_GET_B64 },
+	{ A_TO_B, 3, 0, "DISCONNECT",    NO_PAYLOAD, NULL,           0, 7, 0, SPLP_KEYWORD_DISCONNECT },
+	{ B_TO_A, 4, 0, "VERSION ",      NUMBER,     NULL,           0, 3, 0, SPLP_KEYWORD_VERSION },
+	/* anything may follow the echoed command */
+	{ B_TO_A, 5, 1, "GET_DATA ",     DATA,       " GET_DATA",    1, 3, 0, SPLP_KEYWORD_GET_DATA_REPLY },
+	{ B_TO_A, 5, 2, "GET_COMMAND ",  DATA,       " GET_COMMAND", 1, 3, 0, SPLP_KEYWORD_GET_COMMAND_REPLY },
+	{ B_TO_A, 5, 3, "GET_FILE ",     DATA,       " GET_FILE",    1, 3, 0, SPLP_KEYWORD_GET_FILE_REPLY },
+	{ B_TO_A, 6, 0, "B64: ",         BASE64,     NULL,           0, 3, 0, SPLP_KEYWORD_B64 },
+	{ B_TO_A, 7, 0, "DISCONNECT_OK", NO_PAYLOAD, NULL,           0, 1, 0, SPLP_KEYWORD_DISCONNECT_OK },
+};
+
+
+const struct splp_grammar splp_grammar_v1 =
+{
+	"SPLPv1",
+	grammar_v1_rules,
+	sizeof(grammar_v1_rules) / sizeof(grammar_v1_rules[0]),
+	1
+};
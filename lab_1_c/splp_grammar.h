@@ -0,0 +1,72 @@
+/*
+ * splp_grammar.h
+ * The file is part of practical task for System programming course.
+ * This file contains the declarative description of the protocol which
+ * validate_message() (through splp_tables.h) and the automaton-based
+ * validator (splp_dfa.h) are generated from.
+ */
+
+#ifndef SPLP_GRAMMAR_H
+#define SPLP_GRAMMAR_H
+
+#include "splpv1.h"
+
+
+#define SPLP_GRAMMAR_MAX_STATE      7       /* states are 1 .. 7, 1 is where sessions start */
+#define SPLP_GRAMMAR_MAX_COMMAND    3       /* commands are 0 .. 3, 0 is "none" */
+#define SPLP_GRAMMAR_MAX_BLOCK      4       /* payload blocks are 1, 2 or 4 characters */
+
+
+/* splp_grammar_payload
+ * What may follow the keyword: a run of characters of one class (see
+ * splp_charclass.h), at least min long. If block is above 1, the length
+ * of the run together with the padding must be a multiple of block; up
+ * to pad_max pad characters may end it.
+ */
+struct splp_grammar_payload
+{
+	unsigned char	char_class;       /* SPLP_CLASS_*, 0 if the message ends with the keyword */
+	unsigned char	min;
+	unsigned char	block;
+	char			pad;
+	unsigned char	pad_max;
+};
+
+
+/* splp_grammar_rule
+ * A message allowed in a state: direction, keyword, payload and echo,
+ * and the state it moves the session to.
+ */
+struct splp_grammar_rule
+{
+	enum Direction				direction;
+	unsigned char				state;          /* state and pending command the message is allowed in */
+	unsigned char				command;
+	const char*					keyword;        /* text the message starts with */
+	struct splp_grammar_payload	payload;
+	const char*					echo;           /* text which must follow the payload, NULL if none */
+	unsigned char				open_end;       /* anything may follow the echo */
+	unsigned char				new_state;
+	unsigned char				new_command;
+	enum splp_keyword			type;           /* what the message is reported as */
+};
+
+
+/* splp_grammar
+ * A protocol: its rules and what an invalid message does. A message no
+ * rule of the session's state and direction matches is invalid.
+ */
+struct splp_grammar
+{
+	const char*						name;
+	const struct splp_grammar_rule*	rules;
+	size_t							rule_count;
+	unsigned char					reset_on_invalid; /* an invalid message returns the session to state 1,
+	                                                     otherwise the session stays where it was */
+};
+
+
+/* SPLPv1, the protocol splp_validate_view() checks */
+extern const struct splp_grammar splp_grammar_v1;
+
+#endif /* SPLP_GRAMMAR_H */
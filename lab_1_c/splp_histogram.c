@@ -0,0 +1,115 @@
+/*
+ * splp_histogram.c
+ * The file is part of practical task for System programming course.
+ * This file contains the log-bucketed latency histogram.
+ */
+
+#include "splp_histogram.h"
+#include "splp_platform.h"
+
+
+
+#define SPLP_HISTOGRAM_SUB_COUNT  ( 1u << SPLP_HISTOGRAM_SUB_BITS )
+
+
+
+
+/* SplpHistogramBucket
+* Returns the index of the bucket value falls into
+*/
+static unsigned int SplpHistogramBucket(
+    uint64_t value )
+{
+    unsigned int msb;
+
+    if ( value < SPLP_HISTOGRAM_SUB_COUNT )
+        return (unsigned int) value;
+
+    msb = splp_msb64( value );
+    if ( msb >= SPLP_HISTOGRAM_MAX_BITS )
+        return SPLP_HISTOGRAM_BUCKETS - 1;
+
+    return ( ( msb - SPLP_HISTOGRAM_SUB_BITS + 1 ) << SPLP_HISTOGRAM_SUB_BITS ) +
+        (unsigned int) ( value >> ( msb - SPLP_HISTOGRAM_SUB_BITS ) ) - SPLP_HISTOGRAM_SUB_COUNT;
+}
+
+
+
+
+/* SplpHistogramBucketEnd
+* Returns the largest value which falls into the bucket
+*/
+static uint64_t SplpHistogramBucketEnd(
+    unsigned int bucket )
+{
+    unsigned int group = bucket >> SPLP_HISTOGRAM_SUB_BITS;
+    uint64_t sub = bucket & ( SPLP_HISTOGRAM_SUB_COUNT - 1 );
+
+    if ( group == 0 )
+        return sub;
+
+    return ( ( SPLP_HISTOGRAM_SUB_COUNT + sub + 1 ) << ( group - 1 ) ) - 1;
+}
+
+
+
+
+void SplpHistogramRecord(
+    PSPLP_HISTOGRAM pHistogram,
+    uint64_t value )
+{
+    pHistogram->buckets[ SplpHistogramBucket( value ) ]++;
+    pHistogram->count++;
+    if ( value > pHistogram->max )
+        pHistogram->max = value;
+}
+
+
+
+
+void SplpHistogramMerge(
+    PSPLP_HISTOGRAM pHistogram,
+    const SPLP_HISTOGRAM* pSource )
+{
+    unsigned int i;
+
+    for ( i = 0; i < SPLP_HISTOGRAM_BUCKETS; i++ )
+        pHistogram->buckets[ i ] += pSource->buckets[ i ];
+
+    pHistogram->count += pSource->count;
+    if ( pSource->max > pHistogram->max )
+        pHistogram->max = pSource->max;
+}
+
+
+
+
+uint64_t SplpHistogramPercentile(
+    const SPLP_HISTOGRAM* pHistogram,
+    double percentile )
+{
+    uint64_t rank, seen = 0;
+    unsigned int i;
+
+    if ( pHistogram->count == 0 )
+        return 0;
+
+    // the rank-th smallest value, counting from 1
+    rank = (uint64_t) ( percentile / 100.0 * (double) pHistogram->count + 0.999999 );
+    if ( rank == 0 )
+        rank = 1;
+    if ( rank > pHistogram->count )
+        rank = pHistogram->count;
+
+    for ( i = 0; i < SPLP_HISTOGRAM_BUCKETS; i++ )
+    {
+        seen += pHistogram->buckets[ i ];
+        if ( seen >= rank && i != SPLP_HISTOGRAM_BUCKETS - 1 )
+        {
+            uint64_t end = SplpHistogramBucketEnd( i );
+            return end < pHistogram->max ? end : pHistogram->max;
+        }
+    }
+
+    return pHistogram->max;
+}
@@ -0,0 +1,61 @@
+/*
+ * splp_histogram.h
+ * The file is part of practical task for System programming course.
+ * This file contains a log-bucketed latency histogram. Values below
+ * 2^SPLP_HISTOGRAM_SUB_BITS are counted exactly, every next power of two
+ * is split into 2^SPLP_HISTOGRAM_SUB_BITS equal buckets, so a recorded
+ * value is known with about 3% precision whatever its magnitude.
+ */
+
+#ifndef SPLP_HISTOGRAM_H
+#define SPLP_HISTOGRAM_H
+
+#include <stdint.h>
+
+
+
+#define SPLP_HISTOGRAM_SUB_BITS   5
+#define SPLP_HISTOGRAM_MAX_BITS   40    /* larger values go to the last bucket */
+#define SPLP_HISTOGRAM_BUCKETS    ( ( SPLP_HISTOGRAM_MAX_BITS - SPLP_HISTOGRAM_SUB_BITS + 1 ) << SPLP_HISTOGRAM_SUB_BITS )
+
+
+
+
+/* SPLP_HISTOGRAM
+* Distribution of recorded values. A zeroed structure is an empty
+* histogram.
+*/
+typedef struct _SPLP_HISTOGRAM
+{
+    uint64_t    count;      /* amount of recorded values */
+    uint64_t    max;        /* largest recorded value */
+    uint64_t    buckets[ SPLP_HISTOGRAM_BUCKETS ];
+
+} SPLP_HISTOGRAM, *PSPLP_HISTOGRAM;
+
+
+
+
+void SplpHistogramRecord(
+    PSPLP_HISTOGRAM pHistogram,
+    uint64_t value );
+
+
+
+
+/* adds the values recorded in pSource to pHistogram */
+void SplpHistogramMerge(
+    PSPLP_HISTOGRAM pHistogram,
+    const SPLP_HISTOGRAM* pSource );
+
+
+
+
+/* returns the value which percentile% of the recorded values don't
+* exceed, rounded up to the end of its bucket; 0 for an empty histogram
+*/
+uint64_t SplpHistogramPercentile(
+    const SPLP_HISTOGRAM* pHistogram,
+    double percentile );
+
+#endif /* SPLP_HISTOGRAM_H */
@@ -0,0 +1,157 @@
+/*
+ * splp_perf.c
+ * The file is part of practical task for System programming course.
+ * This file contains the hardware performance counters of the test
+ * program.
+ */
+
+#include "splp_perf.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+static const char* const event_names[SPLP_PERF_EVENT_COUNT] = {
+	"cycles", "instructions", "branch misses", "L1D misses", "LLC misses", "dTLB misses"
+};
+
+
+#if defined(__linux__)
+
+#define CACHE_READ_MISS(cache) \
+	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+	uint32_t type;
+	uint64_t config;
+} events[SPLP_PERF_EVENT_COUNT] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+
+unsigned int splp_perf_open(struct splp_perf* perf) {
+	unsigned int event, count = 0;
+
+	memset(perf, 0, sizeof(*perf));
+	for (event = 0; event < SPLP_PERF_EVENT_COUNT; event++) {
+		struct perf_event_attr attr;
+
+		/* every counter is opened alone: a group would fail as a whole if the CPU lacks one event */
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[event].type;
+		attr.config = events[event].config;
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		perf->fds[event] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf->fds[event] < 0) {
+			if (!perf->error)
+				perf->error = errno;
+			continue;
+		}
+		perf->open |= 1u << event;
+		count++;
+	}
+	return count;
+}
+
+
+void splp_perf_close(struct splp_perf* perf) {
+	unsigned int event;
+
+	for (event = 0; event < SPLP_PERF_EVENT_COUNT; event++) {
+		if (perf->open & (1u << event))
+			close(perf->fds[event]);
+	}
+	perf->open = 0;
+}
+
+
+void splp_perf_enable(struct splp_perf* perf) {
+	unsigned int event;
+
+	for (event = 0; event < SPLP_PERF_EVENT_COUNT; event++) {
+		if (perf->open & (1u << event))
+			ioctl(perf->fds[event], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+
+void splp_perf_disable(struct splp_perf* perf) {
+	unsigned int event;
+
+	for (event = 0; event < SPLP_PERF_EVENT_COUNT; event++) {
+		if (perf->open & (1u << event))
+			ioctl(perf->fds[event], PERF_EVENT_IOC_DISABLE, 0);
+	}
+}
+
+
+void splp_perf_read(struct splp_perf* perf) {
+	unsigned int event;
+
+	for (event = 0; event < SPLP_PERF_EVENT_COUNT; event++) {
+		uint64_t data[3];   /* value, time enabled, time running */
+
+		perf->values[event] = 0;
+		perf->running[event] = 0;
+		if (!(perf->open & (1u << event)) ||
+		    read(perf->fds[event], data, sizeof(data)) != (ssize_t)sizeof(data) || !data[2])
+			continue;
+
+		perf->running[event] = (double)data[2] / (double)data[1];
+		perf->values[event] = data[2] < data[1] ?
+			(uint64_t)((double)data[0] * (double)data[1] / (double)data[2]) : data[0];
+	}
+}
+
+#else /* !__linux__ */
+
+unsigned int splp_perf_open(struct splp_perf* perf) {
+	memset(perf, 0, sizeof(*perf));
+	return 0;
+}
+
+
+void splp_perf_close(struct splp_perf* perf) {
+	perf->open = 0;
+}
+
+
+void splp_perf_enable(struct splp_perf* perf) {
+	(void)perf;
+}
+
+
+void splp_perf_disable(struct splp_perf* perf) {
+	(void)perf;
+}
+
+
+void splp_perf_read(struct splp_perf* perf) {
+	memset(perf->values, 0, sizeof(perf->values));
+	memset(perf->running, 0, sizeof(perf->running));
+}
+
+#endif /* !__linux__ */
+
+
+const char* splp_perf_event_name(unsigned int event) {
+	return event < SPLP_PERF_EVENT_COUNT ? event_names[event] : "?";
+}
@@ -0,0 +1,56 @@
+/*
+ * splp_perf.h
+ * The file is part of practical task for System programming course.
+ * This file contains the hardware performance counters of the test
+ * program. They are read with perf_event_open() on Linux; elsewhere, or
+ * if the kernel doesn't allow it (perf_event_paranoid, a VM without a
+ * PMU), no counter opens and the test runs without them.
+ */
+
+#ifndef SPLP_PERF_H
+#define SPLP_PERF_H
+
+#include <stdint.h>
+
+
+enum splp_perf_event {
+	SPLP_PERF_CYCLES,
+	SPLP_PERF_INSTRUCTIONS,
+	SPLP_PERF_BRANCH_MISSES,
+	SPLP_PERF_L1D_MISSES,       /* L1 data cache read misses */
+	SPLP_PERF_LLC_MISSES,       /* last level cache misses */
+	SPLP_PERF_DTLB_MISSES,      /* data TLB read misses */
+	SPLP_PERF_EVENT_COUNT
+};
+
+/* splp_perf
+ * The counters count user code of the calling thread and of the threads
+ * it starts while they are enabled. A zeroed structure has no counters
+ * open, all functions do nothing with it.
+ */
+struct splp_perf {
+	int fds[SPLP_PERF_EVENT_COUNT];
+	unsigned int open;                          /* bit per event, set if fds[event] is open */
+	int error;                                  /* errno of the first counter which didn't open */
+	uint64_t values[SPLP_PERF_EVENT_COUNT];     /* set by splp_perf_read() */
+	double running[SPLP_PERF_EVENT_COUNT];      /* part of the enabled time the counter really counted */
+};
+
+
+/* opens the counters disabled and zeroed, returns how many opened */
+extern unsigned int splp_perf_open(struct splp_perf* perf);
+
+extern void splp_perf_close(struct splp_perf* perf);
+
+/* counting goes on from where the last splp_perf_disable() stopped it */
+extern void splp_perf_enable(struct splp_perf* perf);
+extern void splp_perf_disable(struct splp_perf* perf);
+
+/* fills values with the counts so far. The kernel time-shares the
+   hardware counters if there are not enough of them: such a count is
+   extrapolated from the time it ran, and running is below 1 */
+extern void splp_perf_read(struct splp_perf* perf);
+
+extern const char* splp_perf_event_name(unsigned int event);
+
+#endif /* SPLP_PERF_H */
@@ -0,0 +1,347 @@
+/*
+ * splp_platform.h
+ * The file is part of practical task for System programming course.
+ * This file contains small compiler and OS portability helpers shared by
+ * the validator and the test program.
+ */
+
+#ifndef SPLP_PLATFORM_H
+#define SPLP_PLATFORM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "splp_compiler.h"
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+/* number of set bits in value */
+static __inline unsigned int splp_popcount64( uint64_t value )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	return (unsigned int) __popcnt64( value );
+#elif defined( _MSC_VER )
+	return __popcnt( (unsigned int) value ) + __popcnt( (unsigned int) ( value >> 32 ) );
+#else
+	return (unsigned int) __builtin_popcountll( value );
+#endif
+}
+
+
+/* index of the lowest set bit of value, value must not be zero */
+static __inline unsigned int splp_ctz64( uint64_t value )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	unsigned long index;
+	_BitScanForward64( &index, value );
+	return (unsigned int) index;
+#elif defined( _MSC_VER )
+	unsigned long index;
+	if ( _BitScanForward( &index, (unsigned long) value ) )
+		return (unsigned int) index;
+	_BitScanForward( &index, (unsigned long) ( value >> 32 ) );
+	return (unsigned int) index + 32;
+#else
+	return (unsigned int) __builtin_ctzll( value );
+#endif
+}
+
+/* index of the highest set bit of value, value must not be zero */
+static __inline unsigned int splp_msb64( uint64_t value )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	unsigned long index;
+	_BitScanReverse64( &index, value );
+	return (unsigned int) index;
+#elif defined( _MSC_VER )
+	unsigned long index;
+	if ( _BitScanReverse( &index, (unsigned long) ( value >> 32 ) ) )
+		return (unsigned int) index + 32;
+	_BitScanReverse( &index, (unsigned long) value );
+	return (unsigned int) index;
+#else
+	return 63 - (unsigned int) __builtin_clzll( value );
+#endif
+}
+
+/* starts loading the cache line of address, which will be read soon */
+static __inline void splp_prefetch( const void* address )
+{
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+	_mm_prefetch( (const char*) address, _MM_HINT_T0 );
+#elif defined( _MSC_VER )
+	(void) address;
+#else
+	__builtin_prefetch( address );
+#endif
+}
+
+
+/* value |= bits, atomically */
+static __inline void splp_atomic_or64( volatile uint64_t* value, uint64_t bits )
+{
+#if defined( _MSC_VER )
+	_InterlockedOr64( (volatile __int64*) value, (__int64) bits );
+#else
+	__atomic_fetch_or( value, bits, __ATOMIC_RELAXED );
+#endif
+}
+
+
+/* if *value == expected, sets it to desired; returns the value *value had */
+static __inline uint64_t splp_atomic_cas64( volatile uint64_t* value, uint64_t expected, uint64_t desired )
+{
+#if defined( _MSC_VER )
+	return (uint64_t) _InterlockedCompareExchange64( (volatile __int64*) value, (__int64) desired, (__int64) expected );
+#else
+	__atomic_compare_exchange_n( value, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+	return expected;
+#endif
+}
+
+
+/* *value, after which the reads of the data it publishes are safe */
+static __inline uint64_t splp_atomic_load_acquire64( const volatile uint64_t* value )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	uint64_t result = *value;
+	_ReadWriteBarrier( );
+	return result;
+#elif defined( _MSC_VER )
+	return (uint64_t) _InterlockedCompareExchange64( (volatile __int64*) value, 0, 0 );
+#else
+	return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+#endif
+}
+
+
+/* *value = desired, after all the writes made before it */
+static __inline void splp_atomic_store_release64( volatile uint64_t* value, uint64_t desired )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	_ReadWriteBarrier( );
+	*value = desired;
+#elif defined( _MSC_VER )
+	_InterlockedExchange64( (volatile __int64*) value, (__int64) desired );
+#else
+	__atomic_store_n( value, desired, __ATOMIC_RELEASE );
+#endif
+}
+
+
+/* size bytes starting at a cache line, NULL if there is no memory; freed with splp_free_cache_aligned() */
+static __inline void* splp_alloc_cache_aligned( size_t size )
+{
+#if defined( _MSC_VER )
+	return _aligned_malloc( size ? size : 1, 64 );
+#else
+	void* memory;
+	return posix_memalign( &memory, 64, size ? size : 1 ) == 0 ? memory : NULL;
+#endif
+}
+
+static __inline void splp_free_cache_aligned( void* memory )
+{
+#if defined( _MSC_VER )
+	_aligned_free( memory );
+#else
+	free( memory );
+#endif
+}
+
+
+/* Threads
+ * A thread procedure is declared as
+ *     static splp_thread_result_t SPLP_THREAD_CALL proc( void* arg )
+ * and returns 0.
+ */
+#if defined( _WIN32 )
+typedef HANDLE splp_thread_t;
+typedef DWORD splp_thread_result_t;
+#define SPLP_THREAD_CALL WINAPI
+#else
+typedef pthread_t splp_thread_t;
+typedef void* splp_thread_result_t;
+#define SPLP_THREAD_CALL
+#endif
+
+typedef splp_thread_result_t ( SPLP_THREAD_CALL *splp_thread_proc_t )( void* arg );
+
+
+/* starts proc( arg ) in a new thread, returns 1 on success */
+static __inline int splp_thread_create( splp_thread_t* thread, splp_thread_proc_t proc, void* arg )
+{
+#if defined( _WIN32 )
+	*thread = CreateThread( NULL, 0, proc, arg, 0, NULL );
+	return *thread != NULL;
+#else
+	return pthread_create( thread, NULL, proc, arg ) == 0;
+#endif
+}
+
+
+/* waits for the thread to finish */
+static __inline void splp_thread_join( splp_thread_t thread )
+{
+#if defined( _WIN32 )
+	WaitForSingleObject( thread, INFINITE );
+	CloseHandle( thread );
+#else
+	pthread_join( thread, NULL );
+#endif
+}
+
+
+/* gives the rest of the time slice to other threads */
+static __inline void splp_thread_yield( void )
+{
+#if defined( _WIN32 )
+	SwitchToThread( );
+#else
+	sched_yield( );
+#endif
+}
+
+
+/* number of processors available to the process */
+static __inline unsigned int splp_cpu_count( void )
+{
+#if defined( _WIN32 )
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (unsigned int) count : 1;
+#endif
+}
+
+/* monotonic wall-clock time in nanoseconds, for measuring intervals */
+static __inline uint64_t splp_clock_ns( void )
+{
+#if defined( _WIN32 )
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if ( frequency.QuadPart == 0 )
+		QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (uint64_t) ( counter.QuadPart / frequency.QuadPart ) * 1000000000u +
+		(uint64_t) ( counter.QuadPart % frequency.QuadPart ) * 1000000000u / (uint64_t) frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+#endif
+}
+
+/* Maps the whole file, returns NULL if it can't be mapped or is empty.
+ * If copy is set, the pages may be written to: a written page becomes a
+ * private copy and the file doesn't change. The mapping stays valid until
+ * splp_unmap_file().
+ */
+static __inline void* splp_map_file_mode( const char* fileName, size_t* pSize, int copy )
+{
+#if defined( _WIN32 )
+	void* mapping = NULL;
+	LARGE_INTEGER size;
+	HANDLE file = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+		return NULL;
+	if ( GetFileSizeEx( file, &size ) && size.QuadPart > 0 && (uint64_t) size.QuadPart <= (size_t) -1 )
+	{
+		HANDLE section = CreateFileMappingA( file, NULL, copy ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL );
+		if ( section )
+		{
+			mapping = MapViewOfFile( section, copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( section );
+			*pSize = (size_t) size.QuadPart;
+		}
+	}
+	CloseHandle( file );
+	return mapping;
+#else
+	void* mapping = NULL;
+	struct stat fileStat;
+	int fd = open( fileName, O_RDONLY );
+	if ( fd < 0 )
+		return NULL;
+	if ( fstat( fd, &fileStat ) == 0 && fileStat.st_size > 0 )
+	{
+		mapping = mmap( NULL, fileStat.st_size, copy ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0 );
+		if ( mapping == MAP_FAILED )
+			mapping = NULL;
+		else
+		{
+			madvise( mapping, fileStat.st_size, MADV_WILLNEED );
+			*pSize = fileStat.st_size;
+		}
+	}
+	close( fd );
+	return mapping;
+#endif
+}
+
+/* maps the whole file read-only */
+static __inline void* splp_map_file( const char* fileName, size_t* pSize )
+{
+	return splp_map_file_mode( fileName, pSize, 0 );
+}
+
+/* maps the whole file copy-on-write */
+static __inline void* splp_map_file_copy( const char* fileName, size_t* pSize )
+{
+	return splp_map_file_mode( fileName, pSize, 1 );
+}
+
+
+static __inline void splp_unmap_file( void* mapping, size_t size )
+{
+#if defined( _WIN32 )
+	UnmapViewOfFile( mapping );
+#else
+	munmap( mapping, size );
+#endif
+}
+
+
+/* non-zero if both names are of the same existing file */
+static __inline int splp_same_file( const char* fileName1, const char* fileName2 )
+{
+#if defined( _WIN32 )
+	BY_HANDLE_FILE_INFORMATION info1, info2;
+	int same = 0;
+	HANDLE file1 = CreateFileA( fileName1, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL );
+	HANDLE file2 = CreateFileA( fileName2, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL );
+	if ( file1 != INVALID_HANDLE_VALUE && file2 != INVALID_HANDLE_VALUE &&
+		GetFileInformationByHandle( file1, &info1 ) && GetFileInformationByHandle( file2, &info2 ) )
+		same = info1.dwVolumeSerialNumber == info2.dwVolumeSerialNumber &&
+			info1.nFileIndexHigh == info2.nFileIndexHigh && info1.nFileIndexLow == info2.nFileIndexLow;
+	if ( file1 != INVALID_HANDLE_VALUE )
+		CloseHandle( file1 );
+	if ( file2 != INVALID_HANDLE_VALUE )
+		CloseHandle( file2 );
+	return same;
+#else
+	struct stat stat1, stat2;
+	return stat( fileName1, &stat1 ) == 0 && stat( fileName2, &stat2 ) == 0 &&
+		stat1.st_dev == stat2.st_dev && stat1.st_ino == stat2.st_ino;
+#endif
+}
+
+#endif /* SPLP_PLATFORM_H */
@@ -0,0 +1,816 @@
+/*
+ * splp_proxy.c
+ * The file is part of practical task for System programming course.
+ * This file contains an inline SPLPv1 validating proxy for Linux. It
+ * accepts clients (A) on a port, connects every client to the upstream
+ * server (B) and forwards the bytes both ways, validating the messages
+ * on the fly with a session per connection. A message is a line ending
+ * with '\n'; as with the test files, it ends at the first '\r'. The
+ * connection is cut as soon as a message is known to be invalid, and the
+ * part of that message still held by the proxy isn't forwarded.
+ *
+ * Messages are validated in the order they start: a side which starts
+ * a message while the other side's one is incomplete is cut, since every
+ * protocol state expects messages of one direction only.
+ *
+ * Every thread runs its own epoll loop over non-blocking sockets and has
+ * its own listening socket bound with SO_REUSEPORT, so the kernel spreads
+ * the clients over the threads and a connection never leaves its thread.
+ * The received bytes are validated in place by the streaming validator
+ * (splp_dfa.h) and sent from the same buffer without any other copy;
+ * splice() can't be used as every byte has to be looked at.
+ *
+ * "--serve=port" runs a stand-in SPLPv1 server to test the proxy with.
+ *
+ * Build separately from the test program:
+ *     gcc -O2 -pthread -o splp_proxy splp_proxy.c splpv1.c splp_dfa.c splp_grammar.c splp_charclass.c splp_stats.c
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "splpv1.h"
+#include "splp_dfa.h"
+#include "splp_platform.h"
+#include "splptest.h"
+
+
+
+
+#define SPLP_PROXY_BUFFER_SIZE    ( 64 * 1024 )
+#define SPLP_PROXY_MAX_EVENTS     256
+#define SPLP_PROXY_MAX_THREADS    64
+#define SPLP_PROXY_WAIT_MSEC      500       /* how often the loops look at SplpProxyStop */
+
+
+
+
+/* SPLP_PROXY_OPTIONS
+* Where to listen and where to forward to
+*/
+typedef struct _SPLP_PROXY_OPTIONS
+{
+    unsigned int            threadCount;
+    const char*             listenPort;
+    const char*             upstreamHost;
+    const char*             upstreamPort;
+    const char*             servePort;      /* run the stand-in server on this port instead */
+    struct sockaddr_storage upstream;       /* resolved upstreamHost:upstreamPort */
+    socklen_t               upstreamLength;
+
+}SPLP_PROXY_OPTIONS, *PSPLP_PROXY_OPTIONS;
+
+
+
+
+/* SPLP_PROXY_SIDE
+* One socket of a proxied connection and the bytes read from it which
+* aren't sent to the other side yet
+*/
+typedef struct _SPLP_PROXY_SIDE
+{
+    struct _SPLP_PROXY_CONN* pConn;
+    int             fd;
+    enum Direction  direction;      /* of the messages read from this side */
+    unsigned int    events;         /* events the socket is registered for */
+    int             eof;            /* nothing more will be read from this side */
+    int             skipping;       /* the rest of the line follows a '\r' */
+    size_t          begin;          /* buffer[ begin, end ) is still to be sent */
+    size_t          end;
+    char            buffer[ SPLP_PROXY_BUFFER_SIZE ];
+
+} SPLP_PROXY_SIDE, *PSPLP_PROXY_SIDE;
+
+
+/* SPLP_PROXY_CONN
+* A client connection and its upstream connection
+*/
+typedef struct _SPLP_PROXY_CONN
+{
+    SPLP_PROXY_SIDE             client;         /* A */
+    SPLP_PROXY_SIDE             server;         /* B */
+    struct SplpSession          session;
+    PSPLP_PROXY_SIDE            pSpeaker;       /* side whose message is in progress, NULL between messages */
+    int                         decided;        /* the verdict of that message is already known */
+    int                         connected;      /* the upstream connection is established */
+    int                         closed;
+    struct _SPLP_PROXY_CONN*    pNextClosed;    /* connections to free after the current events */
+
+} SPLP_PROXY_CONN, *PSPLP_PROXY_CONN;
+
+
+/* SPLP_PROXY_WORKER
+* An event loop thread
+*/
+typedef struct _SPLP_PROXY_WORKER
+{
+    PSPLP_PROXY_OPTIONS pOptions;
+    int                 listenFd;
+    int                 epollFd;
+    PSPLP_PROXY_CONN    pClosed;
+    uint64_t            connections;
+    uint64_t            messages;
+    uint64_t            cut;            /* connections cut because of an invalid message */
+
+} SPLP_PROXY_WORKER, *PSPLP_PROXY_WORKER;
+
+
+
+
+static volatile sig_atomic_t SplpProxyStop = 0;
+
+static void SplpProxySignal(
+    int signo )
+{
+    (void) signo;
+    SplpProxyStop = 1;
+}
+
+
+
+
+static PSPLP_PROXY_SIDE SplpProxyPeer(
+    PSPLP_PROXY_SIDE pSide )
+{
+    PSPLP_PROXY_CONN pConn = pSide->pConn;
+
+    return pSide == &pConn->client ? &pConn->server : &pConn->client;
+}
+
+
+
+
+/* SplpProxyValidate
+* Validates buffer[ from, end ) of the side. Returns SPLP_STATUS_ERROR if
+* the connection has to be cut; end is then moved back to the first byte
+* of the message which isn't forwarded.
+*/
+static SPLP_STATUS SplpProxyValidate(
+    PSPLP_PROXY_WORKER pWorker,
+    PSPLP_PROXY_SIDE pSide,
+    size_t from )
+{
+    PSPLP_PROXY_CONN pConn = pSide->pConn;
+    size_t pos = from;
+
+    while ( pos < pSide->end )
+    {
+        const char* lineEnd = (const char*) memchr( pSide->buffer + pos, '\n', pSide->end - pos );
+        size_t pieceEnd = lineEnd ? (size_t) ( lineEnd - pSide->buffer ) : pSide->end;
+
+        if ( pConn->pSpeaker != pSide )
+        {
+            // the other side's message isn't complete yet
+            if ( pConn->pSpeaker )
+            {
+                pSide->end = pos;
+                return SPLP_STATUS_ERROR;
+            }
+            splp_stream_begin( &pConn->session, pSide->direction );
+            pConn->pSpeaker = pSide;
+            pConn->decided = 0;
+        }
+
+        if ( !pSide->skipping )
+        {
+            const char* cr = (const char*) memchr( pSide->buffer + pos, '\r', pieceEnd - pos );
+            size_t feedEnd = cr ? (size_t) ( cr - pSide->buffer ) : pieceEnd;
+
+            if ( !pConn->decided )
+            {
+                enum stream_status status = splp_stream_feed( &pConn->session, pSide->buffer + pos, feedEnd - pos );
+
+                if ( status == STREAM_INVALID )
+                {
+                    pSide->end = pos;
+                    return SPLP_STATUS_ERROR;
+                }
+                pConn->decided = status != STREAM_UNDECIDED;
+            }
+            pSide->skipping = cr != NULL;
+        }
+
+        if ( !lineEnd )
+            break;
+
+        pWorker->messages++;
+        pConn->pSpeaker = NULL;
+        pSide->skipping = 0;
+        if ( splp_stream_end( &pConn->session ) != MESSAGE_VALID )
+        {
+            pSide->end = pos;
+            return SPLP_STATUS_ERROR;
+        }
+        pos = pieceEnd + 1;
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpProxyClose
+* Closes both sockets of the connection. The connection itself is freed
+* after the events at hand, some of them may still refer to it.
+*/
+static void SplpProxyClose(
+    PSPLP_PROXY_WORKER pWorker,
+    PSPLP_PROXY_CONN pConn )
+{
+    if ( pConn->closed )
+        return;
+
+    close( pConn->client.fd );
+    if ( pConn->server.fd >= 0 )
+        close( pConn->server.fd );
+    pConn->closed = 1;
+    pConn->pNextClosed = pWorker->pClosed;
+    pWorker->pClosed = pConn;
+}
+
+
+
+
+/* SplpProxyUpdateEvents
+* Registers the side for reading if its buffer is empty and for writing
+* if the other side has bytes for it
+*/
+static void SplpProxyUpdateEvents(
+    PSPLP_PROXY_WORKER pWorker,
+    PSPLP_PROXY_SIDE pSide )
+{
+    PSPLP_PROXY_SIDE pPeer = SplpProxyPeer( pSide );
+    struct epoll_event event;
+
+    event.events = 0;
+    if ( pSide->pConn->connected )
+    {
+        if ( !pSide->eof && pSide->begin == pSide->end )
+            event.events |= EPOLLIN;
+        if ( pPeer->begin != pPeer->end )
+            event.events |= EPOLLOUT;
+    }
+    else if ( pSide == &pSide->pConn->server )
+    {
+        event.events = EPOLLOUT;    // connect( ) completes
+    }
+
+    if ( event.events != pSide->events )
+    {
+        event.data.ptr = pSide;
+        epoll_ctl( pWorker->epollFd, EPOLL_CTL_MOD, pSide->fd, &event );
+        pSide->events = event.events;
+    }
+}
+
+
+
+
+/* SplpProxyFlush
+* Sends what the side has read to the other side. Returns
+* SPLP_STATUS_ERROR if the connection is broken.
+*/
+static SPLP_STATUS SplpProxyFlush(
+    PSPLP_PROXY_SIDE pSide )
+{
+    PSPLP_PROXY_SIDE pPeer = SplpProxyPeer( pSide );
+
+    while ( pSide->begin != pSide->end )
+    {
+        ssize_t sent = send( pPeer->fd, pSide->buffer + pSide->begin, pSide->end - pSide->begin, MSG_NOSIGNAL );
+
+        if ( sent < 0 )
+            return errno == EAGAIN || errno == EWOULDBLOCK ? SPLP_STATUS_OK : SPLP_STATUS_ERROR;
+        pSide->begin += (size_t) sent;
+    }
+
+    pSide->begin = pSide->end = 0;
+    if ( pSide->eof )
+        shutdown( pPeer->fd, SHUT_WR );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpProxyRead
+* Reads, validates and forwards what the side has sent
+*/
+static void SplpProxyRead(
+    PSPLP_PROXY_WORKER pWorker,
+    PSPLP_PROXY_SIDE pSide )
+{
+    PSPLP_PROXY_CONN pConn = pSide->pConn;
+    ssize_t received = recv( pSide->fd, pSide->buffer, sizeof( pSide->buffer ), 0 );
+    SPLP_STATUS valid = SPLP_STATUS_OK;
+
+    if ( received < 0 )
+    {
+        if ( errno != EAGAIN && errno != EWOULDBLOCK )
+            SplpProxyClose( pWorker, pConn );
+        return;
+    }
+
+    pSide->begin = 0;
+    pSide->end = (size_t) received;
+    if ( received == 0 )
+        pSide->eof = 1;
+    else
+        valid = SplpProxyValidate( pWorker, pSide, 0 );
+
+    if ( SPLP_STATUS_OK != SplpProxyFlush( pSide ) || SPLP_STATUS_OK != valid ||
+        ( pConn->client.eof && pConn->server.eof && !pConn->client.end && !pConn->server.end ) )
+    {
+        // what the socket didn't take of the valid part is lost
+        if ( SPLP_STATUS_OK != valid )
+            pWorker->cut++;
+        SplpProxyClose( pWorker, pConn );
+        return;
+    }
+
+    SplpProxyUpdateEvents( pWorker, pSide );
+    SplpProxyUpdateEvents( pWorker, SplpProxyPeer( pSide ) );
+}
+
+
+
+
+/* SplpProxyWrite
+* Sends the other side's bytes to the side when it can take them
+*/
+static void SplpProxyWrite(
+    PSPLP_PROXY_WORKER pWorker,
+    PSPLP_PROXY_SIDE pSide )
+{
+    PSPLP_PROXY_CONN pConn = pSide->pConn;
+    PSPLP_PROXY_SIDE pPeer = SplpProxyPeer( pSide );
+
+    if ( !pConn->connected )
+    {
+        int error = 0;
+        socklen_t length = sizeof( error );
+
+        if ( getsockopt( pSide->fd, SOL_SOCKET, SO_ERROR, &error, &length ) || error )
+        {
+            SplpProxyClose( pWorker, pConn );
+            return;
+        }
+        pConn->connected = 1;
+    }
+    else if ( SPLP_STATUS_OK != SplpProxyFlush( pPeer ) ||
+        ( pConn->client.eof && pConn->server.eof && !pConn->client.end && !pConn->server.end ) )
+    {
+        SplpProxyClose( pWorker, pConn );
+        return;
+    }
+
+    SplpProxyUpdateEvents( pWorker, pSide );
+    SplpProxyUpdateEvents( pWorker, pPeer );
+}
+
+
+
+
+/* SplpProxyAccept
+* Accepts the waiting clients and starts connecting them upstream
+*/
+static void SplpProxyAccept(
+    PSPLP_PROXY_WORKER pWorker )
+{
+    PSPLP_PROXY_OPTIONS pOptions = pWorker->pOptions;
+
+    for ( ;; )
+    {
+        int fd = accept4( pWorker->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        PSPLP_PROXY_CONN pConn;
+        struct epoll_event event;
+        int one = 1;
+
+        if ( fd < 0 )
+            return;
+
+        pConn = (PSPLP_PROXY_CONN) calloc( 1, sizeof( SPLP_PROXY_CONN ) );
+        if ( !pConn )
+        {
+            close( fd );
+            continue;
+        }
+
+        pConn->client.pConn = pConn;
+        pConn->client.fd = fd;
+        pConn->client.direction = A_TO_B;
+        pConn->server.pConn = pConn;
+        pConn->server.direction = B_TO_A;
+        pConn->server.fd = socket( pOptions->upstream.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        splp_session_init( &pConn->session );
+        pWorker->connections++;
+
+        if ( pConn->server.fd < 0 ||
+            ( connect( pConn->server.fd, (struct sockaddr*) &pOptions->upstream, pOptions->upstreamLength ) &&
+            errno != EINPROGRESS ) )
+        {
+            SplpProxyClose( pWorker, pConn );
+            continue;
+        }
+
+        setsockopt( pConn->client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+        setsockopt( pConn->server.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+        // the client is read once the upstream connection is established
+        event.events = 0;
+        event.data.ptr = &pConn->client;
+        epoll_ctl( pWorker->epollFd, EPOLL_CTL_ADD, pConn->client.fd, &event );
+        event.events = pConn->server.events = EPOLLOUT;
+        event.data.ptr = &pConn->server;
+        epoll_ctl( pWorker->epollFd, EPOLL_CTL_ADD, pConn->server.fd, &event );
+    }
+}
+
+
+
+
+static splp_thread_result_t SPLP_THREAD_CALL SplpProxyWorkerThread(
+    void* arg )
+{
+    PSPLP_PROXY_WORKER pWorker = (PSPLP_PROXY_WORKER) arg;
+    struct epoll_event events[ SPLP_PROXY_MAX_EVENTS ];
+
+    while ( !SplpProxyStop )
+    {
+        int count = epoll_wait( pWorker->epollFd, events, SPLP_PROXY_MAX_EVENTS, SPLP_PROXY_WAIT_MSEC );
+        int i;
+
+        for ( i = 0; i < count; i++ )
+        {
+            PSPLP_PROXY_SIDE pSide = (PSPLP_PROXY_SIDE) events[ i ].data.ptr;
+
+            if ( !pSide )
+            {
+                SplpProxyAccept( pWorker );
+                continue;
+            }
+            if ( pSide->pConn->closed )
+                continue;
+
+            if ( events[ i ].events & EPOLLERR )
+                SplpProxyClose( pWorker, pSide->pConn );
+            if ( !pSide->pConn->closed && ( events[ i ].events & EPOLLOUT ) )
+                SplpProxyWrite( pWorker, pSide );
+            if ( !pSide->pConn->closed && ( events[ i ].events & ( EPOLLIN | EPOLLHUP ) ) && ( pSide->events & EPOLLIN ) )
+                SplpProxyRead( pWorker, pSide );
+        }
+
+        while ( pWorker->pClosed )
+        {
+            PSPLP_PROXY_CONN pConn = pWorker->pClosed;
+            pWorker->pClosed = pConn->pNextClosed;
+            free( pConn );
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+/* SplpProxyListen
+* Creates a listening socket sharing the port with the other threads
+*/
+static int SplpProxyListen(
+    const char* port )
+{
+    struct addrinfo hints, *pInfo;
+    int fd = -1;
+    int one = 1;
+
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if ( getaddrinfo( NULL, port, &hints, &pInfo ) )
+        return -1;
+
+    fd = socket( pInfo->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( fd >= 0 &&
+        ( setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) ) ||
+        setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof( one ) ) ||
+        bind( fd, pInfo->ai_addr, pInfo->ai_addrlen ) ||
+        listen( fd, SOMAXCONN ) ) )
+    {
+        close( fd );
+        fd = -1;
+    }
+
+    freeaddrinfo( pInfo );
+    return fd;
+}
+
+
+
+
+/* SplpProxyRun
+* Runs pOptions->threadCount event loops until SIGINT or SIGTERM
+*/
+static SPLP_STATUS SplpProxyRun(
+    PSPLP_PROXY_OPTIONS pOptions )
+{
+    SPLP_PROXY_WORKER workers[ SPLP_PROXY_MAX_THREADS ];
+    splp_thread_t threads[ SPLP_PROXY_MAX_THREADS ];
+    uint64_t connections = 0, messages = 0, cut = 0;
+    unsigned int started, i;
+
+    memset( workers, 0, sizeof( workers ) );
+    for ( i = 0; i < pOptions->threadCount; i++ )
+    {
+        struct epoll_event event;
+
+        workers[ i ].pOptions = pOptions;
+        workers[ i ].listenFd = SplpProxyListen( pOptions->listenPort );
+        workers[ i ].epollFd = epoll_create1( EPOLL_CLOEXEC );
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        if ( workers[ i ].listenFd < 0 || workers[ i ].epollFd < 0 ||
+            epoll_ctl( workers[ i ].epollFd, EPOLL_CTL_ADD, workers[ i ].listenFd, &event ) )
+        {
+            printf( "***ERROR*** Can't listen on port %s: %s\n", pOptions->listenPort, strerror( errno ) );
+            return SPLP_STATUS_ERROR;
+        }
+    }
+
+    printf( "Forwarding port %s to %s:%s on %u threads\n",
+        pOptions->listenPort, pOptions->upstreamHost, pOptions->upstreamPort, pOptions->threadCount );
+    fflush( stdout );
+
+    // the calling thread is worker 0
+    for ( started = 1; started < pOptions->threadCount; started++ )
+    {
+        if ( !splp_thread_create( &threads[ started ], SplpProxyWorkerThread, &workers[ started ] ) )
+            break;
+    }
+    SplpProxyWorkerThread( &workers[ 0 ] );
+    for ( i = 1; i < started; i++ )
+        splp_thread_join( threads[ i ] );
+
+    for ( i = 0; i < pOptions->threadCount; i++ )
+    {
+        connections += workers[ i ].connections;
+        messages += workers[ i ].messages;
+        cut += workers[ i ].cut;
+        close( workers[ i ].listenFd );
+        close( workers[ i ].epollFd );
+    }
+
+    printf( "Connections: %llu, messages: %llu, cut on invalid messages: %llu\n",
+        (unsigned long long) connections, (unsigned long long) messages, (unsigned long long) cut );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpServeReply
+* Returns the stand-in server's reply to a request, NULL to disconnect
+*/
+static const char* SplpServeReply(
+    const char* request )
+{
+    static const char* const replies[ ][ 2 ] =
+    {
+        { "CONNECT",     "CONNECT_OK\n" },
+        { "GET_VER",     "VERSION 1\n" },
+        { "GET_DATA",    "GET_DATA data.1 GET_DATA\n" },
+        { "GET_COMMAND", "GET_COMMAND ls GET_COMMAND\n" },
+        { "GET_FILE",    "GET_FILE readme.txt GET_FILE\n" },
+        { "GET_B64",     "B64: U1BMUHYx\n" },
+        { "DISCONNECT",  "DISCONNECT_OK\n" },
+    };
+    unsigned int i;
+
+    for ( i = 0; i < sizeof( replies ) / sizeof( replies[ 0 ] ); i++ )
+    {
+        if ( 0 == strcmp( request, replies[ i ][ 0 ] ) )
+            return replies[ i ][ 1 ];
+    }
+    return NULL;
+}
+
+
+
+
+static void* SplpServeThread(
+    void* arg )
+{
+    int fd = (int) (intptr_t) arg;
+    char line[ 256 ];
+    size_t length = 0;
+    int done = 0;
+
+    while ( !done )
+    {
+        char c;
+        ssize_t received = recv( fd, &c, 1, 0 );
+
+        if ( received <= 0 )
+            break;
+        if ( c != '\n' )
+        {
+            if ( length + 1 < sizeof( line ) && c != '\r' )
+                line[ length++ ] = c;
+            continue;
+        }
+
+        line[ length ] = 0;
+        length = 0;
+        {
+            const char* reply = SplpServeReply( line );
+
+            done = !reply || 0 == strcmp( line, "DISCONNECT" );
+            if ( reply )
+                send( fd, reply, strlen( reply ), MSG_NOSIGNAL );
+        }
+    }
+
+    close( fd );
+    return NULL;
+}
+
+
+
+
+/* SplpServe
+* Runs the stand-in server: a blocking thread per connection, which
+* answers every request as the protocol expects
+*/
+static SPLP_STATUS SplpServe(
+    const char* port )
+{
+    int listenFd = SplpProxyListen( port );
+
+    if ( listenFd < 0 )
+    {
+        printf( "***ERROR*** Can't listen on port %s: %s\n", port, strerror( errno ) );
+        return SPLP_STATUS_ERROR;
+    }
+
+    printf( "Serving SPLPv1 on port %s\n", port );
+    fflush( stdout );
+
+    while ( !SplpProxyStop )
+    {
+        struct epoll_event event;
+        int epollFd = epoll_create1( EPOLL_CLOEXEC );
+        int fd;
+
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        epoll_ctl( epollFd, EPOLL_CTL_ADD, listenFd, &event );
+        while ( !SplpProxyStop && epoll_wait( epollFd, &event, 1, SPLP_PROXY_WAIT_MSEC ) >= 0 )
+        {
+            while ( ( fd = accept4( listenFd, NULL, NULL, SOCK_CLOEXEC ) ) >= 0 )
+            {
+                pthread_t thread;
+
+                if ( pthread_create( &thread, NULL, SplpServeThread, (void*) (intptr_t) fd ) )
+                    close( fd );
+                else
+                    pthread_detach( thread );
+            }
+        }
+        close( epollFd );
+    }
+
+    close( listenFd );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+void SplpProxyPrintUsage( )
+{
+    printf( "usage:\n"
+        "\tsplp_proxy [options] port host upstream_port\n"
+        "\t                         - validate and forward clients on port to host:upstream_port.\n"
+        "\tsplp_proxy --serve=port  - run a stand-in SPLPv1 server to test the proxy with.\n"
+        "\toptions:\n"
+        "\t  --threads=n            - amount of event loops (one per CPU).\n" );
+}
+
+
+
+
+SPLP_STATUS SplpProxyOptionsInitializeFromCmdLine(
+    PSPLP_PROXY_OPTIONS pOptions,
+    int argc,
+    char* argv[ ] )
+{
+    SPLP_STATUS Status = SPLP_STATUS_OK;
+    const char* positional[ 3 ] = { NULL, NULL, NULL };
+    unsigned int positionalCount = 0;
+    int argIdx;
+
+    pOptions->threadCount = splp_cpu_count( );
+
+    for ( argIdx = 1; argIdx < argc && Status == SPLP_STATUS_OK; argIdx++ )
+    {
+        const char* arg = argv[ argIdx ];
+
+        if ( 0 == strncmp( arg, "--threads=", 10 ) )
+        {
+            char* end;
+            unsigned long count = strtoul( arg + 10, &end, 10 );
+            if ( !arg[ 10 ] || *end || count < 1 || count > SPLP_PROXY_MAX_THREADS )
+                Status = SPLP_STATUS_ERROR;
+            pOptions->threadCount = (unsigned int) count;
+        }
+        else if ( 0 == strncmp( arg, "--serve=", 8 ) && arg[ 8 ] )
+            pOptions->servePort = arg + 8;
+        else if ( 0 != strncmp( arg, "--", 2 ) && positionalCount < 3 )
+            positional[ positionalCount++ ] = arg;
+        else
+            Status = SPLP_STATUS_ERROR;
+    }
+
+    if ( pOptions->threadCount > SPLP_PROXY_MAX_THREADS )
+        pOptions->threadCount = SPLP_PROXY_MAX_THREADS;
+
+    if ( Status == SPLP_STATUS_OK && !pOptions->servePort )
+    {
+        struct addrinfo hints, *pInfo;
+
+        pOptions->listenPort = positional[ 0 ];
+        pOptions->upstreamHost = positional[ 1 ];
+        pOptions->upstreamPort = positional[ 2 ];
+
+        memset( &hints, 0, sizeof( hints ) );
+        hints.ai_socktype = SOCK_STREAM;
+        if ( positionalCount != 3 ||
+            getaddrinfo( pOptions->upstreamHost, pOptions->upstreamPort, &hints, &pInfo ) )
+        {
+            Status = SPLP_STATUS_ERROR;
+        }
+        else
+        {
+            memcpy( &pOptions->upstream, pInfo->ai_addr, pInfo->ai_addrlen );
+            pOptions->upstreamLength = pInfo->ai_addrlen;
+            freeaddrinfo( pInfo );
+        }
+    }
+    else if ( positionalCount )
+    {
+        Status = SPLP_STATUS_ERROR;
+    }
+
+    if ( Status != SPLP_STATUS_OK )
+    {
+        SplpProxyPrintUsage( );
+    }
+
+    return Status;
+}
+
+
+
+
+
+
+
+
+int main( int argc, char* argv[ ] )
+{
+    SPLP_PROXY_OPTIONS ProxyOptions;
+    struct sigaction action;
+    SPLP_STATUS status;
+
+    memset( &ProxyOptions, 0, sizeof( ProxyOptions ) );
+    if ( SPLP_STATUS_OK != SplpProxyOptionsInitializeFromCmdLine( &ProxyOptions, argc, argv ) )
+        return 1;
+
+    if ( !splp_dfa_init( ) )
+    {
+        printf( "***ERROR*** Protocol tables can't be compiled\n" );
+        return 1;
+    }
+
+    memset( &action, 0, sizeof( action ) );
+    action.sa_handler = SplpProxySignal;
+    sigaction( SIGINT, &action, NULL );
+    sigaction( SIGTERM, &action, NULL );
+    signal( SIGPIPE, SIG_IGN );
+
+    status = ProxyOptions.servePort ? SplpServe( ProxyOptions.servePort ) : SplpProxyRun( &ProxyOptions );
+    return status == SPLP_STATUS_OK ? 0 : 1;
+}
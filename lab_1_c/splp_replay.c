@@ -0,0 +1,150 @@
+/*
+ * splp_replay.c
+ * The file is part of practical task for System programming course.
+ * This file contains replay of captured traffic of many connections.
+ * Every message finds the session of its connection by ID in a hash
+ * table, so the cost of the lookup is measured together with the
+ * validation, as it is paid by a real multiplexed validator.
+ */
+
+#include "splp_replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define REPLAY_MIN_CAPACITY     64
+
+
+static size_t replay_slot(const struct splp_replay* replay, uint64_t id) {
+	/* Fibonacci hashing, the top bits are the best mixed */
+	return (size_t)((id * 0x9E3779B97F4A7C15ULL) >> 32) & (replay->capacity - 1);
+}
+
+
+/* finds the slot of the connection or the free slot where it belongs */
+static struct splp_connection* replay_probe(const struct splp_replay* replay, uint64_t id) {
+	size_t slot = replay_slot(replay, id);
+
+	while (replay->slots[slot].used && replay->slots[slot].id != id)
+		slot = (slot + 1) & (replay->capacity - 1);
+	return &replay->slots[slot];
+}
+
+
+/* doubles the table, returns 0 if there is no memory */
+static int replay_grow(struct splp_replay* replay) {
+	struct splp_replay grown;
+	size_t i;
+
+	grown.capacity = replay->capacity * 2;
+	grown.count = replay->count;
+	grown.slots = (struct splp_connection*)calloc(grown.capacity, sizeof(struct splp_connection));
+	if (!grown.slots)
+		return 0;
+
+	for (i = 0; i < replay->capacity; i++) {
+		if (replay->slots[i].used)
+			*replay_probe(&grown, replay->slots[i].id) = replay->slots[i];
+	}
+
+	free(replay->slots);
+	*replay = grown;
+	return 1;
+}
+
+
+int splp_replay_init(struct splp_replay* replay, size_t connection_hint) {
+	size_t capacity = REPLAY_MIN_CAPACITY;
+
+	/* at most half full */
+	while (capacity / 2 < connection_hint && capacity < ((size_t)-1 / sizeof(struct splp_connection)) / 4)
+		capacity *= 2;
+
+	replay->count = 0;
+	replay->capacity = capacity;
+	replay->slots = (struct splp_connection*)calloc(capacity, sizeof(struct splp_connection));
+	return replay->slots != NULL;
+}
+
+
+void splp_replay_free(struct splp_replay* replay) {
+	free(replay->slots);
+	replay->slots = NULL;
+	replay->capacity = 0;
+	replay->count = 0;
+}
+
+
+void splp_replay_reset(struct splp_replay* replay) {
+	memset(replay->slots, 0, replay->capacity * sizeof(struct splp_connection));
+	replay->count = 0;
+}
+
+
+struct splp_connection* splp_replay_connection(struct splp_replay* replay, uint64_t id) {
+	struct splp_connection* connection = replay_probe(replay, id);
+
+	if (connection->used)
+		return connection;
+
+	if (replay->count + 1 > replay->capacity / 2) {
+		if (!replay_grow(replay))
+			return NULL;
+		connection = replay_probe(replay, id);
+	}
+
+	connection->id = id;
+	connection->used = 1;
+	splp_session_init(&connection->session);
+	replay->count++;
+	return connection;
+}
+
+
+ /* FUNCTION:  splp_replay_views
+   *
+   * PURPOSE:
+   *    Validates interleaved messages of many connections, each one with
+   *    the session of its connection
+   *
+   * PARAMETERS:
+   *    replay - connections seen so far, new ones are added
+   *    views - array of count messages
+   *    connections - connection ID of every message
+   *    verdicts - SPLP_VERDICT_WORDS(count) words receiving the verdicts
+   *    validate - validator of a single message
+   *    expected - expected verdicts to count the wrong ones by, or NULL
+   *
+   * RETURN VALUE:
+   *    0 if there was no memory for a new connection
+   */
+int splp_replay_views(struct splp_replay* replay, const struct MessageView* views, const uint64_t* connections,
+	size_t count, uint64_t* verdicts, splp_view_validator validate, const uint64_t* expected) {
+	uint64_t word = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		struct splp_connection* connection = splp_replay_connection(replay, connections[i]);
+		uint64_t valid;
+
+		if (!connection) {
+			memset(verdicts + i / 64, 0, (SPLP_VERDICT_WORDS(count) - i / 64) * sizeof(uint64_t));
+			return 0;
+		}
+
+		valid = validate(&connection->session, &views[i]) == MESSAGE_VALID;
+		connection->messages++;
+		connection->valid += valid;
+		if (expected)
+			connection->wrong += valid != ((expected[i / 64] >> (i % 64)) & 1);
+
+		word |= valid << (i % 64);
+		if (i % 64 == 63 || i + 1 == count) {
+			verdicts[i / 64] = word;
+			word = 0;
+		}
+	}
+
+	return 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * splp_replay.h
+ * The file is part of practical task for System programming course.
+ * This file contains replay of captured traffic, where the messages of
+ * many connections are interleaved and every one carries the ID of its
+ * connection.
+ */
+
+#ifndef SPLP_REPLAY_H
+#define SPLP_REPLAY_H
+
+#include "splpv1.h"
+#include "splp_spec.h"
+
+
+/* splp_connection
+ * A connection seen in the capture and the verdicts it got.
+ */
+struct splp_connection
+{
+	uint64_t			id;
+	uint64_t			messages;
+	uint64_t			valid;            /* MESSAGE_VALID verdicts */
+	uint64_t			wrong;            /* verdicts other than the expected ones, if they were given */
+	struct SplpSession	session;
+	unsigned char		used;             /* the slot holds a connection */
+};
+
+
+/* splp_replay
+ * Connections of a capture in an open addressing hash table with
+ * linear probing, looked up on every message.
+ */
+struct splp_replay
+{
+	struct splp_connection*	slots;
+	size_t					capacity;     /* power of two */
+	size_t					count;        /* connections in the table */
+};
+
+
+/* prepares a table for about connection_hint connections, returns 0 if there is no memory */
+extern int splp_replay_init( struct splp_replay* pReplay, size_t connection_hint );
+
+extern void splp_replay_free( struct splp_replay* pReplay );
+
+/* forgets all the connections, keeping the memory */
+extern void splp_replay_reset( struct splp_replay* pReplay );
+
+/* returns the connection, adding a new one in the INIT state if it isn't
+ * known yet; NULL if there is no memory for it
+ */
+extern struct splp_connection* splp_replay_connection( struct splp_replay* pReplay, uint64_t id );
+
+/* Validates count messages, message i with the session of connection
+ * pConnections[i], and stores the verdicts as splp_validate_view_batch()
+ * does. If pExpected isn't NULL, the verdicts are compared with it and
+ * the wrong ones are counted for every connection. Returns 0 if there
+ * was no memory for a new connection; the verdicts are incomplete then.
+ */
+extern int splp_replay_views( struct splp_replay* pReplay, const struct MessageView* pViews,
+	const uint64_t* pConnections, size_t count, uint64_t* pVerdicts, splp_view_validator validate,
+	const uint64_t* pExpected );
+
+#endif /* SPLP_REPLAY_H */
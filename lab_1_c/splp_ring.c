@@ -0,0 +1,65 @@
+/*
+ * splp_ring.c
+ * The file is part of practical task for System programming course.
+ * This file contains the single producer, single consumer ring buffer
+ * which connects the stages of a pipeline.
+ */
+
+#include "splp_ring.h"
+
+#include <stdlib.h>
+
+
+int splp_ring_init(struct splp_ring* ring, size_t capacity) {
+	size_t size = 1;
+
+	while (size < capacity && size <= ((size_t)-1 / sizeof(void*)) / 2)
+		size *= 2;
+
+	ring->slots = (void**)calloc(size, sizeof(void*));
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->tail_cache = 0;
+	ring->head_cache = 0;
+	return ring->slots != NULL;
+}
+
+
+void splp_ring_free(struct splp_ring* ring) {
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+
+int splp_ring_push(struct splp_ring* ring, void* item) {
+	uint64_t head = ring->head;
+
+	if (head - ring->tail_cache > ring->mask) {
+		ring->tail_cache = splp_atomic_load_acquire64(&ring->tail);
+		if (head - ring->tail_cache > ring->mask)
+			return 0;
+	}
+
+	/* the item is written before the consumer can see the new head */
+	ring->slots[head & ring->mask] = item;
+	splp_atomic_store_release64(&ring->head, head + 1);
+	return 1;
+}
+
+
+void* splp_ring_pop(struct splp_ring* ring) {
+	uint64_t tail = ring->tail;
+	void* item;
+
+	if (tail == ring->head_cache) {
+		ring->head_cache = splp_atomic_load_acquire64(&ring->head);
+		if (tail == ring->head_cache)
+			return NULL;
+	}
+
+	/* the slot is read before the producer can see it free */
+	item = ring->slots[tail & ring->mask];
+	splp_atomic_store_release64(&ring->tail, tail + 1);
+	return item;
+}
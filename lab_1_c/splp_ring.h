@@ -0,0 +1,46 @@
+/*
+ * splp_ring.h
+ * The file is part of practical task for System programming course.
+ * This file contains a lock-free ring buffer which passes pointers from
+ * one producer thread to one consumer thread.
+ */
+
+#ifndef SPLP_RING_H
+#define SPLP_RING_H
+
+#include <stddef.h>
+#include "splp_platform.h"
+
+
+/* splp_ring
+ * The producer only writes head and the consumer only writes tail, both
+ * are counted up forever and masked to index the slots. Each side keeps
+ * the last value of the other side's index it has seen on its own cache
+ * line, and reads the shared one again only when the ring looks full
+ * (or empty) by the cached value.
+ */
+struct splp_ring
+{
+	void**						slots;
+	size_t						mask;         /* capacity - 1, capacity is a power of two */
+
+	SPLP_CACHE_ALIGNED volatile uint64_t	head;     /* next slot to put into */
+	uint64_t					tail_cache;   /* producer: tail seen last */
+
+	SPLP_CACHE_ALIGNED volatile uint64_t	tail;     /* next slot to take from */
+	uint64_t					head_cache;   /* consumer: head seen last */
+};
+
+
+/* prepares a ring for at least capacity pointers, returns 0 if there is no memory */
+extern int splp_ring_init( struct splp_ring* pRing, size_t capacity );
+
+extern void splp_ring_free( struct splp_ring* pRing );
+
+/* producer: puts the item into the ring, returns 0 if the ring is full */
+extern int splp_ring_push( struct splp_ring* pRing, void* item );
+
+/* consumer: takes the oldest item from the ring, returns NULL if the ring is empty */
+extern void* splp_ring_pop( struct splp_ring* pRing );
+
+#endif /* SPLP_RING_H */
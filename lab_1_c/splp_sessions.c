@@ -0,0 +1,684 @@
+/*
+ * splp_sessions.c
+ * The file is part of practical task for System programming course.
+ * This file contains the compact session store. A slot takes 10 bytes:
+ * the control byte, the packed session and the 64-bit connection ID, and
+ * after it has grown the table is between 25/64 and 7/8 full, so a
+ * session costs 11 to 26 bytes with no per-session allocations. After
+ * idle sessions are removed it may be emptier, down to 1/8 before it
+ * shrinks.
+ *
+ * Idle sessions are found by the epoch of their last use, kept in the
+ * spare bits of the packed session. Epochs are counted modulo 8, which
+ * is enough as every splp_sessions_advance() removes the sessions older
+ * than at most 7 epochs.
+ *
+ * Snapshot file layout, in the byte order of the machine:
+ *   header  - struct snapshot_header
+ *   indices - delta snapshot: the indices of the groups it holds, as
+ *             uint64_t, at indices_offset
+ *   groups  - the groups, at groups_offset, a multiple of
+ *             SNAPSHOT_ALIGNMENT; all of them in a full snapshot
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "splp_sessions.h"
+#include "splp_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SESSIONS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+#define SESSION_EMPTY       0x80
+#define SESSION_DELETED     0xFE
+#define SESSIONS_MIN_GROUPS 4
+#define SESSIONS_BATCH      16      /* messages whose groups are prefetched together */
+
+#define SNAPSHOT_MAGIC      "SPLPSES1"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_FULL       0
+#define SNAPSHOT_DELTA      1
+#define SNAPSHOT_ALIGNMENT  64
+
+#define SESSION_PACK(session, epoch)   ((unsigned char)((session)->state | (session)->command << 3 | (epoch) << 5))
+#define SESSION_EPOCH(packed)          ((packed) >> 5)
+
+
+struct snapshot_header
+{
+	char		magic[8];           /* SNAPSHOT_MAGIC */
+	uint32_t	version;            /* SNAPSHOT_VERSION */
+	uint32_t	header_size;
+	uint32_t	group_size;         /* sizeof(struct splp_session_group) of the build which wrote it */
+	uint32_t	kind;               /* SNAPSHOT_FULL or SNAPSHOT_DELTA */
+	uint64_t	chain;
+	uint64_t	generation;         /* 1 for the full snapshot, a delta is one more than the one before */
+	uint64_t	group_count;        /* of the table */
+	uint64_t	group_records;      /* groups in the file */
+	uint64_t	count;
+	uint64_t	deleted;
+	uint64_t	peak;
+	uint64_t	epoch;
+	uint64_t	indices_offset;
+	uint64_t	groups_offset;
+	uint64_t	file_size;
+};
+
+
+static uint64_t sessions_hash(uint64_t id) {
+	/* the finalizer of MurmurHash3, every bit of the ID affects the group and the control byte */
+	id ^= id >> 33;
+	id *= 0xFF51AFD7ED558CCDULL;
+	id ^= id >> 33;
+	return id;
+}
+
+
+static struct splp_session_group* sessions_home(const struct splp_sessions* sessions, uint64_t hash) {
+	return &sessions->groups[(size_t)(hash >> 7) & (sessions->group_count - 1)];
+}
+
+
+/* the group goes into the next delta snapshot */
+static void sessions_touch(struct splp_sessions* sessions, const struct splp_session_group* group) {
+	if (sessions->dirty) {
+		size_t g = (size_t)(group - sessions->groups);
+		sessions->dirty[g / 64] |= 1ULL << (g % 64);
+	}
+}
+
+
+/* bit i is set if control byte i equals value */
+static unsigned int group_match(const struct splp_session_group* group, unsigned char value) {
+#if defined( SESSIONS_SSE2 )
+	__m128i control = _mm_loadu_si128((const __m128i*)group->control);
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)value)));
+#else
+	unsigned int mask = 0;
+	unsigned int i;
+
+	for (i = 0; i < SPLP_SESSIONS_GROUP; i++)
+		mask |= (unsigned int)(group->control[i] == value) << i;
+	return mask;
+#endif
+}
+
+
+/* bit i is set if slot i is empty or deleted */
+static unsigned int group_free(const struct splp_session_group* group) {
+#if defined( SESSIONS_SSE2 )
+	return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group->control));
+#else
+	unsigned int mask = 0;
+	unsigned int i;
+
+	for (i = 0; i < SPLP_SESSIONS_GROUP; i++)
+		mask |= (unsigned int)(group->control[i] >> 7) << i;
+	return mask;
+#endif
+}
+
+
+/* finds the slot of the connection, returns its group or NULL */
+static struct splp_session_group* sessions_find(const struct splp_sessions* sessions, uint64_t id, uint64_t hash,
+	unsigned int* index) {
+	size_t mask = sessions->group_count - 1;
+	size_t g = (size_t)(hash >> 7) & mask;
+	size_t step = 0;
+
+	for (;;) {
+		struct splp_session_group* group = &sessions->groups[g];
+		unsigned int match = group_match(group, (unsigned char)(hash & 0x7F));
+
+		while (match) {
+			unsigned int i = splp_ctz64(match);
+			if (group->ids[i] == id) {
+				*index = i;
+				return group;
+			}
+			match &= match - 1;
+		}
+
+		/* a probe goes past a group only when it is full */
+		if (group_match(group, SESSION_EMPTY))
+			return NULL;
+		g = (g + ++step) & mask;
+	}
+}
+
+
+/* puts a session which isn't in the table into the first free slot of its probe sequence */
+static void sessions_place(struct splp_sessions* sessions, uint64_t id, uint64_t hash, unsigned char packed) {
+	size_t mask = sessions->group_count - 1;
+	size_t g = (size_t)(hash >> 7) & mask;
+	size_t step = 0;
+	unsigned int free_slots;
+	unsigned int i;
+
+	while (!(free_slots = group_free(&sessions->groups[g])))
+		g = (g + ++step) & mask;
+
+	i = splp_ctz64(free_slots);
+	if (sessions->groups[g].control[i] == SESSION_DELETED)
+		sessions->deleted--;
+	sessions->groups[g].control[i] = (unsigned char)(hash & 0x7F);
+	sessions->groups[g].packed[i] = packed;
+	sessions->groups[g].ids[i] = id;
+	sessions->count++;
+	sessions_touch(sessions, &sessions->groups[g]);
+}
+
+
+static struct splp_session_group* sessions_alloc(size_t group_count) {
+	struct splp_session_group* groups;
+	size_t g;
+
+	if (group_count > (size_t)-1 / sizeof(struct splp_session_group))
+		return NULL;
+	/* a group then takes the fewest cache lines, see the prefetches in splp_sessions_validate() */
+	groups = (struct splp_session_group*)splp_alloc_cache_aligned(group_count * sizeof(struct splp_session_group));
+	for (g = 0; groups && g < group_count; g++)
+		memset(groups[g].control, SESSION_EMPTY, SPLP_SESSIONS_GROUP);
+	return groups;
+}
+
+
+static void sessions_release(struct splp_sessions* sessions, struct splp_session_group* groups) {
+	if (sessions->mapping) {
+		splp_unmap_file(sessions->mapping, sessions->mapping_size);
+		sessions->mapping = NULL;
+	}
+	else {
+		splp_free_cache_aligned(groups);
+	}
+}
+
+
+/* stops counting the changed groups */
+static void sessions_untrack(struct splp_sessions* sessions) {
+	free(sessions->dirty);
+	sessions->dirty = NULL;
+}
+
+
+/* moves the sessions into a new table, which drops the deleted slots;
+ * it is twice as large if the sessions take more than 25/32 of the old
+ * one, otherwise there would be a rehash again soon, and it is halved
+ * as long as the sessions take at most a quarter of it
+ */
+static int sessions_rehash(struct splp_sessions* sessions) {
+	struct splp_session_group* old_groups = sessions->groups;
+	size_t old_count = sessions->group_count;
+	size_t group_count = old_count;
+	size_t g;
+	unsigned int i;
+
+	if ((sessions->count + 1) * 32 > group_count * SPLP_SESSIONS_GROUP * 25)
+		group_count *= 2;
+	while (group_count > SESSIONS_MIN_GROUPS && (sessions->count + 1) * 4 <= group_count / 2 * SPLP_SESSIONS_GROUP)
+		group_count /= 2;
+
+	sessions->groups = sessions_alloc(group_count);
+	if (!sessions->groups) {
+		sessions->groups = old_groups;
+		return 0;
+	}
+
+	/* the slots move, the next snapshot has to be a full one */
+	sessions_untrack(sessions);
+	sessions->group_count = group_count;
+	sessions->count = 0;
+	sessions->deleted = 0;
+	for (g = 0; g < old_count; g++) {
+		for (i = 0; i < SPLP_SESSIONS_GROUP; i++) {
+			if (!(old_groups[g].control[i] & 0x80))
+				sessions_place(sessions, old_groups[g].ids[i], sessions_hash(old_groups[g].ids[i]), old_groups[g].packed[i]);
+		}
+	}
+
+	sessions_release(sessions, old_groups);
+	return 1;
+}
+
+
+static void sessions_remove(struct splp_sessions* sessions, struct splp_session_group* group, unsigned int index) {
+	/* no probe went past a group with an empty slot, so the slot can be empty again */
+	if (group_match(group, SESSION_EMPTY)) {
+		group->control[index] = SESSION_EMPTY;
+	}
+	else {
+		group->control[index] = SESSION_DELETED;
+		sessions->deleted++;
+	}
+	sessions->count--;
+	sessions_touch(sessions, group);
+}
+
+
+/* stores the session found in group (NULL if it wasn't there), returns 0 if there is no memory */
+static int sessions_store(struct splp_sessions* sessions, struct splp_session_group* group, unsigned int index,
+	uint64_t id, uint64_t hash, const struct SplpSession* session) {
+	if (session->state == 1 && session->command == 0) {
+		if (group)
+			sessions_remove(sessions, group, index);
+		return 1;
+	}
+
+	if (group) {
+		unsigned char packed = SESSION_PACK(session, sessions->epoch);
+
+		if (group->packed[index] != packed) {
+			group->packed[index] = packed;
+			sessions_touch(sessions, group);
+		}
+		return 1;
+	}
+
+	/* at most 7/8 of the slots are taken, so every probe sequence meets an empty one */
+	if ((sessions->count + sessions->deleted + 1) * 8 > sessions->group_count * SPLP_SESSIONS_GROUP * 7 &&
+		!sessions_rehash(sessions))
+		return 0;
+
+	sessions_place(sessions, id, hash, SESSION_PACK(session, sessions->epoch));
+	if (sessions->count > sessions->peak)
+		sessions->peak = sessions->count;
+	return 1;
+}
+
+
+static void sessions_unpack(unsigned char packed, struct SplpSession* session) {
+	session->state = packed & 7;
+	session->command = (packed >> 3) & 3;
+	session->position = 0;
+}
+
+
+int splp_sessions_init(struct splp_sessions* sessions, size_t session_hint) {
+	size_t group_count = SESSIONS_MIN_GROUPS;
+
+	/* at most half full */
+	while (group_count * SPLP_SESSIONS_GROUP / 2 < session_hint && group_count < ((size_t)-1 >> 8))
+		group_count *= 2;
+
+	memset(sessions, 0, sizeof(*sessions));
+	sessions->groups = sessions_alloc(group_count);
+	sessions->group_count = sessions->groups ? group_count : 0;
+	return sessions->groups != NULL;
+}
+
+
+void splp_sessions_free(struct splp_sessions* sessions) {
+	sessions_release(sessions, sessions->groups);
+	sessions_untrack(sessions);
+	memset(sessions, 0, sizeof(*sessions));
+}
+
+
+void splp_sessions_clear(struct splp_sessions* sessions) {
+	size_t g;
+
+	for (g = 0; g < sessions->group_count; g++)
+		memset(sessions->groups[g].control, SESSION_EMPTY, SPLP_SESSIONS_GROUP);
+	sessions->count = 0;
+	sessions->deleted = 0;
+	sessions_untrack(sessions);
+}
+
+
+int splp_sessions_copy(struct splp_sessions* sessions, const struct splp_sessions* source) {
+	struct splp_session_group* groups = sessions->groups;
+
+	/* the groups are reused if they are allocated and of the same size */
+	if (sessions->mapping || !groups || sessions->group_count != source->group_count) {
+		groups = sessions_alloc(source->group_count);
+		if (!groups)
+			return 0;
+		sessions_release(sessions, sessions->groups);
+	}
+	memcpy(groups, source->groups, source->group_count * sizeof(struct splp_session_group));
+
+	sessions_untrack(sessions);
+	sessions->groups = groups;
+	sessions->group_count = source->group_count;
+	sessions->count = source->count;
+	sessions->deleted = source->deleted;
+	sessions->peak = source->peak;
+	sessions->epoch = source->epoch;
+	sessions->mapping_size = 0;
+	sessions->chain = source->chain;
+	sessions->generation = source->generation;
+	return 1;
+}
+
+
+void splp_sessions_get(struct splp_sessions* sessions, uint64_t id, struct SplpSession* session) {
+	unsigned int index;
+	struct splp_session_group* group = sessions_find(sessions, id, sessions_hash(id), &index);
+
+	if (group) {
+		unsigned char packed;
+
+		sessions_unpack(group->packed[index], session);
+		packed = SESSION_PACK(session, sessions->epoch);
+		if (group->packed[index] != packed) {
+			group->packed[index] = packed;
+			sessions_touch(sessions, group);
+		}
+	}
+	else {
+		splp_session_init(session);
+	}
+}
+
+
+size_t splp_sessions_advance(struct splp_sessions* sessions, unsigned int idle_epochs) {
+	size_t removed = 0;
+	size_t g;
+	unsigned int i;
+
+	if (idle_epochs > SPLP_SESSIONS_MAX_IDLE)
+		idle_epochs = SPLP_SESSIONS_MAX_IDLE;
+	sessions->epoch = (sessions->epoch + 1) & 7;
+
+	for (g = 0; g < sessions->group_count; g++) {
+		struct splp_session_group* group = &sessions->groups[g];
+		unsigned int used = ~group_free(group) & ((1u << SPLP_SESSIONS_GROUP) - 1);
+
+		while (used) {
+			i = splp_ctz64(used);
+			if (((sessions->epoch - SESSION_EPOCH(group->packed[i])) & 7) > idle_epochs) {
+				sessions_remove(sessions, group, i);
+				removed++;
+			}
+			used &= used - 1;
+		}
+	}
+
+	/* many deleted slots make probe sequences long, and a table at most
+	 * 1/8 full is mostly memory nothing uses */
+	if (sessions->deleted > sessions->group_count * SPLP_SESSIONS_GROUP / 4 ||
+		(sessions->group_count > SESSIONS_MIN_GROUPS && sessions->count * 8 <= sessions->group_count * SPLP_SESSIONS_GROUP))
+		sessions_rehash(sessions);
+	return removed;
+}
+
+
+size_t splp_sessions_memory(const struct splp_sessions* sessions) {
+	return sizeof(*sessions) + sessions->group_count * sizeof(struct splp_session_group);
+}
+
+
+static size_t snapshot_align(size_t offset) {
+	return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+
+/* starts the tracking of the changes for the next delta, all groups are as in the last snapshot */
+static void sessions_track(struct splp_sessions* sessions) {
+	size_t words = (sessions->group_count + 63) / 64;
+
+	if (!sessions->dirty)
+		sessions->dirty = (uint64_t*)malloc(words * sizeof(uint64_t));
+	if (sessions->dirty)
+		memset(sessions->dirty, 0, words * sizeof(uint64_t));
+}
+
+
+/* writes the snapshot of the groups marked in dirty, or of all of them if
+ * it is NULL; a full snapshot starts a new chain unless it goes on with it
+ */
+static uint64_t snapshot_write(struct splp_sessions* sessions, const char* file_name, const uint64_t* dirty, int chained) {
+	static const char padding[SNAPSHOT_ALIGNMENT];
+	struct snapshot_header header;
+	size_t words = (sessions->group_count + 63) / 64;
+	size_t records = sessions->group_count;
+	size_t w;
+	uint64_t g;
+	FILE* file;
+	int written;
+
+	if (dirty) {
+		records = 0;
+		for (w = 0; w < words; w++)
+			records += splp_popcount64(dirty[w]);
+
+		/* with the indices such a delta would be larger than the full snapshot */
+		if (records * (sizeof(uint64_t) + sizeof(struct splp_session_group)) >= sessions->group_count * sizeof(struct splp_session_group)) {
+			dirty = NULL;
+			records = sessions->group_count;
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.header_size = sizeof(header);
+	header.group_size = sizeof(struct splp_session_group);
+	header.kind = dirty ? SNAPSHOT_DELTA : SNAPSHOT_FULL;
+	header.chain = chained ? sessions->chain :
+		sessions_hash(splp_clock_ns() ^ (uint64_t)time(NULL) << 20 ^ (uint64_t)(size_t)sessions);
+	header.generation = chained ? sessions->generation + 1 : 1;
+	header.group_count = sessions->group_count;
+	header.group_records = records;
+	header.count = sessions->count;
+	header.deleted = sessions->deleted;
+	header.peak = sessions->peak;
+	header.epoch = sessions->epoch;
+	header.indices_offset = snapshot_align(sizeof(header));
+	header.groups_offset = dirty ? snapshot_align(header.indices_offset + records * sizeof(uint64_t)) : header.indices_offset;
+	header.file_size = header.groups_offset + records * sizeof(struct splp_session_group);
+
+	file = fopen(file_name, "wb");
+	if (!file)
+		return 0;
+
+	written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(padding, 1, header.indices_offset - sizeof(header), file) == header.indices_offset - sizeof(header);
+
+	if (dirty) {
+		for (g = 0; written && g < sessions->group_count; g++) {
+			if (dirty[g / 64] & (1ULL << (g % 64)))
+				written = fwrite(&g, sizeof(g), 1, file) == 1;
+		}
+		written = written && fwrite(padding, 1, (size_t)(header.groups_offset - header.indices_offset - records * sizeof(uint64_t)),
+			file) == header.groups_offset - header.indices_offset - records * sizeof(uint64_t);
+		for (g = 0; written && g < sessions->group_count; g++) {
+			if (dirty[g / 64] & (1ULL << (g % 64)))
+				written = fwrite(&sessions->groups[g], sizeof(struct splp_session_group), 1, file) == 1;
+		}
+	}
+	else {
+		/* the whole table at once, as it is in memory */
+		written = written && fwrite(sessions->groups, sizeof(struct splp_session_group), records, file) == records;
+	}
+
+	if (fclose(file) != 0 || !written)
+		return 0;
+
+	sessions->chain = header.chain;
+	sessions->generation = header.generation;
+	sessions_track(sessions);
+	return header.file_size;
+}
+
+
+uint64_t splp_sessions_save(struct splp_sessions* sessions, const char* file_name) {
+	return snapshot_write(sessions, file_name, NULL, 0);
+}
+
+
+uint64_t splp_sessions_save_delta(struct splp_sessions* sessions, const char* file_name) {
+	return snapshot_write(sessions, file_name, sessions->dirty, sessions->generation != 0);
+}
+
+
+/* maps a snapshot and checks its header, returns NULL if it isn't one */
+static const struct snapshot_header* snapshot_map(const char* file_name, int copy, size_t* size) {
+	const struct snapshot_header* header = (const struct snapshot_header*)splp_map_file_mode(file_name, size, copy);
+
+	if (!header)
+		return NULL;
+	if (*size < sizeof(*header) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SNAPSHOT_VERSION || header->header_size != sizeof(*header) ||
+		header->group_size != sizeof(struct splp_session_group) || header->file_size != *size ||
+		!header->group_count || (header->group_count & (header->group_count - 1)) ||
+		header->group_records > header->group_count ||
+		(header->kind == SNAPSHOT_FULL && header->group_records != header->group_count) ||
+		header->indices_offset < sizeof(*header) || header->groups_offset % SNAPSHOT_ALIGNMENT ||
+		header->groups_offset < header->indices_offset + (header->kind == SNAPSHOT_DELTA ? header->group_records * sizeof(uint64_t) : 0) ||
+		header->groups_offset + header->group_records * sizeof(struct splp_session_group) != *size ||
+		header->count + header->deleted > header->group_count * SPLP_SESSIONS_GROUP) {
+		splp_unmap_file((void*)header, *size);
+		return NULL;
+	}
+	return header;
+}
+
+
+int splp_sessions_restore(struct splp_sessions* sessions, const char* file_name) {
+	size_t size;
+	const struct snapshot_header* header = snapshot_map(file_name, 1, &size);
+
+	memset(sessions, 0, sizeof(*sessions));
+	if (!header)
+		return 0;
+	if (header->kind != SNAPSHOT_FULL) {
+		splp_unmap_file((void*)header, size);
+		return 0;
+	}
+
+	/* the table is used where it lies in the mapping */
+	sessions->mapping = (void*)header;
+	sessions->mapping_size = size;
+	sessions->groups = (struct splp_session_group*)((char*)sessions->mapping + header->groups_offset);
+	sessions->group_count = (size_t)header->group_count;
+	sessions->count = (size_t)header->count;
+	sessions->deleted = (size_t)header->deleted;
+	sessions->peak = (size_t)header->peak;
+	sessions->epoch = (unsigned char)(header->epoch & 7);
+	sessions->chain = header->chain;
+	sessions->generation = header->generation;
+	sessions_track(sessions);
+	return 1;
+}
+
+
+int splp_sessions_apply(struct splp_sessions* sessions, const char* file_name) {
+	size_t size;
+	const struct snapshot_header* header = snapshot_map(file_name, 0, &size);
+	const uint64_t* indices;
+	const struct splp_session_group* groups;
+	uint64_t r;
+
+	if (!header)
+		return 0;
+
+	/* the table was resized before this snapshot, it is a full one */
+	if (header->kind == SNAPSHOT_FULL) {
+		struct splp_sessions restored;
+		int chained = header->chain == sessions->chain && header->generation == sessions->generation + 1;
+
+		splp_unmap_file((void*)header, size);
+		if (!chained || !splp_sessions_restore(&restored, file_name))
+			return 0;
+		splp_sessions_free(sessions);
+		*sessions = restored;
+		return 1;
+	}
+
+	indices = (const uint64_t*)((const char*)header + header->indices_offset);
+	groups = (const struct splp_session_group*)((const char*)header + header->groups_offset);
+	for (r = 0; r < header->group_records && indices[r] < sessions->group_count; r++)
+		;
+	if (header->chain != sessions->chain || header->generation != sessions->generation + 1 ||
+		header->group_count != sessions->group_count || r < header->group_records) {
+		splp_unmap_file((void*)header, size);
+		return 0;
+	}
+
+	for (r = 0; r < header->group_records; r++)
+		memcpy(&sessions->groups[indices[r]], &groups[r], sizeof(struct splp_session_group));
+
+	sessions->count = (size_t)header->count;
+	sessions->deleted = (size_t)header->deleted;
+	sessions->peak = (size_t)header->peak;
+	sessions->epoch = (unsigned char)(header->epoch & 7);
+	sessions->generation = header->generation;
+	splp_unmap_file((void*)header, size);
+	sessions_track(sessions);
+	return 1;
+}
+
+
+ /* FUNCTION:  splp_sessions_validate
+   *
+   * PURPOSE:
+   *    Validates interleaved messages of many connections, each one with
+   *    the session of its connection kept in the store
+   *
+   * PARAMETERS:
+   *    sessions - sessions of the connections, updated
+   *    views - array of count messages
+   *    connections - connection ID of every message
+   *    verdicts - SPLP_VERDICT_WORDS(count) words receiving the verdicts
+   *    validate - validator of a single message
+   *
+   * RETURN VALUE:
+   *    0 if there was no memory for a new session
+   */
+int splp_sessions_validate(struct splp_sessions* sessions, const struct MessageView* views,
+	const uint64_t* connections, size_t count, uint64_t* verdicts, splp_view_validator validate) {
+	uint64_t hashes[SESSIONS_BATCH];
+	uint64_t word = 0;
+	size_t base, i;
+
+	for (base = 0; base < count; base += SESSIONS_BATCH) {
+		size_t batch = count - base < SESSIONS_BATCH ? count - base : SESSIONS_BATCH;
+
+		/* the groups of a batch are mostly cache misses, they are loaded in parallel */
+		for (i = 0; i < batch; i++) {
+			const struct splp_session_group* group;
+
+			hashes[i] = sessions_hash(connections[base + i]);
+			group = sessions_home(sessions, hashes[i]);
+			/* the groups start at 0 or 32 bytes into a cache line and take three of them */
+			splp_prefetch((const char*)group);
+			splp_prefetch((const char*)group + 64);
+			splp_prefetch((const char*)(group + 1) - 1);
+		}
+
+		for (i = 0; i < batch; i++) {
+			size_t m = base + i;
+			unsigned int index = 0;
+			struct splp_session_group* group = sessions_find(sessions, connections[m], hashes[i], &index);
+			struct SplpSession session;
+			uint64_t valid;
+
+			if (group)
+				sessions_unpack(group->packed[index], &session);
+			else
+				splp_session_init(&session);
+
+			valid = validate(&session, &views[m]) == MESSAGE_VALID;
+			if (!sessions_store(sessions, group, index, connections[m], hashes[i], &session)) {
+				memset(verdicts + m / 64, 0, (SPLP_VERDICT_WORDS(count) - m / 64) * sizeof(uint64_t));
+				return 0;
+			}
+
+			word |= valid << (m % 64);
+			if (m % 64 == 63 || m + 1 == count) {
+				verdicts[m / 64] = word;
+				word = 0;
+			}
+		}
+	}
+
+	return 1;
+}
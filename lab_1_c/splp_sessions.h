@@ -0,0 +1,129 @@
+/*
+ * splp_sessions.h
+ * The file is part of practical task for System programming course.
+ * This file contains a compact store of the sessions of many connections,
+ * keyed by connection ID, for millions of open connections at once.
+ */
+
+#ifndef SPLP_SESSIONS_H
+#define SPLP_SESSIONS_H
+
+#include "splpv1.h"
+#include "splp_spec.h"
+
+
+#define SPLP_SESSIONS_GROUP       16      /* slots of a group, searched at once */
+#define SPLP_SESSIONS_MAX_IDLE    6       /* longest idle time splp_sessions_advance() can keep */
+
+
+/* splp_session_group
+ * Slots of the table. A control byte tells if a slot is empty, deleted,
+ * or holds a session, then it is 7 bits of the hash of its ID. The
+ * session is packed into a byte: state in bits 0-2, command in bits 3-4
+ * and the epoch of its last use in bits 5-7.
+ */
+struct splp_session_group
+{
+	unsigned char	control[SPLP_SESSIONS_GROUP];
+	unsigned char	packed[SPLP_SESSIONS_GROUP];
+	uint64_t		ids[SPLP_SESSIONS_GROUP];
+};
+
+
+/* splp_sessions
+ * Open addressing hash table of groups, in the manner of SwissTable: a
+ * lookup compares the control bytes of a whole group with the hash at
+ * once and goes on to the next group of the probe sequence only if the
+ * group is full. A session in the INIT state is the same as no session,
+ * so it isn't kept: connections between sessions cost nothing.
+ * A table restored from a snapshot keeps its groups in the mapping of
+ * the snapshot file until it is resized.
+ */
+struct splp_sessions
+{
+	struct splp_session_group*	groups;
+	size_t						group_count;  /* power of two */
+	size_t						count;        /* sessions in the table */
+	size_t						deleted;      /* slots of removed sessions, still in probe sequences */
+	size_t						peak;         /* most sessions held at once */
+	unsigned char				epoch;        /* current epoch, 0 .. 7 */
+
+	void*						mapping;      /* snapshot file the groups are in, NULL if they are allocated */
+	size_t						mapping_size;
+	uint64_t*					dirty;        /* bit per group changed since the last snapshot, NULL if
+	                                             the next snapshot has to be a full one */
+	uint64_t					chain;        /* full snapshot the last one was or was based on */
+	uint64_t					generation;   /* snapshots in the chain up to the last one */
+};
+
+
+/* prepares a table for about session_hint sessions, returns 0 if there is no memory */
+extern int splp_sessions_init( struct splp_sessions* pSessions, size_t session_hint );
+
+extern void splp_sessions_free( struct splp_sessions* pSessions );
+
+/* removes all the sessions, keeping the memory */
+extern void splp_sessions_clear( struct splp_sessions* pSessions );
+
+/* Makes the table an allocated copy of source, which may be restored
+ * from a snapshot; the changes aren't tracked. Returns 0 if there is no
+ * memory, the table doesn't change then.
+ */
+extern int splp_sessions_copy( struct splp_sessions* pSessions, const struct splp_sessions* pSource );
+
+/* returns the session of the connection, INIT if there is none, and
+ * marks it as used in the current epoch
+ */
+extern void splp_sessions_get( struct splp_sessions* pSessions, uint64_t id, struct SplpSession* pSession );
+
+/* Starts the next epoch and removes, all at once, the sessions which
+ * weren't used in the last idle_epochs epochs (0 .. SPLP_SESSIONS_MAX_IDLE).
+ * It has to be called once per epoch, as the epochs wrap around after 8.
+ * A table left mostly empty shrinks. Returns the amount of removed
+ * sessions.
+ */
+extern size_t splp_sessions_advance( struct splp_sessions* pSessions, unsigned int idle_epochs );
+
+/* memory held by the table, in bytes */
+extern size_t splp_sessions_memory( const struct splp_sessions* pSessions );
+
+/* Snapshots
+ * A full snapshot is the groups of the table as they are in memory, after
+ * a header. It is restored by mapping the file copy-on-write: no session
+ * is read or copied, pages are loaded when they are touched. A delta
+ * snapshot holds only the groups changed since the previous snapshot of
+ * its chain and is applied by copying them back whole. After a resize of
+ * the table a delta can't be applied to the old groups, so the next
+ * snapshot is a full one whichever function writes it. Only the headers
+ * are checked: the groups are trusted like the memory they came from.
+ */
+
+/* writes all the sessions to the file, returns its size or 0 if it can't be written */
+extern uint64_t splp_sessions_save( struct splp_sessions* pSessions, const char* fileName );
+
+/* writes the groups changed since the last snapshot, or all of them if
+ * there was none, the table has been resized since or a delta wouldn't
+ * be smaller; returns the size of the file or 0 if it can't be written
+ */
+extern uint64_t splp_sessions_save_delta( struct splp_sessions* pSessions, const char* fileName );
+
+/* Makes a table of the sessions of a full snapshot, instead of
+ * splp_sessions_init(). Returns 0 if the file can't be mapped or isn't
+ * a snapshot of this build.
+ */
+extern int splp_sessions_restore( struct splp_sessions* pSessions, const char* fileName );
+
+/* Applies the next snapshot of the chain of the table. Returns 0 if the
+ * file can't be read or isn't that snapshot, the table doesn't change
+ * then.
+ */
+extern int splp_sessions_apply( struct splp_sessions* pSessions, const char* fileName );
+
+/* Same as splp_replay_views() without per-connection counters. The
+ * messages are taken in batches: the groups of a whole batch are
+ * prefetched before the first of its messages is validated.
+ */
+extern int splp_sessions_validate( struct splp_sessions* pSessions, const struct MessageView* pViews,
+	const uint64_t* pConnections, size_t count, uint64_t* pVerdicts, splp_view_validator validate );
+
+#endif /* SPLP_SESSIONS_H */
@@ -0,0 +1,231 @@
+/*
+ * splp_spec.c
+ * The file is part of practical task for System programming course.
+ * This file contains speculative parallel validation of a single long
+ * stream of messages.
+ *
+ * Between messages a session can only be in INIT or in a configuration
+ * a valid message leaves it in; splpcompile lists them in splp_tables.h
+ * (9 for SPLPv1: states 1, 2, 3, 4, 6, 7 without a command and state 5
+ * with command 1, 2 or 3). Every chunk but the first is validated from
+ * all of them at once, which gives the session each of them ends the
+ * chunk in, and the verdicts for each of them. Lanes which reach the
+ * same session follow the same path from then on and are merged. Every
+ * invalid message and every DISCONNECT_OK moves all lanes to INIT, so
+ * usually after a few messages a single lane is left and the rest of the
+ * chunk is validated once, straight into the caller's verdicts. After
+ * all the chunks are done, the real session is carried from chunk to
+ * chunk through their end states, which picks the lane of every chunk.
+ */
+
+#include "splp_spec.h"
+#include "splp_platform.h"
+#include "splp_tables.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define SPEC_LANES          SPLP_TABLE_LANE_COUNT
+#define SPEC_MAX_CHUNKS     64
+#define SPEC_MIN_CHUNK      4096    /* messages, shorter streams use fewer threads */
+
+/* session every lane starts from */
+static const struct spec_lane {
+	unsigned char state;
+	unsigned char command;
+} lanes[SPEC_LANES] = { SPLP_TABLE_LANES };
+
+struct spec_chunk {
+	const struct MessageView* messages;     /* first message of the chunk */
+	size_t count;
+	uint64_t* verdicts;                     /* verdicts of the chunk, word aligned */
+	splp_view_validator validate;
+	int speculate;                          /* 0 for the first chunk, which starts from the known session */
+	struct SplpSession end[SPEC_LANES];     /* session after the chunk, by start lane */
+	size_t converged;                       /* messages validated before a single lane was left */
+	uint64_t* lane_verdicts;                /* verdicts of these messages, SPEC_LANES bitmaps */
+	int failed;                             /* out of memory, the chunk must be validated sequentially */
+};
+
+
+/* lane of the session, -1 if it isn't a configuration between messages */
+static int spec_lane(const struct SplpSession* session) {
+	int lane;
+
+	for (lane = 0; lane < SPEC_LANES; lane++) {
+		if (session->state == lanes[lane].state && session->command == lanes[lane].command)
+			return lane;
+	}
+	return -1;
+}
+
+
+/* validates messages [from, count) of the chunk from the session, ORing the verdicts in */
+static void spec_run_sequential(struct spec_chunk* chunk, struct SplpSession* session, size_t from) {
+	size_t i;
+
+	for (i = from; i < chunk->count; i++) {
+		if (chunk->validate(session, &chunk->messages[i]) == MESSAGE_VALID)
+			chunk->verdicts[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+}
+
+
+static splp_thread_result_t SPLP_THREAD_CALL spec_run_chunk(void* arg) {
+	struct spec_chunk* chunk = (struct spec_chunk*)arg;
+	struct SplpSession sessions[SPEC_LANES];
+	unsigned int rep[SPEC_LANES];           /* lane which is validated for the lane */
+	size_t words = SPLP_VERDICT_WORDS(chunk->count);
+	unsigned int active = SPEC_LANES;
+	unsigned int lane, other;
+	size_t i;
+
+	memset(chunk->verdicts, 0, words * sizeof(uint64_t));
+	if (!chunk->speculate) {
+		spec_run_sequential(chunk, &chunk->end[0], 0);
+		return 0;
+	}
+
+	chunk->lane_verdicts = (uint64_t*)calloc(SPEC_LANES * words, sizeof(uint64_t));
+	if (!chunk->lane_verdicts) {
+		chunk->failed = 1;
+		return 0;
+	}
+
+	for (lane = 0; lane < SPEC_LANES; lane++) {
+		splp_session_init(&sessions[lane]);
+		sessions[lane].state = lanes[lane].state;
+		sessions[lane].command = lanes[lane].command;
+		rep[lane] = lane;
+	}
+
+	for (i = 0; i < chunk->count && active > 1; i++) {
+		uint64_t bit = (uint64_t)1 << (i % 64);
+
+		for (lane = 0; lane < SPEC_LANES; lane++) {
+			if (rep[lane] == lane && chunk->validate(&sessions[lane], &chunk->messages[i]) == MESSAGE_VALID)
+				chunk->lane_verdicts[lane * words + i / 64] |= bit;
+		}
+
+		for (lane = 0; lane < SPEC_LANES; lane++) {
+			if (rep[lane] != lane)
+				chunk->lane_verdicts[lane * words + i / 64] |= chunk->lane_verdicts[rep[lane] * words + i / 64] & bit;
+		}
+
+		/* merge the lanes which reached the same session, they differ at most in this verdict */
+		for (lane = 1; lane < SPEC_LANES; lane++) {
+			if (rep[lane] != lane)
+				continue;
+			for (other = 0; other < lane; other++) {
+				if (rep[other] == other && sessions[other].state == sessions[lane].state &&
+					sessions[other].command == sessions[lane].command) {
+					unsigned int l;
+					for (l = 0; l < SPEC_LANES; l++) {
+						if (rep[l] == lane)
+							rep[l] = other;
+					}
+					active--;
+					break;
+				}
+			}
+		}
+	}
+
+	chunk->converged = i;
+	if (active == 1) {
+		/* the same for every start */
+		spec_run_sequential(chunk, &sessions[rep[0]], i);
+	}
+
+	for (lane = 0; lane < SPEC_LANES; lane++)
+		chunk->end[lane] = sessions[rep[lane]];
+	return 0;
+}
+
+
+/* ORs the first count bits of the lane's verdicts into the chunk's verdicts */
+static void spec_pick_lane(struct spec_chunk* chunk, int lane) {
+	const uint64_t* bits = chunk->lane_verdicts + lane * SPLP_VERDICT_WORDS(chunk->count);
+	size_t full = chunk->converged / 64;
+	size_t w;
+
+	for (w = 0; w < full; w++)
+		chunk->verdicts[w] |= bits[w];
+	if (chunk->converged % 64)
+		chunk->verdicts[full] |= bits[full] & (((uint64_t)1 << (chunk->converged % 64)) - 1);
+}
+
+
+ /* FUNCTION:  splp_validate_speculative
+   *
+   * PURPOSE:
+   *    Validates count consecutive messages of one connection with the
+   *    given validator on up to thread_count threads and stores the
+   *    verdicts as a bitmap, exactly as splp_validate_view_batch() does
+   *
+   * PARAMETERS:
+   *    session - state of the connection, updated after the last message
+   *    messages - array of count messages
+   *    verdicts - SPLP_VERDICT_WORDS(count) words receiving the verdicts
+   *    validate - validator of a single message
+   *    thread_count - amount of threads to use, including the calling one
+   */
+void splp_validate_speculative(struct SplpSession* session, const struct MessageView* messages, size_t count,
+	uint64_t* verdicts, splp_view_validator validate, unsigned int thread_count) {
+	struct spec_chunk chunks[SPEC_MAX_CHUNKS];
+	splp_thread_t threads[SPEC_MAX_CHUNKS];
+	size_t chunk_count = count / SPEC_MIN_CHUNK;
+	size_t first = 0;
+	size_t k, started;
+	struct SplpSession current;
+
+	if (chunk_count > thread_count)
+		chunk_count = thread_count;
+	if (chunk_count > SPEC_MAX_CHUNKS)
+		chunk_count = SPEC_MAX_CHUNKS;
+	if (chunk_count == 0)
+		chunk_count = 1;
+
+	/* chunks start at word boundaries, so they don't share verdict words */
+	for (k = 0; k < chunk_count; k++) {
+		size_t end = k + 1 == chunk_count ? count : (count * (k + 1) / chunk_count) & ~(size_t)63;
+
+		memset(&chunks[k], 0, sizeof(chunks[k]));
+		chunks[k].messages = messages + first;
+		chunks[k].count = end - first;
+		chunks[k].verdicts = verdicts + first / 64;
+		chunks[k].validate = validate;
+		chunks[k].speculate = k != 0;
+		first = end;
+	}
+	chunks[0].end[0] = *session;
+
+	/* the calling thread validates the first chunk */
+	for (started = 1; started < chunk_count; started++) {
+		if (!splp_thread_create(&threads[started], spec_run_chunk, &chunks[started]))
+			break;
+	}
+	spec_run_chunk(&chunks[0]);
+	for (k = started; k < chunk_count; k++)
+		spec_run_chunk(&chunks[k]);
+	for (k = 1; k < started; k++)
+		splp_thread_join(threads[k]);
+
+	current = chunks[0].end[0];
+	for (k = 1; k < chunk_count; k++) {
+		int lane = spec_lane(&current);
+
+		if (lane < 0 || chunks[k].failed) {
+			memset(chunks[k].verdicts, 0, SPLP_VERDICT_WORDS(chunks[k].count) * sizeof(uint64_t));
+			spec_run_sequential(&chunks[k], &current, 0);
+		}
+		else {
+			spec_pick_lane(&chunks[k], lane);
+			current = chunks[k].end[lane];
+		}
+		free(chunks[k].lane_verdicts);
+	}
+
+	*session = current;
+}
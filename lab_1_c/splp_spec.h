@@ -0,0 +1,26 @@
+/*
+ * splp_spec.h
+ * The file is part of practical task for System programming course.
+ * This file contains speculative parallel validation of a single long
+ * stream of messages.
+ */
+
+#ifndef SPLP_SPEC_H
+#define SPLP_SPEC_H
+
+#include "splpv1.h"
+
+
+/* single message validator, splp_validate_view() or splp_dfa_validate_view() */
+typedef enum test_status ( *splp_view_validator )( struct SplpSession* pSession, const struct MessageView* pView );
+
+
+/* Same as splp_validate_view_batch(), but the messages are cut into
+ * chunks validated on up to thread_count threads at once. A chunk is
+ * run from every possible session state, then the chunks are stitched
+ * together, so the verdicts are the same as of the sequential run.
+ */
+extern void splp_validate_speculative( struct SplpSession* pSession, const struct MessageView* pViews,
+	size_t count, uint64_t* pVerdicts, splp_view_validator validate, unsigned int thread_count );
+
+#endif /* SPLP_SPEC_H */
@@ -0,0 +1,71 @@
+/*
+ * splp_stats.c
+ * The file is part of practical task for System programming course.
+ * This file contains the optional validator counters.
+ */
+
+#include "splp_stats.h"
+
+#include <stddef.h>
+#include <string.h>
+
+
+#if defined(SPLP_STATS)
+SPLP_THREAD_LOCAL struct SplpStats splp_stats_local;
+#endif
+
+static const char* const keyword_names[SPLP_KEYWORD_COUNT] = {
+	"CONNECT", "CONNECT_OK", "GET_VER", "GET_DATA", "GET_COMMAND", "GET_FILE", "GET_B64",
+	"DISCONNECT", "VERSION", "GET_DATA reply", "GET_COMMAND reply", "GET_FILE reply",
+	"B64:", "DISCONNECT_OK"
+};
+
+static const char* const reject_names[SPLP_REJECT_COUNT] = {
+	"direction", "keyword", "payload", "echo", "table"
+};
+
+
+int splp_stats_enabled(void) {
+#if defined(SPLP_STATS)
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+
+void splp_stats_get(struct SplpStats* stats) {
+#if defined(SPLP_STATS)
+	*stats = splp_stats_local;
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+
+void splp_stats_reset(void) {
+#if defined(SPLP_STATS)
+	memset(&splp_stats_local, 0, sizeof(splp_stats_local));
+#endif
+}
+
+
+void splp_stats_add(struct SplpStats* total, const struct SplpStats* stats) {
+	uint64_t* t = (uint64_t*)total;
+	const uint64_t* s = (const uint64_t*)stats;
+	size_t i;
+
+	/* the structure holds nothing but counters */
+	for (i = 0; i < offsetof(struct SplpStats, class_bytes) / sizeof(uint64_t) + SPLP_STATS_CLASS_COUNT; i++)
+		t[i] += s[i];
+}
+
+
+const char* splp_stats_keyword_name(unsigned int keyword) {
+	return keyword < SPLP_KEYWORD_COUNT ? keyword_names[keyword] : "";
+}
+
+
+const char* splp_stats_reject_name(unsigned int reject) {
+	return reject < SPLP_REJECT_COUNT ? reject_names[reject] : "";
+}
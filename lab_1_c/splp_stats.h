@@ -0,0 +1,80 @@
+/*
+ * splp_stats.h
+ * The file is part of practical task for System programming course.
+ * This file contains the optional validator counters. They are compiled
+ * in only when SPLP_STATS is defined, otherwise the counting macros are
+ * empty and the counters read as zero. Every thread counts into its own
+ * copy, so the validators don't share any cache lines because of them.
+ */
+
+#ifndef SPLP_STATS_H
+#define SPLP_STATS_H
+
+#include <stdint.h>
+#include "splpv1.h"
+#include "splp_compiler.h"
+
+
+/* rejected messages, by the check which failed */
+enum splp_reject {
+	SPLP_REJECT_DIRECTION,      /* nothing is expected in this direction */
+	SPLP_REJECT_KEYWORD,        /* doesn't start with a keyword allowed in the state */
+	SPLP_REJECT_PAYLOAD,        /* payload of a wrong class, length or padding */
+	SPLP_REJECT_ECHO,           /* payload isn't followed by the echo, or something follows it */
+	SPLP_REJECT_TABLE,          /* automaton, the check isn't known */
+	SPLP_REJECT_COUNT
+};
+
+/* payload bytes consumed by splp_class_span(), by SPLP_CLASS_xxx bit */
+#define SPLP_STATS_CLASS_COUNT      3
+#define SPLP_STATS_CLASS_INDEX(cls) ((cls) >> 1)
+
+struct SPLP_CACHE_ALIGNED SplpStats {
+	uint64_t states[8];                         /* messages received in state 1..7 */
+	uint64_t commands[4];                       /* messages received with command 1..3 pending */
+	uint64_t keywords[SPLP_KEYWORD_COUNT];     /* accepted messages, by the keyword they start with */
+	uint64_t rejects[SPLP_REJECT_COUNT];
+	uint64_t class_bytes[SPLP_STATS_CLASS_COUNT];
+};
+
+
+#if defined(SPLP_STATS)
+
+extern SPLP_THREAD_LOCAL struct SplpStats splp_stats_local;
+
+/* counts a message received in state/command, type is SPLP_KEYWORD_COUNT for a rejected one */
+static __inline void splp_stats_message(unsigned int state, unsigned int command, unsigned int type) {
+	splp_stats_local.states[state & 7]++;
+	splp_stats_local.commands[command & 3]++;
+	if (type < SPLP_KEYWORD_COUNT)
+		splp_stats_local.keywords[type]++;
+}
+
+#define SPLP_STATS_ADD(field, value)    (splp_stats_local.field += (value))
+#define SPLP_STATS_MESSAGE(state, command, type) \
+	splp_stats_message((state), (command), (type))
+
+#else
+
+#define SPLP_STATS_ADD(field, value)    ((void)0)
+#define SPLP_STATS_MESSAGE(state, command, type) ((void)0)
+
+#endif /* SPLP_STATS */
+
+
+/* non-zero if the counters are compiled in */
+extern int splp_stats_enabled(void);
+
+/* copies the counters of the calling thread */
+extern void splp_stats_get(struct SplpStats* stats);
+
+/* zeroes the counters of the calling thread */
+extern void splp_stats_reset(void);
+
+/* adds stats to total, e.g. to sum the counters of several threads */
+extern void splp_stats_add(struct SplpStats* total, const struct SplpStats* stats);
+
+extern const char* splp_stats_keyword_name(unsigned int keyword);
+extern const char* splp_stats_reject_name(unsigned int reject);
+
+#endif /* SPLP_STATS_H */
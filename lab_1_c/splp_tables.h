@@ -0,0 +1,86 @@
+/*
+ * splp_tables.h
+ * The file is part of practical task for System programming course.
+ * This file contains the tables of the protocol SPLPv1. It is written by
+ * splpcompile from the grammar in splp_grammar.c, don't edit it.
+ */
+
+#ifndef SPLP_TABLES_H
+#define SPLP_TABLES_H
+
+
+/* index of the tables of a direction, state and command */
+#define SPLP_TABLE_START(direction, state, command) \
+	((((direction) & 1) << 5) | (((state) & 7) << 2) | ((command) & 3))
+#define SPLP_TABLE_START_COUNT      64
+
+/* messages which consist of a keyword only: text, length, start they are
+ * allowed in, new state, new command, type. A message of length n is in slot
+ * (byte SPLP_TABLE_KEYWORD_BYTE + (n << SPLP_TABLE_KEYWORD_SHIFT)) & (SPLP_TABLE_KEYWORD_SLOTS - 1),
+ * empty slots have length 0
+ */
+#define SPLP_TABLE_KEYWORD_BYTE     4
+#define SPLP_TABLE_KEYWORD_SHIFT    2
+#define SPLP_TABLE_KEYWORD_SLOTS    16
+#define SPLP_TABLE_KEYWORDS \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "CONNECT", 7, 4, 2, 0, 0 }, \
+	{ "GET_VER", 7, 12, 4, 0, 2 }, \
+	{ "DISCONNECT_OK", 13, 60, 1, 0, 13 }, \
+	{ "GET_DATA", 8, 12, 5, 1, 3 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "GET_FILE", 8, 12, 5, 3, 5 }, \
+	{ "DISCONNECT", 10, 12, 7, 0, 7 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "", 0, 0, 0, 0, 14 }, \
+	{ "CONNECT_OK", 10, 40, 3, 0, 1 }, \
+	{ "GET_B64", 7, 12, 6, 0, 6 }, \
+	{ "GET_COMMAND", 11, 12, 5, 2, 4 }
+
+/* starts which allow keyword-only messages, a bit per SPLP_TABLE_START() */
+#define SPLP_TABLE_KEYWORD_STARTS   UINT64_C(0x1000010000001010)
+
+/* the other messages: keyword, its length, payload class, least payload, block,
+ * padding, most padding, echo, its length, open end, new state, new command, type,
+ * payload is decoded by splp_base64_decode(), next rule of the start (0 if none).
+ * Keywords and echoes are shorter than SPLP_TABLE_TEXT_MAX.
+ */
+#define SPLP_TABLE_TEXT_MAX         16
+#define SPLP_TABLE_RULES \
+	{ "VERSION ", 8, 0x04, 1, 1, 0, 0, "", 0, 0, 3, 0, 8, 0, 0 }, \
+	{ "GET_DATA ", 9, 0x01, 0, 1, 0, 0, " GET_DATA", 9, 1, 3, 0, 9, 0, 0 }, \
+	{ "GET_COMMAND ", 12, 0x01, 0, 1, 0, 0, " GET_COMMAND", 12, 1, 3, 0, 10, 0, 0 }, \
+	{ "GET_FILE ", 9, 0x01, 0, 1, 0, 0, " GET_FILE", 9, 1, 3, 0, 11, 0, 0 }, \
+	{ "B64: ", 5, 0x02, 0, 4, 61, 2, "", 0, 0, 3, 0, 12, 1, 0 }, \
+	{ "", 0, 0, 0, 1, 0, 0, "", 0, 0, 0, 0, 14, 0, 0 }
+
+/* starts which allow the other messages: rule(SPLP_TABLE_START(), its first row
+ * in SPLP_TABLE_RULES); meant for the cases of a switch the compiler specializes
+ */
+#define SPLP_TABLE_RULE_STARTS(rule) \
+	rule(48, 0) \
+	rule(53, 1) \
+	rule(54, 2) \
+	rule(55, 3) \
+	rule(56, 4)
+
+/* sessions possible between messages: state, command */
+#define SPLP_TABLE_LANES \
+	{ 1, 0 }, \
+	{ 2, 0 }, \
+	{ 3, 0 }, \
+	{ 4, 0 }, \
+	{ 5, 1 }, \
+	{ 5, 2 }, \
+	{ 5, 3 }, \
+	{ 6, 0 }, \
+	{ 7, 0 }
+#define SPLP_TABLE_LANE_COUNT       9
+
+/* 1 if an invalid message returns the session to INIT, 0 if it stays */
+#define SPLP_TABLE_RESET_ON_INVALID 1
+
+#endif /* SPLP_TABLES_H */
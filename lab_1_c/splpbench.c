@@ -0,0 +1,877 @@
+/*
+ * splpbench.c
+ * The file is part of practical task for System programming course.
+ * This file contains the benchmark suite of the validator. Micro
+ * benchmarks validate a single message of one kind over and over, each
+ * time from the session state the message is expected in, so a class of
+ * messages which got slower shows up even if the total didn't change.
+ * Macro benchmarks validate whole test files. Every benchmark is timed
+ * in a number of samples; the results can be saved as JSON and compared
+ * with a saved baseline, where a difference counts only if the
+ * Mann-Whitney U test finds the two sets of samples differ.
+ *
+ * Build separately from the test program:
+ *     cl /O2 splpbench.c splpv1.c splp_dfa.c splp_grammar.c splp_charclass.c splp_stats.c splp_corpus.c
+ *     gcc -O2 -o splpbench splpbench.c splpv1.c splp_dfa.c splp_grammar.c splp_charclass.c splp_stats.c splp_corpus.c -lm
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "splpv1.h"
+#include "splp_dfa.h"
+#include "splp_platform.h"
+#include "splptest.h"
+#include "splp_corpus.h"
+
+
+
+
+#define DEFAULT_SAMPLE_COUNT      20
+#define DEFAULT_SAMPLE_MSEC       5
+#define DEFAULT_THRESHOLD         0.02      /* smallest difference worth reporting */
+#define SPLP_BENCH_ALPHA          0.01      /* significance level of the comparison */
+#define SPLP_BENCH_MAX            64
+#define SPLP_BENCH_MAX_CORPORA    16
+#define SPLP_BENCH_MAX_SAMPLES    1000
+#define SPLP_BENCH_NAME_LENGTH    64
+
+
+
+
+/* SPLP_BENCH
+* A benchmark and its samples. A sample is the time of one message, in
+* nanoseconds.
+*/
+typedef struct _SPLP_BENCH
+{
+    char                name[ SPLP_BENCH_NAME_LENGTH ];
+    int                 macro;          /* validates a whole file */
+
+    struct SplpSession  start;          /* micro: session the message is validated from */
+    struct MessageView  message;        /* micro: the message, text owned by the benchmark */
+
+    struct MessageView* views;          /* macro: messages of a text file, NULL for a binary corpus */
+    struct MessageBlock block;          /* macro: messages of a binary corpus */
+    uint64_t*           verdicts;       /* macro: answers of a pass */
+    void*               mapping;        /* macro: the file */
+    size_t              mappingSize;
+
+    uint64_t            messageCount;   /* messages of one run */
+    uint64_t            byteCount;      /* bytes of these messages */
+    double              samples[ SPLP_BENCH_MAX_SAMPLES ];
+    unsigned int        sampleCount;
+
+} SPLP_BENCH, *PSPLP_BENCH;
+
+
+
+
+/* SPLP_BENCH_OPTIONS
+* What to run and where to put the results
+*/
+typedef struct _SPLP_BENCH_OPTIONS
+{
+    const char*     jsonFileName;       /* save the results here */
+    const char*     baselineFileName;   /* compare the results with these */
+    const char*     filter;             /* run only benchmarks with this in the name */
+    unsigned int    sampleCount;
+    unsigned int    sampleMsec;         /* about how long a sample takes */
+    double          threshold;          /* smallest relative difference to report */
+    int             dfa;                /* benchmark the automaton */
+    const char*     corpora[ SPLP_BENCH_MAX_CORPORA ];
+    unsigned int    corpusCount;
+
+}SPLP_BENCH_OPTIONS, *PSPLP_BENCH_OPTIONS;
+
+
+
+
+/* SPLP_BENCH_SUITE
+* All the benchmarks of a run
+*/
+typedef struct _SPLP_BENCH_SUITE
+{
+    PSPLP_BENCH_OPTIONS pOptions;
+    SPLP_BENCH          benches[ SPLP_BENCH_MAX ];
+    unsigned int        benchCount;
+
+}SPLP_BENCH_SUITE, *PSPLP_BENCH_SUITE;
+
+
+
+
+/* results are summed here, so the compiler can't drop the validation */
+static volatile uint64_t SplpBenchSink;
+
+
+
+
+/* SplpBenchAdd
+* Adds a benchmark unless the filter leaves it out. Returns NULL if it
+* isn't added.
+*/
+static PSPLP_BENCH SplpBenchAdd(
+    PSPLP_BENCH_SUITE pSuite,
+    const char* name )
+{
+    PSPLP_BENCH pBench;
+
+    if ( pSuite->pOptions->filter && !strstr( name, pSuite->pOptions->filter ) )
+        return NULL;
+    if ( pSuite->benchCount == SPLP_BENCH_MAX )
+        return NULL;
+
+    pBench = &pSuite->benches[ pSuite->benchCount++ ];
+    memset( pBench, 0, sizeof( *pBench ) );
+    strncpy( pBench->name, name, SPLP_BENCH_NAME_LENGTH - 1 );
+    return pBench;
+}
+
+
+
+
+/* SplpBenchAddMicro
+* Adds a benchmark of the message "prefix payload suffix", where the
+* payload is payloadLength characters of the alphabet, validated in the
+* given state. The last character of the message is replaced with
+* 'last' if it isn't 0.
+*/
+static void SplpBenchAddMicro(
+    PSPLP_BENCH_SUITE pSuite,
+    const char* name,
+    unsigned char state,
+    unsigned char command,
+    enum Direction direction,
+    const char* prefix,
+    const char* alphabet,
+    size_t payloadLength,
+    const char* suffix,
+    char last )
+{
+    PSPLP_BENCH pBench = SplpBenchAdd( pSuite, name );
+    size_t prefixLength = strlen( prefix );
+    size_t suffixLength = strlen( suffix );
+    size_t alphabetSize = alphabet ? strlen( alphabet ) : 0;
+    char* text;
+    size_t i;
+
+    if ( !pBench )
+        return;
+
+    text = (char*) malloc( prefixLength + payloadLength + suffixLength + 1 );
+    if ( !text )
+    {
+        pSuite->benchCount--;
+        return;
+    }
+
+    memcpy( text, prefix, prefixLength );
+    for ( i = 0; i < payloadLength; i++ )
+        text[ prefixLength + i ] = alphabet[ ( i * 7 ) % alphabetSize ];
+    memcpy( text + prefixLength + payloadLength, suffix, suffixLength );
+    pBench->message.length = prefixLength + payloadLength + suffixLength;
+    if ( last )
+        text[ pBench->message.length - 1 ] = last;
+    text[ pBench->message.length ] = 0;
+
+    splp_session_init( &pBench->start );
+    pBench->start.state = state;
+    pBench->start.command = command;
+    pBench->message.direction = direction;
+    pBench->message.text = text;
+    pBench->messageCount = 1;
+    pBench->byteCount = pBench->message.length;
+}
+
+
+
+
+/* SplpBenchAddMicros
+* Adds the micro benchmarks: a message of every kind, payloads of
+* several sizes and messages rejected at their first or last byte
+*/
+static void SplpBenchAddMicros(
+    PSPLP_BENCH_SUITE pSuite )
+{
+    static const char data[ ] = "abcdefghijklmnopqrstuvwxyz0123456789.";
+    static const char base64[ ] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const size_t sizes[ ] = { 16, 256, 4096 };
+    char name[ SPLP_BENCH_NAME_LENGTH ];
+    unsigned int i;
+
+    SplpBenchAddMicro( pSuite, "micro/connect", 1, 0, A_TO_B, "CONNECT", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/connect_ok", 2, 0, B_TO_A, "CONNECT_OK", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/get_ver", 3, 0, A_TO_B, "GET_VER", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/version", 4, 0, B_TO_A, "VERSION 12345", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/get_data", 3, 0, A_TO_B, "GET_DATA", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/get_b64", 3, 0, A_TO_B, "GET_B64", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/disconnect", 3, 0, A_TO_B, "DISCONNECT", NULL, 0, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/disconnect_ok", 7, 0, B_TO_A, "DISCONNECT_OK", NULL, 0, "", 0 );
+
+    for ( i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+    {
+        sprintf( name, "micro/get_data_reply/%u", (unsigned int) sizes[ i ] );
+        SplpBenchAddMicro( pSuite, name, 5, 1, B_TO_A, "GET_DATA ", data, sizes[ i ], " GET_DATA", 0 );
+        sprintf( name, "micro/get_command_reply/%u", (unsigned int) sizes[ i ] );
+        SplpBenchAddMicro( pSuite, name, 5, 2, B_TO_A, "GET_COMMAND ", data, sizes[ i ], " GET_COMMAND", 0 );
+        sprintf( name, "micro/get_file_reply/%u", (unsigned int) sizes[ i ] );
+        SplpBenchAddMicro( pSuite, name, 5, 3, B_TO_A, "GET_FILE ", data, sizes[ i ], " GET_FILE", 0 );
+        sprintf( name, "micro/b64/%u", (unsigned int) sizes[ i ] );
+        SplpBenchAddMicro( pSuite, name, 6, 0, B_TO_A, "B64: ", base64, sizes[ i ], "", 0 );
+    }
+
+    // the same long messages, wrong at the first or at the last byte
+    SplpBenchAddMicro( pSuite, "micro/reject_early/get_data_reply", 5, 1, B_TO_A, "get_DATA ", data, 4096, " GET_DATA", 0 );
+    SplpBenchAddMicro( pSuite, "micro/reject_late/get_data_reply", 5, 1, B_TO_A, "GET_DATA ", data, 4096, " GET_DATA", '!' );
+    SplpBenchAddMicro( pSuite, "micro/reject_early/b64", 6, 0, B_TO_A, "b64: ", base64, 4096, "", 0 );
+    SplpBenchAddMicro( pSuite, "micro/reject_late/b64", 6, 0, B_TO_A, "B64: ", base64, 4096, "", '!' );
+    SplpBenchAddMicro( pSuite, "micro/reject_early/state", 3, 0, B_TO_A, "CONNECT_OK", NULL, 0, "", 0 );
+}
+
+
+
+
+/* SplpBenchParseText
+* Collects the messages of a text test file, which are lines
+* "expected direction message" after the line with their amount
+*/
+static SPLP_STATUS SplpBenchParseText(
+    PSPLP_BENCH pBench )
+{
+    const char* pos = (const char*) pBench->mapping;
+    const char* fileEnd = pos + pBench->mappingSize;
+    uint64_t capacity = strtoull( pos, NULL, 10 );
+    uint64_t count = 0;
+
+    if ( !capacity || capacity > SIZE_MAX / sizeof( struct MessageView ) )
+        return SPLP_STATUS_ERROR;
+    pBench->views = (struct MessageView*) malloc( (size_t) capacity * sizeof( struct MessageView ) );
+    if ( !pBench->views )
+        return SPLP_STATUS_ERROR;
+
+    pos = memchr( pos, '\n', fileEnd - pos );
+    while ( pos && ++pos < fileEnd && count < capacity )
+    {
+        const char* lineEnd = memchr( pos, '\n', fileEnd - pos );
+        const char* field = pos;
+        const char* text;
+        int direction = 0;
+        unsigned int i;
+
+        if ( !lineEnd )
+            lineEnd = fileEnd;
+
+        // expected and direction, then the message up to the first '\r'
+        for ( i = 0; i < 2; i++ )
+        {
+            while ( field < lineEnd && ( *field == ' ' || *field == '\t' ) )
+                field++;
+            if ( i == 1 )
+                direction = field < lineEnd && *field == '1';
+            while ( field < lineEnd && *field != ' ' && *field != '\t' )
+                field++;
+        }
+        while ( field < lineEnd && ( *field == ' ' || *field == '\t' ) )
+            field++;
+
+        if ( field != lineEnd || lineEnd - pos > 1 )
+        {
+            text = memchr( field, '\r', lineEnd - field );
+            pBench->views[ count ].direction = direction ? B_TO_A : A_TO_B;
+            pBench->views[ count ].text = field;
+            pBench->views[ count ].length = ( text ? text : lineEnd ) - field;
+            pBench->byteCount += pBench->views[ count ].length;
+            count++;
+        }
+        pos = lineEnd;
+    }
+
+    pBench->messageCount = count;
+    return count ? SPLP_STATUS_OK : SPLP_STATUS_ERROR;
+}
+
+
+
+
+/* SplpBenchAddMacro
+* Adds the benchmark of a whole test file or binary corpus
+*/
+static SPLP_STATUS SplpBenchAddMacro(
+    PSPLP_BENCH_SUITE pSuite,
+    const char* fileName )
+{
+    char name[ SPLP_BENCH_NAME_LENGTH ];
+    const char* baseName = fileName + strlen( fileName );
+    PSPLP_BENCH pBench;
+    SPLP_CORPUS corpus;
+    SPLP_STATUS status;
+
+    // named after the file, without the directory
+    while ( baseName != fileName && baseName[ -1 ] != '/' && baseName[ -1 ] != '\\' )
+        baseName--;
+    sprintf( name, "macro/%.*s", SPLP_BENCH_NAME_LENGTH - 7, baseName );
+
+    pBench = SplpBenchAdd( pSuite, name );
+    if ( !pBench )
+        return SPLP_STATUS_OK;
+
+    pBench->macro = 1;
+    pBench->mapping = splp_map_file( fileName, &pBench->mappingSize );
+    if ( !pBench->mapping )
+    {
+        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+        pSuite->benchCount--;
+        return SPLP_STATUS_ERROR;
+    }
+
+    if ( SplpCorpusIsBinary( pBench->mapping, pBench->mappingSize ) )
+    {
+        status = SplpCorpusAttach( &corpus, pBench->mapping, pBench->mappingSize );
+        pBench->block = corpus.block;
+        pBench->messageCount = status == SPLP_STATUS_OK ? corpus.header->messageCount : 0;
+        pBench->byteCount = status == SPLP_STATUS_OK ? corpus.header->textSize : 0;
+    }
+    else
+    {
+        status = SplpBenchParseText( pBench );
+    }
+
+    if ( status == SPLP_STATUS_OK )
+        pBench->verdicts = (uint64_t*) malloc( (size_t) SPLP_VERDICT_WORDS( pBench->messageCount ) * sizeof( uint64_t ) );
+    if ( status != SPLP_STATUS_OK || !pBench->verdicts )
+    {
+        printf( "***ERROR*** File \"%s\" can't be loaded\n", fileName );
+        free( pBench->views );
+        splp_unmap_file( pBench->mapping, pBench->mappingSize );
+        pSuite->benchCount--;
+        return SPLP_STATUS_ERROR;
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpBenchRun
+* Runs the benchmark the given amount of times, returns the time taken
+*/
+static uint64_t SplpBenchRun(
+    PSPLP_BENCH pBench,
+    int dfa,
+    uint64_t iterations )
+{
+    enum test_status ( *validateView )( struct SplpSession*, const struct MessageView* ) =
+        dfa ? splp_dfa_validate_view : splp_validate_view;
+    uint64_t sum = 0;
+    uint64_t start = splp_clock_ns( );
+    uint64_t i;
+
+    for ( i = 0; i < iterations; i++ )
+    {
+        struct SplpSession session = pBench->start;
+
+        if ( !pBench->macro )
+        {
+            sum += validateView( &session, &pBench->message );
+            continue;
+        }
+
+        splp_session_init( &session );
+        if ( pBench->views )
+            ( dfa ? splp_dfa_validate_view_batch : splp_validate_view_batch )(
+                &session, pBench->views, (size_t) pBench->messageCount, pBench->verdicts );
+        else
+            ( dfa ? splp_dfa_validate_block : splp_validate_block )( &session, &pBench->block, pBench->verdicts );
+        sum += pBench->verdicts[ 0 ];
+    }
+
+    SplpBenchSink += sum;
+    return splp_clock_ns( ) - start;
+}
+
+
+
+
+/* SplpBenchMeasure
+* Finds how many runs take about a sample time, then takes the samples
+*/
+static void SplpBenchMeasure(
+    PSPLP_BENCH_OPTIONS pOptions,
+    PSPLP_BENCH pBench )
+{
+    uint64_t sampleTime = (uint64_t) pOptions->sampleMsec * 1000000;
+    uint64_t iterations = 1;
+    unsigned int i;
+
+    while ( SplpBenchRun( pBench, pOptions->dfa, iterations ) < sampleTime / 2 && iterations < ( (uint64_t) 1 << 40 ) )
+        iterations *= 2;
+
+    for ( i = 0; i < pOptions->sampleCount; i++ )
+    {
+        uint64_t duration = SplpBenchRun( pBench, pOptions->dfa, iterations );
+        pBench->samples[ i ] = (double) duration / (double) iterations / (double) pBench->messageCount;
+    }
+    pBench->sampleCount = pOptions->sampleCount;
+}
+
+
+
+
+static int SplpCompareDoubles(
+    const void* a,
+    const void* b )
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+
+
+/* SplpBenchMedian
+* Returns the median of the samples
+*/
+static double SplpBenchMedian(
+    const double* samples,
+    unsigned int count )
+{
+    double sorted[ SPLP_BENCH_MAX_SAMPLES ];
+
+    if ( !count )
+        return 0;
+    memcpy( sorted, samples, count * sizeof( double ) );
+    qsort( sorted, count, sizeof( double ), SplpCompareDoubles );
+    return count % 2 ? sorted[ count / 2 ] : ( sorted[ count / 2 - 1 ] + sorted[ count / 2 ] ) / 2;
+}
+
+
+
+
+/* SplpBenchDeviation
+* Returns the standard deviation of the samples
+*/
+static double SplpBenchDeviation(
+    const double* samples,
+    unsigned int count )
+{
+    double mean = 0, sum = 0;
+    unsigned int i;
+
+    if ( count < 2 )
+        return 0;
+    for ( i = 0; i < count; i++ )
+        mean += samples[ i ];
+    mean /= count;
+    for ( i = 0; i < count; i++ )
+        sum += ( samples[ i ] - mean ) * ( samples[ i ] - mean );
+    return sqrt( sum / ( count - 1 ) );
+}
+
+
+
+
+/* SplpBenchMannWhitney
+* Returns the two-sided p-value of the Mann-Whitney U test of the two
+* sets of samples, by the normal approximation with the tie correction
+*/
+static double SplpBenchMannWhitney(
+    const double* a,
+    unsigned int countA,
+    const double* b,
+    unsigned int countB )
+{
+    double n = (double) countA + countB;
+    double rankSumA = 0, ties = 0, u, mean, variance;
+    unsigned int i, j;
+
+    if ( !countA || !countB )
+        return 1;
+
+    // rank of a value: 1 + values below it + half of the others equal to it
+    for ( i = 0; i < countA; i++ )
+    {
+        double below = 0, equal = 0;
+
+        for ( j = 0; j < countA; j++ )
+        {
+            below += a[ j ] < a[ i ];
+            equal += a[ j ] == a[ i ];
+        }
+        for ( j = 0; j < countB; j++ )
+        {
+            below += b[ j ] < a[ i ];
+            equal += b[ j ] == a[ i ];
+        }
+        rankSumA += below + ( equal + 1 ) / 2;
+    }
+
+    // sum of t^3 - t over groups of t equal values, counted once per value
+    for ( i = 0; i < countA + countB; i++ )
+    {
+        double value = i < countA ? a[ i ] : b[ i - countA ];
+        double t = 0;
+
+        for ( j = 0; j < countA; j++ )
+            t += a[ j ] == value;
+        for ( j = 0; j < countB; j++ )
+            t += b[ j ] == value;
+        ties += t * t - 1;  // ( t^3 - t ) / t
+    }
+
+    u = rankSumA - (double) countA * ( countA + 1 ) / 2;
+    mean = (double) countA * countB / 2;
+    variance = (double) countA * countB / 12 * ( ( n + 1 ) - ties / ( n * ( n - 1 ) ) );
+    if ( variance <= 0 )
+        return u == mean ? 1 : 0;
+
+    return erfc( fabs( u - mean ) / sqrt( variance ) / sqrt( 2.0 ) );
+}
+
+
+
+
+/* SplpBenchLoadBaseline
+* Reads the samples of every benchmark of a JSON file written by
+* SplpBenchSaveJson( ) into pBaseline, by name
+*/
+static SPLP_STATUS SplpBenchLoadBaseline(
+    const char* fileName,
+    PSPLP_BENCH_SUITE pBaseline )
+{
+    size_t size = 0;
+    void* mapping = splp_map_file( fileName, &size );
+    char* json;
+    const char* pos;
+
+    if ( !mapping )
+    {
+        printf( "***ERROR*** File \"%s\" can't be opened\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    // a NUL-terminated copy for strstr( ) and strtod( )
+    json = (char*) malloc( size + 1 );
+    if ( !json )
+    {
+        splp_unmap_file( mapping, size );
+        return SPLP_STATUS_ERROR;
+    }
+    memcpy( json, mapping, size );
+    json[ size ] = 0;
+    splp_unmap_file( mapping, size );
+
+    pBaseline->benchCount = 0;
+    pos = json;
+    while ( pBaseline->benchCount < SPLP_BENCH_MAX && NULL != ( pos = strstr( pos, "\"name\"" ) ) )
+    {
+        PSPLP_BENCH pBench = &pBaseline->benches[ pBaseline->benchCount ];
+        const char* name = strchr( pos + 6, '"' );
+        const char* nameEnd = name ? strchr( name + 1, '"' ) : NULL;
+        const char* samples = nameEnd ? strstr( nameEnd, "\"samples\"" ) : NULL;
+        const char* next = nameEnd ? strstr( nameEnd, "\"name\"" ) : NULL;
+        char* end;
+
+        if ( !samples || ( next && next < samples ) || !( samples = strchr( samples, '[' ) ) )
+            break;
+
+        memset( pBench, 0, sizeof( *pBench ) );
+        sprintf( pBench->name, "%.*s", (int) ( nameEnd - name - 1 < SPLP_BENCH_NAME_LENGTH - 1 ?
+            nameEnd - name - 1 : SPLP_BENCH_NAME_LENGTH - 1 ), name + 1 );
+
+        pos = samples + 1;
+        while ( pBench->sampleCount < SPLP_BENCH_MAX_SAMPLES )
+        {
+            double value = strtod( pos, &end );
+            if ( end == pos )
+                break;
+            pBench->samples[ pBench->sampleCount++ ] = value;
+            pos = end;
+            while ( *pos == ' ' || *pos == ',' || *pos == '\n' || *pos == '\r' || *pos == '\t' )
+                pos++;
+        }
+        pBaseline->benchCount++;
+    }
+
+    free( json );
+    if ( !pBaseline->benchCount )
+    {
+        printf( "***ERROR*** File \"%s\" has no benchmark results\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpBenchSaveJson
+* Writes the results with all their samples
+*/
+static SPLP_STATUS SplpBenchSaveJson(
+    PSPLP_BENCH_SUITE pSuite,
+    const char* fileName )
+{
+    FILE* file = fopen( fileName, "w" );
+    unsigned int b, i;
+
+    if ( !file )
+    {
+        printf( "***ERROR*** File \"%s\" can't be created\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    fprintf( file, "{\n  \"engine\": \"%s\",\n  \"unit\": \"ns/message\",\n  \"benchmarks\": [\n",
+        pSuite->pOptions->dfa ? "dfa" : "switch" );
+    for ( b = 0; b < pSuite->benchCount; b++ )
+    {
+        PSPLP_BENCH pBench = &pSuite->benches[ b ];
+
+        fprintf( file,
+            "    {\n"
+            "      \"name\": \"%s\",\n"
+            "      \"messages\": %llu,\n"
+            "      \"bytes\": %llu,\n"
+            "      \"median\": %.4f,\n"
+            "      \"stddev\": %.4f,\n"
+            "      \"samples\": [",
+            pBench->name,
+            (unsigned long long) pBench->messageCount,
+            (unsigned long long) pBench->byteCount,
+            SplpBenchMedian( pBench->samples, pBench->sampleCount ),
+            SplpBenchDeviation( pBench->samples, pBench->sampleCount ) );
+        for ( i = 0; i < pBench->sampleCount; i++ )
+            fprintf( file, "%s%.4f", i ? ", " : "", pBench->samples[ i ] );
+        fprintf( file, "]\n    }%s\n", b + 1 < pSuite->benchCount ? "," : "" );
+    }
+    fprintf( file, "  ]\n}\n" );
+
+    if ( ferror( file ) | fclose( file ) )
+    {
+        printf( "***ERROR*** File \"%s\" can't be written\n", fileName );
+        return SPLP_STATUS_ERROR;
+    }
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpBenchPrint
+* Prints the results, compared with the baseline if there is one.
+* Returns the amount of significant regressions.
+*/
+static unsigned int SplpBenchPrint(
+    PSPLP_BENCH_SUITE pSuite,
+    PSPLP_BENCH_SUITE pBaseline )
+{
+    unsigned int regressions = 0;
+    unsigned int b, k;
+
+    printf( "%-36s %12s %10s %8s", "Benchmark", "ns/message", "MB/s", "+-%" );
+    if ( pBaseline )
+        printf( " %12s %9s %8s", "baseline", "change", "p" );
+    printf( "\n" );
+
+    for ( b = 0; b < pSuite->benchCount; b++ )
+    {
+        PSPLP_BENCH pBench = &pSuite->benches[ b ];
+        double median = SplpBenchMedian( pBench->samples, pBench->sampleCount );
+        double bytesPerMessage = (double) pBench->byteCount / (double) pBench->messageCount;
+
+        printf( "%-36s %12.2f %10.1f %8.1f", pBench->name, median,
+            median > 0 ? bytesPerMessage / median * 1e9 / 1024.0 / 1024.0 : 0,
+            median > 0 ? SplpBenchDeviation( pBench->samples, pBench->sampleCount ) / median * 100.0 : 0 );
+
+        for ( k = 0; pBaseline && k < pBaseline->benchCount; k++ )
+        {
+            PSPLP_BENCH pOld = &pBaseline->benches[ k ];
+            double oldMedian, change, p;
+
+            if ( strcmp( pOld->name, pBench->name ) )
+                continue;
+
+            oldMedian = SplpBenchMedian( pOld->samples, pOld->sampleCount );
+            change = oldMedian > 0 ? median / oldMedian - 1.0 : 0;
+            p = SplpBenchMannWhitney( pOld->samples, pOld->sampleCount, pBench->samples, pBench->sampleCount );
+            printf( " %12.2f %+8.1f%% %8.4f", oldMedian, change * 100.0, p );
+
+            // a difference counts if it is both large and significant
+            if ( p < SPLP_BENCH_ALPHA && change > pSuite->pOptions->threshold )
+            {
+                printf( "  REGRESSION" );
+                regressions++;
+            }
+            else if ( p < SPLP_BENCH_ALPHA && change < -pSuite->pOptions->threshold )
+            {
+                printf( "  faster" );
+            }
+            break;
+        }
+        printf( "\n" );
+    }
+
+    if ( pBaseline )
+        printf( "\n%u significant regression(s) against \"%s\"\n", regressions, pSuite->pOptions->baselineFileName );
+    return regressions;
+}
+
+
+
+
+void SplpBenchPrintUsage( )
+{
+    printf( "usage:\n"
+        "\tsplpbench [options] [file ...]  - run the micro benchmarks and a macro\n"
+        "\t                                  benchmark over every test file.\n"
+        "\toptions:\n"
+        "\t  --json=output        - save the results as JSON.\n"
+        "\t  --compare=baseline   - compare with the results saved by --json,\n"
+        "\t                         the exit code is 2 if anything got slower.\n"
+        "\t  --threshold=percent  - smallest change to report (2).\n"
+        "\t  --filter=text        - run the benchmarks with text in the name.\n"
+        "\t  --samples=n          - samples of every benchmark (20).\n"
+        "\t  --sample-ms=n        - about how long a sample takes (5).\n"
+        "\t  --engine=switch|dfa  - validator to benchmark (switch).\n"
+        "\tfile may be a text test file or a binary corpus.\n" );
+}
+
+
+
+
+SPLP_STATUS SplpBenchOptionsInitializeFromCmdLine(
+    PSPLP_BENCH_OPTIONS pOptions,
+    int argc,
+    char* argv[ ] )
+{
+    SPLP_STATUS Status = SPLP_STATUS_OK;
+    int argIdx;
+
+    pOptions->sampleCount = DEFAULT_SAMPLE_COUNT;
+    pOptions->sampleMsec = DEFAULT_SAMPLE_MSEC;
+    pOptions->threshold = DEFAULT_THRESHOLD;
+
+    for ( argIdx = 1; argIdx < argc && Status == SPLP_STATUS_OK; argIdx++ )
+    {
+        const char* arg = argv[ argIdx ];
+        char* end;
+
+        if ( 0 == strncmp( arg, "--json=", 7 ) && arg[ 7 ] )
+            pOptions->jsonFileName = arg + 7;
+        else if ( 0 == strncmp( arg, "--compare=", 10 ) && arg[ 10 ] )
+            pOptions->baselineFileName = arg + 10;
+        else if ( 0 == strncmp( arg, "--filter=", 9 ) )
+            pOptions->filter = arg + 9;
+        else if ( 0 == strncmp( arg, "--threshold=", 12 ) )
+        {
+            pOptions->threshold = strtod( arg + 12, &end ) / 100.0;
+            if ( end == arg + 12 || *end || pOptions->threshold < 0 )
+                Status = SPLP_STATUS_ERROR;
+        }
+        else if ( 0 == strncmp( arg, "--samples=", 10 ) )
+        {
+            unsigned long count = strtoul( arg + 10, &end, 10 );
+            if ( end == arg + 10 || *end || count < 2 || count > SPLP_BENCH_MAX_SAMPLES )
+                Status = SPLP_STATUS_ERROR;
+            pOptions->sampleCount = (unsigned int) count;
+        }
+        else if ( 0 == strncmp( arg, "--sample-ms=", 12 ) )
+        {
+            unsigned long msec = strtoul( arg + 12, &end, 10 );
+            if ( end == arg + 12 || *end || msec < 1 || msec > 60000 )
+                Status = SPLP_STATUS_ERROR;
+            pOptions->sampleMsec = (unsigned int) msec;
+        }
+        else if ( 0 == strcmp( arg, "--engine=switch" ) )
+            pOptions->dfa = 0;
+        else if ( 0 == strcmp( arg, "--engine=dfa" ) )
+            pOptions->dfa = 1;
+        else if ( 0 != strncmp( arg, "--", 2 ) && pOptions->corpusCount < SPLP_BENCH_MAX_CORPORA )
+            pOptions->corpora[ pOptions->corpusCount++ ] = arg;
+        else
+            Status = SPLP_STATUS_ERROR;
+    }
+
+    if ( Status != SPLP_STATUS_OK )
+    {
+        SplpBenchPrintUsage( );
+    }
+
+    return Status;
+}
+
+
+
+
+int main( int argc, char* argv[ ] )
+{
+    static SPLP_BENCH_SUITE Suite, Baseline;
+    SPLP_BENCH_OPTIONS BenchOptions = { 0 };
+    unsigned int regressions = 0;
+    int status = 0;
+    unsigned int i;
+
+    if ( SPLP_STATUS_OK != SplpBenchOptionsInitializeFromCmdLine( &BenchOptions, argc, argv ) )
+        return 1;
+
+    if ( BenchOptions.dfa && !splp_dfa_init( ) )
+    {
+        printf( "***ERROR*** Protocol tables can't be compiled\n" );
+        return 1;
+    }
+    if ( BenchOptions.baselineFileName &&
+        SPLP_STATUS_OK != SplpBenchLoadBaseline( BenchOptions.baselineFileName, &Baseline ) )
+    {
+        return 1;
+    }
+
+    Suite.pOptions = &BenchOptions;
+    Baseline.pOptions = &BenchOptions;
+    SplpBenchAddMicros( &Suite );
+    for ( i = 0; i < BenchOptions.corpusCount; i++ )
+    {
+        if ( SPLP_STATUS_OK != SplpBenchAddMacro( &Suite, BenchOptions.corpora[ i ] ) )
+            status = 1;
+    }
+
+    // a micro benchmark which doesn't get the verdict it was made for measures the wrong path
+    for ( i = 0; i < Suite.benchCount; i++ )
+    {
+        PSPLP_BENCH pBench = &Suite.benches[ i ];
+        struct SplpSession session = pBench->start;
+        enum test_status expected = strstr( pBench->name, "/reject_" ) ? MESSAGE_INVALID : MESSAGE_VALID;
+
+        if ( !pBench->macro &&
+            ( BenchOptions.dfa ? splp_dfa_validate_view : splp_validate_view )( &session, &pBench->message ) != expected )
+        {
+            printf( "***ERROR*** Benchmark %s doesn't get the expected verdict\n", pBench->name );
+            status = 1;
+        }
+    }
+
+    for ( i = 0; i < Suite.benchCount; i++ )
+        SplpBenchMeasure( &BenchOptions, &Suite.benches[ i ] );
+
+    regressions = SplpBenchPrint( &Suite, BenchOptions.baselineFileName ? &Baseline : NULL );
+
+    if ( BenchOptions.jsonFileName && SPLP_STATUS_OK != SplpBenchSaveJson( &Suite, BenchOptions.jsonFileName ) )
+        status = 1;
+
+    for ( i = 0; i < Suite.benchCount; i++ )
+    {
+        PSPLP_BENCH pBench = &Suite.benches[ i ];
+
+        free( (char*) pBench->message.text );
+        free( pBench->views );
+        free( pBench->verdicts );
+        if ( pBench->mapping )
+            splp_unmap_file( pBench->mapping, pBench->mappingSize );
+    }
+
+    return status ? status : regressions ? 2 : 0;
+}
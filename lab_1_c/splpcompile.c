@@ -0,0 +1,509 @@
+/*
+ * splpcompile.c
+ * The file is part of practical task for System programming course.
+ * This file contains the compiler of the protocol grammar
+ * (splp_grammar.h) into splp_tables.h, the tables splp_validate_view()
+ * and the speculative lanes run on. A change of the protocol is a change
+ * of the rules in splp_grammar.c, after which splp_tables.h is written
+ * again by this program; the validator code stays as it is. With
+ * --check the file isn't written, only compared with what would be
+ * written, so a grammar changed without the tables is noticed.
+ *
+ * The grammar is first compiled with splp_dfa_compile(), which rejects
+ * an ambiguous one. The tables then hold:
+ *  - the messages which consist of a keyword only, in slots of a
+ *    perfect hash of their length and one of their bytes; the byte and
+ *    the shift of the length are searched for here;
+ *  - the other rules, grouped by the session state, command and
+ *    direction they are allowed in;
+ *  - the sessions possible between messages, which the speculative
+ *    validation (splp_spec.c) starts its lanes from.
+ *
+ * Build separately from the test program:
+ *     cl /O2 splpcompile.c splp_grammar.c splp_dfa.c splp_charclass.c
+ *     gcc -O2 -o splpcompile splpcompile.c splp_grammar.c splp_dfa.c splp_charclass.c
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "splpv1.h"
+#include "splp_grammar.h"
+#include "splp_dfa.h"
+#include "splp_charclass.h"
+#include "splptest.h"
+
+
+
+
+#define DEFAULT_OUTPUT_FILENAME   "splp_tables.h"
+#define SPLP_COMPILE_MAX_SLOTS    256
+#define SPLP_COMPILE_MAX_LENGTH   255       /* lengths are kept in a byte */
+#define SPLP_COMPILE_MAX_RULES    255
+#define SPLP_COMPILE_STARTS       64        /* ( direction, state, command ) combinations, see SplpStartKey() */
+
+
+
+
+/* SPLP_COMPILE_HASH
+* Perfect hash of the keyword-only messages: the slot of a message is
+* ( its byte number byteIdx + ( its length << shift ) ) & ( slotCount - 1 )
+*/
+typedef struct _SPLP_COMPILE_HASH
+{
+    unsigned int    byteIdx;
+    unsigned int    shift;
+    unsigned int    slotCount;
+    int             slots[ SPLP_COMPILE_MAX_SLOTS ];     /* rule in the slot, -1 if none */
+
+} SPLP_COMPILE_HASH, *PSPLP_COMPILE_HASH;
+
+
+
+
+/* SplpStartKey
+* Returns the index of the tables of a direction, state and command, the
+* same as SPLP_TABLE_START() written to the tables
+*/
+static unsigned int SplpStartKey(
+    unsigned int direction,
+    unsigned int state,
+    unsigned int command )
+{
+    return ( direction & 1 ) << 5 | ( state & 7 ) << 2 | ( command & 3 );
+}
+
+
+
+
+/* SplpIsKeywordOnly
+* Returns non-zero if the rule allows its keyword and nothing else
+*/
+static int SplpIsKeywordOnly(
+    const struct splp_grammar_rule* pRule )
+{
+    return !pRule->payload.char_class && !pRule->echo && !pRule->open_end;
+}
+
+
+
+
+/* SplpIsBase64
+* Returns non-zero if the payload is exactly what splp_base64_decode()
+* accepts, so the message can be decoded instead of validated
+*/
+static int SplpIsBase64(
+    const struct splp_grammar_rule* pRule )
+{
+    const struct splp_grammar_payload* pPayload = &pRule->payload;
+
+    return pPayload->char_class == SPLP_CLASS_BASE64 && pPayload->min == 0 && pPayload->block == 4 &&
+        pPayload->pad == '=' && pPayload->pad_max == 2 && !pRule->echo && !pRule->open_end;
+}
+
+
+
+
+/* SplpCompileCheck
+* Checks the grammar against what the tables can hold
+*/
+static SPLP_STATUS SplpCompileCheck(
+    const struct splp_grammar* pGrammar )
+{
+    size_t ruleIdx, otherIdx;
+
+    if ( !splp_dfa_compile( pGrammar ) )
+    {
+        printf( "***ERROR*** The grammar %s is ambiguous or doesn't fit into the automaton\n", pGrammar->name );
+        return SPLP_STATUS_ERROR;
+    }
+    if ( pGrammar->rule_count > SPLP_COMPILE_MAX_RULES )
+    {
+        printf( "***ERROR*** The grammar %s has more than %u rules\n", pGrammar->name, SPLP_COMPILE_MAX_RULES );
+        return SPLP_STATUS_ERROR;
+    }
+
+    for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+    {
+        const struct splp_grammar_rule* pRule = &pGrammar->rules[ ruleIdx ];
+
+        if ( strlen( pRule->keyword ) > SPLP_COMPILE_MAX_LENGTH ||
+            ( pRule->echo && strlen( pRule->echo ) > SPLP_COMPILE_MAX_LENGTH ) )
+        {
+            printf( "***ERROR*** Keyword \"%s\" is too long\n", pRule->keyword );
+            return SPLP_STATUS_ERROR;
+        }
+        if ( !pRule->payload.char_class && pRule->payload.min )
+        {
+            printf( "***ERROR*** \"%s\" requires a payload of no class\n", pRule->keyword );
+            return SPLP_STATUS_ERROR;
+        }
+
+        for ( otherIdx = 0; otherIdx < pGrammar->rule_count; otherIdx++ )
+        {
+            const struct splp_grammar_rule* pOther = &pGrammar->rules[ otherIdx ];
+
+            if ( otherIdx == ruleIdx )
+                continue;
+
+            // the hash holds every keyword once
+            if ( SplpIsKeywordOnly( pRule ) && SplpIsKeywordOnly( pOther ) &&
+                0 == strcmp( pRule->keyword, pOther->keyword ) )
+            {
+                printf( "***ERROR*** Keyword \"%s\" is allowed in more than one state\n", pRule->keyword );
+                return SPLP_STATUS_ERROR;
+            }
+
+            // the rules of a state are tried in turn, the first one whose keyword the message starts with decides
+            if ( !SplpIsKeywordOnly( pRule ) && !SplpIsKeywordOnly( pOther ) &&
+                pRule->direction == pOther->direction && pRule->state == pOther->state &&
+                pRule->command == pOther->command &&
+                0 == strncmp( pRule->keyword, pOther->keyword, strlen( pRule->keyword ) ) )
+            {
+                printf( "***ERROR*** Keyword \"%s\" starts \"%s\" in the same state\n", pRule->keyword, pOther->keyword );
+                return SPLP_STATUS_ERROR;
+            }
+        }
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpCompileHash
+* Searches for the smallest perfect hash of the keyword-only messages
+*/
+static SPLP_STATUS SplpCompileHash(
+    const struct splp_grammar* pGrammar,
+    PSPLP_COMPILE_HASH pHash )
+{
+    size_t minLength = SPLP_COMPILE_MAX_LENGTH;
+    size_t ruleIdx;
+
+    for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+    {
+        size_t length = strlen( pGrammar->rules[ ruleIdx ].keyword );
+
+        if ( SplpIsKeywordOnly( &pGrammar->rules[ ruleIdx ] ) && length < minLength )
+            minLength = length;
+    }
+
+    for ( pHash->slotCount = 8; pHash->slotCount <= SPLP_COMPILE_MAX_SLOTS; pHash->slotCount *= 2 )
+    {
+        for ( pHash->shift = 0; pHash->shift < 8; pHash->shift++ )
+        {
+            for ( pHash->byteIdx = 0; pHash->byteIdx < minLength; pHash->byteIdx++ )
+            {
+                unsigned int slotIdx;
+
+                for ( slotIdx = 0; slotIdx < pHash->slotCount; slotIdx++ )
+                    pHash->slots[ slotIdx ] = -1;
+
+                for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+                {
+                    const char* keyword = pGrammar->rules[ ruleIdx ].keyword;
+
+                    if ( !SplpIsKeywordOnly( &pGrammar->rules[ ruleIdx ] ) )
+                        continue;
+                    slotIdx = ( (unsigned char) keyword[ pHash->byteIdx ] +
+                        ( (unsigned int) strlen( keyword ) << pHash->shift ) ) & ( pHash->slotCount - 1 );
+                    if ( pHash->slots[ slotIdx ] >= 0 )
+                        break;
+                    pHash->slots[ slotIdx ] = (int) ruleIdx;
+                }
+                if ( ruleIdx == pGrammar->rule_count )
+                    return SPLP_STATUS_OK;
+            }
+        }
+    }
+
+    printf( "***ERROR*** No perfect hash of the keywords of %s in %u slots\n", pGrammar->name, SPLP_COMPILE_MAX_SLOTS );
+    return SPLP_STATUS_ERROR;
+}
+
+
+
+
+/* SplpWriteText
+* Writes text as a C string literal, or NULL
+*/
+static void SplpWriteText(
+    FILE* file,
+    const char* text )
+{
+    if ( !text )
+    {
+        fprintf( file, "NULL" );
+        return;
+    }
+
+    fputc( '"', file );
+    for ( ; *text; text++ )
+    {
+        if ( *text == '"' || *text == '\\' )
+            fprintf( file, "\\%c", *text );
+        else if ( (unsigned char) *text < 0x20 || (unsigned char) *text >= 0x7f )
+            fprintf( file, "\\x%02x\"\"", (unsigned char) *text );
+        else
+            fputc( *text, file );
+    }
+    fputc( '"', file );
+}
+
+
+
+
+/* SplpCompileWrite
+* Writes the tables of the grammar
+*/
+static void SplpCompileWrite(
+    FILE* file,
+    const struct splp_grammar* pGrammar,
+    PSPLP_COMPILE_HASH pHash )
+{
+    unsigned char laneSeen[ SPLP_GRAMMAR_MAX_STATE + 1 ][ SPLP_GRAMMAR_MAX_COMMAND + 1 ] = { { 0 } };
+    int rowRule[ SPLP_COMPILE_MAX_RULES ];
+    int startRow[ SPLP_COMPILE_STARTS ];                /* first row of the start, -1 if none */
+    unsigned long long keywordStarts = 0;
+    unsigned int rowCount;
+    unsigned int laneCount = 0;
+    unsigned int textMax = 8;
+    unsigned int slotIdx, key, state, command;
+    size_t ruleIdx;
+
+    // keywords and echoes of the rules are kept in the rules, in arrays of whole words
+    for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+    {
+        const struct splp_grammar_rule* pRule = &pGrammar->rules[ ruleIdx ];
+
+        if ( SplpIsKeywordOnly( pRule ) )
+            continue;
+        while ( textMax <= strlen( pRule->keyword ) || ( pRule->echo && textMax <= strlen( pRule->echo ) ) )
+            textMax += 8;
+    }
+
+    fprintf( file,
+        "/*\n"
+        " * splp_tables.h\n"
+        " * The file is part of practical task for System programming course.\n"
+        " * This file contains the tables of the protocol %s. It is written by\n"
+        " * splpcompile from the grammar in splp_grammar.c, don't edit it.\n"
+        " */\n"
+        "\n"
+        "#ifndef SPLP_TABLES_H\n"
+        "#define SPLP_TABLES_H\n"
+        "\n\n", pGrammar->name );
+
+    fprintf( file,
+        "/* index of the tables of a direction, state and command */\n"
+        "#define SPLP_TABLE_START(direction, state, command) \\\n"
+        "\t((((direction) & 1) << 5) | (((state) & 7) << 2) | ((command) & 3))\n"
+        "#define SPLP_TABLE_START_COUNT      %u\n"
+        "\n", SPLP_COMPILE_STARTS );
+
+    fprintf( file,
+        "/* messages which consist of a keyword only: text, length, start they are\n"
+        " * allowed in, new state, new command, type. A message of length n is in slot\n"
+        " * (byte SPLP_TABLE_KEYWORD_BYTE + (n << SPLP_TABLE_KEYWORD_SHIFT)) & (SPLP_TABLE_KEYWORD_SLOTS - 1),\n"
+        " * empty slots have length 0\n"
+        " */\n"
+        "#define SPLP_TABLE_KEYWORD_BYTE     %u\n"
+        "#define SPLP_TABLE_KEYWORD_SHIFT    %u\n"
+        "#define SPLP_TABLE_KEYWORD_SLOTS    %u\n"
+        "#define SPLP_TABLE_KEYWORDS \\\n",
+        pHash->byteIdx, pHash->shift, pHash->slotCount );
+    for ( slotIdx = 0; slotIdx < pHash->slotCount; slotIdx++ )
+    {
+        const struct splp_grammar_rule* pRule = pHash->slots[ slotIdx ] >= 0 ? &pGrammar->rules[ pHash->slots[ slotIdx ] ] : NULL;
+
+        fprintf( file, "\t{ " );
+        if ( pRule )
+        {
+            SplpWriteText( file, pRule->keyword );
+            fprintf( file, ", %u, %u, %u, %u, %u }", (unsigned int) strlen( pRule->keyword ),
+                SplpStartKey( pRule->direction, pRule->state, pRule->command ), pRule->new_state, pRule->new_command, pRule->type );
+        }
+        else
+        {
+            fprintf( file, "\"\", 0, 0, 0, 0, %u }", SPLP_KEYWORD_COUNT );
+        }
+        fprintf( file, slotIdx + 1 < pHash->slotCount ? ", \\\n" : "\n\n" );
+    }
+
+    // the rules of a start in consecutive rows, in the order of the grammar
+    rowCount = 0;
+    for ( key = 0; key < SPLP_COMPILE_STARTS; key++ )
+    {
+        startRow[ key ] = -1;
+        for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+        {
+            const struct splp_grammar_rule* pRule = &pGrammar->rules[ ruleIdx ];
+
+            if ( SplpStartKey( pRule->direction, pRule->state, pRule->command ) != key )
+                continue;
+            if ( SplpIsKeywordOnly( pRule ) )
+            {
+                keywordStarts |= (unsigned long long) 1 << key;
+                continue;
+            }
+            if ( startRow[ key ] < 0 )
+                startRow[ key ] = (int) rowCount;
+            rowRule[ rowCount++ ] = (int) ruleIdx;
+        }
+    }
+
+    fprintf( file,
+        "/* starts which allow keyword-only messages, a bit per SPLP_TABLE_START() */\n"
+        "#define SPLP_TABLE_KEYWORD_STARTS   UINT64_C(0x%016llx)\n"
+        "\n", keywordStarts );
+
+    fprintf( file,
+        "/* the other messages: keyword, its length, payload class, least payload, block,\n"
+        " * padding, most padding, echo, its length, open end, new state, new command, type,\n"
+        " * payload is decoded by splp_base64_decode(), next rule of the start (0 if none).\n"
+        " * Keywords and echoes are shorter than SPLP_TABLE_TEXT_MAX.\n"
+        " */\n"
+        "#define SPLP_TABLE_TEXT_MAX         %u\n"
+        "#define SPLP_TABLE_RULES \\\n", textMax );
+    for ( key = 0; key < rowCount; key++ )
+    {
+        const struct splp_grammar_rule* pRule = &pGrammar->rules[ rowRule[ key ] ];
+        const struct splp_grammar_payload* pPayload = &pRule->payload;
+        unsigned int next = key + 1 < rowCount &&
+            SplpStartKey( pRule->direction, pRule->state, pRule->command ) ==
+            SplpStartKey( pGrammar->rules[ rowRule[ key + 1 ] ].direction, pGrammar->rules[ rowRule[ key + 1 ] ].state,
+                pGrammar->rules[ rowRule[ key + 1 ] ].command ) ? key + 1 : 0;
+
+        fprintf( file, "\t{ " );
+        SplpWriteText( file, pRule->keyword );
+        fprintf( file, ", %u, 0x%02x, %u, %u, %u, %u, ", (unsigned int) strlen( pRule->keyword ),
+            pPayload->char_class, pPayload->min, pPayload->block ? pPayload->block : 1,
+            (unsigned char) pPayload->pad, pPayload->pad_max );
+        SplpWriteText( file, pRule->echo ? pRule->echo : "" );
+        fprintf( file, ", %u, %u, %u, %u, %u, %u, %u }, \\\n", pRule->echo ? (unsigned int) strlen( pRule->echo ) : 0,
+            pRule->open_end ? 1 : 0, pRule->new_state, pRule->new_command, pRule->type, SplpIsBase64( pRule ), next );
+    }
+    // a grammar of keywords only still gets a table
+    fprintf( file, "\t{ \"\", 0, 0, 0, 1, 0, 0, \"\", 0, 0, 0, 0, %u, 0, 0 }\n\n", SPLP_KEYWORD_COUNT );
+
+    fprintf( file,
+        "/* starts which allow the other messages: rule(SPLP_TABLE_START(), its first row\n"
+        " * in SPLP_TABLE_RULES); meant for the cases of a switch the compiler specializes\n"
+        " */\n"
+        "#define SPLP_TABLE_RULE_STARTS(rule)" );
+    for ( key = 0; key < SPLP_COMPILE_STARTS; key++ )
+    {
+        if ( startRow[ key ] >= 0 )
+            fprintf( file, " \\\n\trule(%u, %d)", key, startRow[ key ] );
+    }
+    fprintf( file, "\n\n" );
+
+    // INIT and every session a valid message leaves, an invalid one leaves one of these as well
+    laneSeen[ 1 ][ 0 ] = 1;
+    for ( ruleIdx = 0; ruleIdx < pGrammar->rule_count; ruleIdx++ )
+        laneSeen[ pGrammar->rules[ ruleIdx ].new_state ][ pGrammar->rules[ ruleIdx ].new_command ] = 1;
+    fprintf( file,
+        "/* sessions possible between messages: state, command */\n"
+        "#define SPLP_TABLE_LANES \\\n" );
+    for ( state = 1; state <= SPLP_GRAMMAR_MAX_STATE; state++ )
+    {
+        for ( command = 0; command <= SPLP_GRAMMAR_MAX_COMMAND; command++ )
+        {
+            if ( laneSeen[ state ][ command ] )
+                fprintf( file, "%s\t{ %u, %u }", laneCount++ ? ", \\\n" : "", state, command );
+        }
+    }
+    fprintf( file, "\n#define SPLP_TABLE_LANE_COUNT       %u\n\n", laneCount );
+
+    fprintf( file,
+        "/* 1 if an invalid message returns the session to INIT, 0 if it stays */\n"
+        "#define SPLP_TABLE_RESET_ON_INVALID %u\n"
+        "\n"
+        "#endif /* SPLP_TABLES_H */\n", pGrammar->reset_on_invalid ? 1 : 0 );
+}
+
+
+
+
+/* SplpCompileRun
+* Writes the tables to fileName, or compares them with it
+*/
+static SPLP_STATUS SplpCompileRun(
+    const char* fileName,
+    int check )
+{
+    SPLP_COMPILE_HASH hash;
+    FILE* file;
+    FILE* old;
+    int same;
+    int c;
+
+    if ( SPLP_STATUS_OK != SplpCompileCheck( &splp_grammar_v1 ) ||
+        SPLP_STATUS_OK != SplpCompileHash( &splp_grammar_v1, &hash ) )
+        return SPLP_STATUS_ERROR;
+
+    file = check ? tmpfile( ) : fopen( fileName, "w" );
+    if ( !file )
+    {
+        printf( "***ERROR*** Can't write %s\n", check ? "a temporary file" : fileName );
+        return SPLP_STATUS_ERROR;
+    }
+    SplpCompileWrite( file, &splp_grammar_v1, &hash );
+    if ( !check )
+        return fclose( file ) == 0 ? SPLP_STATUS_OK : SPLP_STATUS_ERROR;
+
+    old = fopen( fileName, "r" );
+    if ( !old )
+    {
+        printf( "***ERROR*** Can't read %s\n", fileName );
+        fclose( file );
+        return SPLP_STATUS_ERROR;
+    }
+    rewind( file );
+    do
+    {
+        c = fgetc( file );
+        same = c == fgetc( old );
+    }
+    while ( same && c != EOF );
+    fclose( old );
+    fclose( file );
+
+    if ( !same )
+    {
+        printf( "%s doesn't match the grammar %s, run splpcompile to write it again\n", fileName, splp_grammar_v1.name );
+        return SPLP_STATUS_ERROR;
+    }
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+int main( int argc, char* argv[ ] )
+{
+    const char* fileName = DEFAULT_OUTPUT_FILENAME;
+    int check = 0;
+    int argIdx;
+
+    for ( argIdx = 1; argIdx < argc; argIdx++ )
+    {
+        if ( 0 == strcmp( argv[ argIdx ], "--check" ) )
+            check = 1;
+        else if ( 0 != strncmp( argv[ argIdx ], "--", 2 ) )
+            fileName = argv[ argIdx ];
+        else
+        {
+            printf( "usage:\n"
+                "\tsplpcompile [--check] [file]  - write the tables of the grammar to file\n"
+                "\t                                (%s), or with --check only compare them.\n",
+                DEFAULT_OUTPUT_FILENAME );
+            return 1;
+        }
+    }
+
+    return SPLP_STATUS_OK == SplpCompileRun( fileName, check ) ? 0 : 1;
+}
@@ -0,0 +1,875 @@
+/*
+ * splpgen.c
+ * The file is part of practical task for System programming course.
+ * This file contains a generator of synthetic SPLPv1 test files. It
+ * produces protocol sessions which follow the rules in splp_grammar.c,
+ * spoils some of the messages on purpose and writes every message with
+ * the verdict it must get, either as a text test file or as a binary
+ * corpus (see splp_corpus.h). With --connections the sessions of several
+ * connections run at once and their messages are interleaved into a
+ * capture, whose lines start with the connection ID. The same options
+ * and seed always produce the same file.
+ *
+ * Build separately from the test program:
+ *     cl /O2 splpgen.c splp_corpus.c
+ *     gcc -O2 -o splpgen splpgen.c splp_corpus.c -lm
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "splpv1.h"
+#include "splptest.h"
+#include "splp_corpus.h"
+
+
+
+
+#define DEFAULT_OUTPUT_FILENAME   "test.txt"
+#define DEFAULT_SESSION_COUNT     1000
+#define DEFAULT_INVALID_RATIO     0.01
+
+/* the test program counts messages with 64 bits */
+#define SPLP_GEN_MAX_MESSAGES     ( SPLP_INVALID_MSG_INDEX - 1 )
+#define SPLP_GEN_MAX_CONNECTIONS  ( 1 << 26 )
+
+
+
+
+/* SPLP_GEN_REQUEST
+* Requests a client can send in the CONNECTED state, besides DISCONNECT
+*/
+typedef enum _SPLP_GEN_REQUEST
+{
+    SPLP_REQUEST_GET_VER,
+    SPLP_REQUEST_GET_DATA,
+    SPLP_REQUEST_GET_COMMAND,
+    SPLP_REQUEST_GET_FILE,
+    SPLP_REQUEST_GET_B64,
+    SPLP_REQUEST_COUNT
+} SPLP_GEN_REQUEST;
+
+static const char* const SplpRequestKeywords[ SPLP_REQUEST_COUNT ] =
+{
+    "GET_VER", "GET_DATA", "GET_COMMAND", "GET_FILE", "GET_B64"
+};
+
+/* names of the requests in --mix */
+static const char* const SplpRequestNames[ SPLP_REQUEST_COUNT ] =
+{
+    "ver", "data", "command", "file", "b64"
+};
+
+
+
+
+/* SPLP_GEN_DIST
+* Distribution of a length or an amount
+*/
+typedef enum _SPLP_GEN_DIST_KIND
+{
+    SPLP_DIST_FIXED,            /* always 'a' */
+    SPLP_DIST_UNIFORM,          /* 'a' to 'b' inclusive */
+    SPLP_DIST_EXP               /* exponential with mean 'a', cut at 'b' */
+} SPLP_GEN_DIST_KIND;
+
+typedef struct _SPLP_GEN_DIST
+{
+    SPLP_GEN_DIST_KIND kind;
+    uint64_t           a;
+    uint64_t           b;
+
+} SPLP_GEN_DIST, *PSPLP_GEN_DIST;
+
+
+
+
+/* SPLP_GEN_OPTIONS
+* What to generate
+*/
+typedef struct _SPLP_GEN_OPTIONS
+{
+    const char*     outputFileName;
+    int             binary;             /* write a binary corpus instead of text */
+    uint64_t        seed;
+    uint64_t        connectionCount;    /* write a capture of this many open connections, 0 - a test file */
+    uint64_t        sessionCount;       /* stop after this many sessions, 0 - no limit */
+    uint64_t        sizeLimit;          /* stop after this many bytes of messages, 0 - no limit */
+    double          invalidRatio;       /* part of the messages to spoil */
+    unsigned int    mix[ SPLP_REQUEST_COUNT ];  /* relative frequency of the requests */
+    SPLP_GEN_DIST   requests;           /* requests per session */
+    SPLP_GEN_DIST   dataLength;         /* data of GET_DATA, GET_COMMAND and GET_FILE replies */
+    SPLP_GEN_DIST   b64Length;          /* base64 text of B64: replies, padding included */
+
+}SPLP_GEN_OPTIONS, *PSPLP_GEN_OPTIONS;
+
+
+
+
+/* SPLP_GEN_CONN
+* A connection and the message its session expects next: the state of
+* the protocol, with 4 standing for the reply to any request
+*/
+typedef struct _SPLP_GEN_CONN
+{
+    uint64_t            id;
+    unsigned int        state;
+    SPLP_GEN_REQUEST    request;        /* request to reply to in state 4 */
+    uint64_t            requestsLeft;
+
+} SPLP_GEN_CONN, *PSPLP_GEN_CONN;
+
+
+
+
+/* SPLP_GEN
+* State of the generator
+*/
+typedef struct _SPLP_GEN
+{
+    PSPLP_GEN_OPTIONS   pOptions;
+    uint64_t            random;         /* xorshift64* state */
+    unsigned int        mixTotal;       /* sum of pOptions->mix */
+
+    char*               message;        /* message being generated */
+    size_t              length;
+    size_t              capacity;
+
+    FILE*               textFile;
+    SPLP_CORPUS_WRITER  writer;
+    uint64_t            connection;     /* ID of the connection the message belongs to */
+
+    uint64_t            sessions;
+    uint64_t            messages;
+    uint64_t            valid;
+    uint64_t            size;           /* bytes of messages written */
+    SPLP_STATUS         status;
+
+} SPLP_GEN, *PSPLP_GEN;
+
+
+
+
+/* SplpGenRandom
+* Returns the next pseudo-random number
+*/
+static uint64_t SplpGenRandom(
+    PSPLP_GEN pGen )
+{
+    pGen->random ^= pGen->random >> 12;
+    pGen->random ^= pGen->random << 25;
+    pGen->random ^= pGen->random >> 27;
+    return pGen->random * 0x2545F4914F6CDD1DULL;
+}
+
+
+
+
+/* SplpGenUniform
+* Returns a pseudo-random number from 0 to limit - 1
+*/
+static uint64_t SplpGenUniform(
+    PSPLP_GEN pGen,
+    uint64_t limit )
+{
+    return limit ? SplpGenRandom( pGen ) % limit : 0;
+}
+
+
+
+
+/* SplpGenChance
+* Returns non-zero with the given probability
+*/
+static int SplpGenChance(
+    PSPLP_GEN pGen,
+    double probability )
+{
+    return (double) ( SplpGenRandom( pGen ) >> 11 ) * ( 1.0 / 9007199254740992.0 ) < probability;
+}
+
+
+
+
+/* SplpGenSample
+* Returns a value drawn from the distribution
+*/
+static uint64_t SplpGenSample(
+    PSPLP_GEN pGen,
+    const SPLP_GEN_DIST* pDist )
+{
+    double u, value;
+
+    switch ( pDist->kind )
+    {
+    case SPLP_DIST_UNIFORM:
+        return pDist->a + SplpGenUniform( pGen, pDist->b - pDist->a + 1 );
+
+    case SPLP_DIST_EXP:
+        u = (double) ( SplpGenRandom( pGen ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+        value = -log( 1.0 - u ) * (double) pDist->a;
+        return value < (double) pDist->b ? (uint64_t) value : pDist->b;
+
+    default:
+        return pDist->a;
+    }
+}
+
+
+
+
+/* SplpGenReserve
+* Makes room for a message of the given length
+*/
+static SPLP_STATUS SplpGenReserve(
+    PSPLP_GEN pGen,
+    size_t length )
+{
+    if ( length > pGen->capacity )
+    {
+        size_t capacity = pGen->capacity ? pGen->capacity : 256;
+        char* message;
+
+        while ( capacity < length )
+            capacity *= 2;
+        message = (char*) realloc( pGen->message, capacity );
+        if ( !message )
+        {
+            pGen->status = SPLP_STATUS_ERROR;
+            return SPLP_STATUS_ERROR;
+        }
+        pGen->message = message;
+        pGen->capacity = capacity;
+    }
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpGenAppend
+* Appends text to the message being generated
+*/
+static void SplpGenAppend(
+    PSPLP_GEN pGen,
+    const char* text,
+    size_t length )
+{
+    if ( SPLP_STATUS_OK == SplpGenReserve( pGen, pGen->length + length + 1 ) )
+    {
+        memcpy( pGen->message + pGen->length, text, length );
+        pGen->length += length;
+    }
+}
+
+
+
+
+/* SplpGenAppendRandom
+* Appends length random characters of the alphabet to the message
+*/
+static void SplpGenAppendRandom(
+    PSPLP_GEN pGen,
+    const char* alphabet,
+    uint64_t length )
+{
+    size_t alphabetSize = strlen( alphabet );
+    uint64_t i;
+
+    if ( SPLP_STATUS_OK != SplpGenReserve( pGen, pGen->length + (size_t) length + 1 ) )
+        return;
+
+    for ( i = 0; i < length; i++ )
+        pGen->message[ pGen->length++ ] = alphabet[ SplpGenUniform( pGen, alphabetSize ) ];
+}
+
+
+
+
+/* SplpGenWrite
+* Writes the message with its expected verdict
+*/
+static void SplpGenWrite(
+    PSPLP_GEN pGen,
+    enum Direction direction,
+    enum test_status expected )
+{
+    if ( pGen->pOptions->binary )
+    {
+        struct MessageView msg;
+
+        msg.direction = direction;
+        msg.text = pGen->message;
+        msg.length = pGen->length;
+        SplpCorpusWriterAdd( &pGen->writer, &msg, expected );
+    }
+    else
+    {
+        if ( pGen->pOptions->connectionCount )
+            fprintf( pGen->textFile, "%llu\t", (unsigned long long) pGen->connection );
+        fprintf( pGen->textFile, "%d\t%d\t", expected == MESSAGE_VALID ? 1 : 0, (int) direction );
+        fwrite( pGen->message, 1, pGen->length, pGen->textFile );
+        fputc( '\n', pGen->textFile );
+    }
+
+    pGen->messages++;
+    pGen->size += pGen->length;
+    if ( expected == MESSAGE_VALID )
+        pGen->valid++;
+}
+
+
+
+
+/* SplpGenSpoil
+* Turns the message expected in the given state into one which is
+* invalid there for sure
+*/
+static void SplpGenSpoil(
+    PSPLP_GEN pGen,
+    unsigned int state,
+    enum Direction* pDirection )
+{
+    /* a message of the right direction which isn't allowed in the state */
+    static const char* const wrongKeywords[ 8 ] =
+    {
+        "", "GET_VER", "DISCONNECT_OK", "CONNECT", "CONNECT_OK", "VERSION 1", "CONNECT_OK", "CONNECT_OK"
+    };
+    size_t position;
+
+    switch ( SplpGenUniform( pGen, 3 ) )
+    {
+    case 0:
+        // every state expects messages of one direction only
+        *pDirection = *pDirection == A_TO_B ? B_TO_A : A_TO_B;
+        break;
+
+    case 1:
+        // '!' belongs to no keyword and no payload class. It is never put
+        // at the very end, where a reply may have trailing bytes.
+        position = (size_t) SplpGenUniform( pGen, pGen->length );
+        if ( SPLP_STATUS_OK == SplpGenReserve( pGen, pGen->length + 2 ) )
+        {
+            memmove( pGen->message + position + 1, pGen->message + position, pGen->length - position );
+            pGen->message[ position ] = '!';
+            pGen->length++;
+        }
+        break;
+
+    default:
+        pGen->length = 0;
+        SplpGenAppend( pGen, wrongKeywords[ state ], strlen( wrongKeywords[ state ] ) );
+        break;
+    }
+}
+
+
+
+
+/* SplpGenMessage
+* Writes the message, which is the one expected in the given state, or
+* spoils it first. Returns non-zero if the message was spoiled, which
+* returns the protocol to the INIT state.
+*/
+static int SplpGenMessage(
+    PSPLP_GEN pGen,
+    unsigned int state,
+    enum Direction direction )
+{
+    int spoil = SplpGenChance( pGen, pGen->pOptions->invalidRatio );
+
+    if ( spoil )
+        SplpGenSpoil( pGen, state, &direction );
+
+    SplpGenWrite( pGen, direction, spoil ? MESSAGE_INVALID : MESSAGE_VALID );
+    pGen->length = 0;
+    return spoil;
+}
+
+
+
+
+/* SplpGenKeyword
+* Writes a message which is just the keyword
+*/
+static int SplpGenKeyword(
+    PSPLP_GEN pGen,
+    unsigned int state,
+    enum Direction direction,
+    const char* keyword )
+{
+    SplpGenAppend( pGen, keyword, strlen( keyword ) );
+    return SplpGenMessage( pGen, state, direction );
+}
+
+
+
+
+/* SplpGenReply
+* Writes the server reply to the request
+*/
+static int SplpGenReply(
+    PSPLP_GEN pGen,
+    SPLP_GEN_REQUEST request )
+{
+    static const char dataAlphabet[ ] = "abcdefghijklmnopqrstuvwxyz0123456789.";
+    static const char b64Alphabet[ ] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const char* keyword = SplpRequestKeywords[ request ];
+    uint64_t length;
+
+    switch ( request )
+    {
+    case SPLP_REQUEST_GET_VER:
+        SplpGenAppend( pGen, "VERSION ", 8 );
+        SplpGenAppend( pGen, "123456789" + SplpGenUniform( pGen, 9 ), 1 );
+        SplpGenAppendRandom( pGen, "0123456789", SplpGenUniform( pGen, 6 ) );
+        return SplpGenMessage( pGen, 4, B_TO_A );
+
+    case SPLP_REQUEST_GET_B64:
+        length = SplpGenSample( pGen, &pGen->pOptions->b64Length ) & ~(uint64_t) 3;
+        SplpGenAppend( pGen, "B64: ", 5 );
+        SplpGenAppendRandom( pGen, b64Alphabet, length );
+        if ( length )
+        {
+            // zero, one or two padding characters
+            uint64_t padding = SplpGenUniform( pGen, 3 );
+            memset( pGen->message + pGen->length - padding, '=', (size_t) padding );
+        }
+        return SplpGenMessage( pGen, 6, B_TO_A );
+
+    default:
+        SplpGenAppend( pGen, keyword, strlen( keyword ) );
+        SplpGenAppend( pGen, " ", 1 );
+        SplpGenAppendRandom( pGen, dataAlphabet, SplpGenSample( pGen, &pGen->pOptions->dataLength ) );
+        SplpGenAppend( pGen, " ", 1 );
+        SplpGenAppend( pGen, keyword, strlen( keyword ) );
+        return SplpGenMessage( pGen, 5, B_TO_A );
+    }
+}
+
+
+
+
+/* SplpGenOpen
+* Starts a new session on the connection
+*/
+static void SplpGenOpen(
+    PSPLP_GEN pGen,
+    PSPLP_GEN_CONN pConn )
+{
+    pConn->requestsLeft = SplpGenSample( pGen, &pGen->pOptions->requests );
+    pConn->state = 1;
+    pConn->id = ++pGen->sessions;   // every session gets a new connection
+}
+
+
+
+
+/* SplpGenStep
+* Writes the next message of the connection's session, from CONNECT to
+* DISCONNECT_OK. Returns non-zero when the session is over, which is
+* early at its first spoiled message.
+*/
+static int SplpGenStep(
+    PSPLP_GEN pGen,
+    PSPLP_GEN_CONN pConn )
+{
+    unsigned int choice, request;
+
+    pGen->connection = pConn->id;
+
+    switch ( pConn->state )
+    {
+    case 1:
+        pConn->state = 2;
+        return SplpGenKeyword( pGen, 1, A_TO_B, "CONNECT" );
+
+    case 2:
+        pConn->state = 3;
+        return SplpGenKeyword( pGen, 2, B_TO_A, "CONNECT_OK" );
+
+    case 3:
+        if ( !pConn->requestsLeft )
+        {
+            pConn->state = 7;
+            return SplpGenKeyword( pGen, 3, A_TO_B, "DISCONNECT" );
+        }
+
+        choice = (unsigned int) SplpGenUniform( pGen, pGen->mixTotal );
+        request = 0;
+        while ( choice >= pGen->pOptions->mix[ request ] )
+            choice -= pGen->pOptions->mix[ request++ ];
+
+        pConn->request = (SPLP_GEN_REQUEST) request;
+        pConn->requestsLeft--;
+        pConn->state = 4;
+        return SplpGenKeyword( pGen, 3, A_TO_B, SplpRequestKeywords[ request ] );
+
+    case 4:
+        // the reply, whichever state 4 to 6 the request leads to
+        pConn->state = 3;
+        return SplpGenReply( pGen, pConn->request );
+
+    default:
+        SplpGenKeyword( pGen, 7, B_TO_A, "DISCONNECT_OK" );
+        return 1;
+    }
+}
+
+
+
+
+/* SplpGenCanOpen
+* Returns non-zero if one more session fits into the limits besides
+* openCount sessions in progress
+*/
+static int SplpGenCanOpen(
+    PSPLP_GEN pGen,
+    uint64_t openCount )
+{
+    PSPLP_GEN_OPTIONS pOptions = pGen->pOptions;
+    // every session is at most 4 + 2 * requests messages long
+    uint64_t sessionMax = 4 + 2 * ( pOptions->requests.kind == SPLP_DIST_FIXED ? pOptions->requests.a : pOptions->requests.b );
+
+    return pGen->status == SPLP_STATUS_OK &&
+        ( !pOptions->sessionCount || pGen->sessions < pOptions->sessionCount ) &&
+        ( !pOptions->sizeLimit || pGen->size < pOptions->sizeLimit ) &&
+        sessionMax <= ( SPLP_GEN_MAX_MESSAGES - pGen->messages ) / ( openCount + 1 );
+}
+
+
+
+
+/* SplpGenRun
+* Generates the whole output file
+*/
+static SPLP_STATUS SplpGenRun(
+    PSPLP_GEN_OPTIONS pOptions )
+{
+    SPLP_GEN gen = { 0 };
+    uint64_t slotCount = pOptions->connectionCount ? pOptions->connectionCount : 1;
+    PSPLP_GEN_CONN connections;
+    uint64_t openCount = 0;
+    unsigned int i;
+
+    gen.pOptions = pOptions;
+    gen.random = pOptions->seed * 0x9E3779B97F4A7C15ULL + 0x632BE59BD9B4E019ULL;
+    if ( gen.random == 0 )
+        gen.random = 1;
+    for ( i = 0; i < SPLP_REQUEST_COUNT; i++ )
+        gen.mixTotal += pOptions->mix[ i ];
+
+    connections = (PSPLP_GEN_CONN) calloc( (size_t) slotCount, sizeof( SPLP_GEN_CONN ) );
+    if ( !connections )
+    {
+        printf( "***ERROR*** Not enough memory for %llu connections\n", (unsigned long long) slotCount );
+        return SPLP_STATUS_ERROR;
+    }
+
+    if ( pOptions->binary )
+    {
+        if ( SPLP_STATUS_OK != SplpCorpusWriterOpen( &gen.writer, pOptions->outputFileName ) )
+            gen.status = SPLP_STATUS_ERROR;
+    }
+    else
+    {
+        gen.textFile = fopen( pOptions->outputFileName, "wb" );
+        if ( !gen.textFile )
+            gen.status = SPLP_STATUS_ERROR;
+        else
+            fprintf( gen.textFile, "%20llu\n", 0ULL );  // rewritten at the end
+    }
+
+    if ( gen.status != SPLP_STATUS_OK )
+    {
+        printf( "***ERROR*** File \"%s\" can't be created\n", pOptions->outputFileName );
+        free( connections );
+        return SPLP_STATUS_ERROR;
+    }
+
+    // the next message comes from a random open connection
+    for ( ;; )
+    {
+        uint64_t connIdx;
+
+        while ( openCount < slotCount && SplpGenCanOpen( &gen, openCount ) )
+            SplpGenOpen( &gen, &connections[ openCount++ ] );
+        if ( !openCount )
+            break;
+
+        connIdx = slotCount > 1 ? SplpGenUniform( &gen, openCount ) : 0;
+        if ( SplpGenStep( &gen, &connections[ connIdx ] ) )
+            connections[ connIdx ] = connections[ --openCount ];
+    }
+
+    if ( pOptions->binary )
+    {
+        if ( SPLP_STATUS_OK != SplpCorpusWriterClose( &gen.writer ) )
+            gen.status = SPLP_STATUS_ERROR;
+    }
+    else
+    {
+        fseek( gen.textFile, 0, SEEK_SET );
+        fprintf( gen.textFile, "%20llu", (unsigned long long) gen.messages );
+        if ( ferror( gen.textFile ) )
+            gen.status = SPLP_STATUS_ERROR;
+        if ( fclose( gen.textFile ) )
+            gen.status = SPLP_STATUS_ERROR;
+    }
+
+    free( gen.message );
+    free( connections );
+
+    if ( gen.status != SPLP_STATUS_OK )
+    {
+        printf( "***ERROR*** File \"%s\" can't be written\n", pOptions->outputFileName );
+        return SPLP_STATUS_ERROR;
+    }
+
+    printf( "Generated %llu sessions, %llu messages (%llu valid), %llu bytes of messages to \"%s\"\n",
+        (unsigned long long) gen.sessions,
+        (unsigned long long) gen.messages,
+        (unsigned long long) gen.valid,
+        (unsigned long long) gen.size,
+        pOptions->outputFileName );
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpParseSize
+* Parses a number with an optional K, M or G suffix
+*/
+static SPLP_STATUS SplpParseSize(
+    const char* text,
+    const char** pEnd,
+    uint64_t* pValue )
+{
+    char* end;
+    uint64_t value = strtoull( text, &end, 10 );
+
+    if ( end == text || *text == '-' )
+        return SPLP_STATUS_ERROR;
+
+    switch ( *end )
+    {
+    case 'K': case 'k': value <<= 10; end++; break;
+    case 'M': case 'm': value <<= 20; end++; break;
+    case 'G': case 'g': value <<= 30; end++; break;
+    }
+
+    *pValue = value;
+    if ( pEnd )
+        *pEnd = end;
+    else if ( *end )
+        return SPLP_STATUS_ERROR;
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpParseDist
+* Parses "n", "uniform:min:max" or "exp:mean[:max]"
+*/
+static SPLP_STATUS SplpParseDist(
+    const char* text,
+    PSPLP_GEN_DIST pDist )
+{
+    const char* end;
+
+    if ( 0 == strncmp( text, "uniform:", 8 ) )
+    {
+        pDist->kind = SPLP_DIST_UNIFORM;
+        if ( SPLP_STATUS_OK != SplpParseSize( text + 8, &end, &pDist->a ) || *end != ':' ||
+            SPLP_STATUS_OK != SplpParseSize( end + 1, NULL, &pDist->b ) || pDist->b < pDist->a )
+        {
+            return SPLP_STATUS_ERROR;
+        }
+    }
+    else if ( 0 == strncmp( text, "exp:", 4 ) )
+    {
+        pDist->kind = SPLP_DIST_EXP;
+        if ( SPLP_STATUS_OK != SplpParseSize( text + 4, &end, &pDist->a ) )
+            return SPLP_STATUS_ERROR;
+        pDist->b = pDist->a * 16;
+        if ( *end == ':' && SPLP_STATUS_OK != SplpParseSize( end + 1, NULL, &pDist->b ) )
+            return SPLP_STATUS_ERROR;
+        if ( *end && *end != ':' )
+            return SPLP_STATUS_ERROR;
+    }
+    else
+    {
+        pDist->kind = SPLP_DIST_FIXED;
+        return SplpParseSize( text, NULL, &pDist->a );
+    }
+
+    return SPLP_STATUS_OK;
+}
+
+
+
+
+/* SplpParseMix
+* Parses "name:weight,..." where name is one of SplpRequestNames.
+* Requests which aren't listed are not generated.
+*/
+static SPLP_STATUS SplpParseMix(
+    const char* text,
+    unsigned int* mix )
+{
+    unsigned int total = 0;
+    unsigned int i;
+
+    memset( mix, 0, SPLP_REQUEST_COUNT * sizeof( mix[ 0 ] ) );
+
+    while ( *text )
+    {
+        char* end;
+        unsigned long weight;
+
+        for ( i = 0; i < SPLP_REQUEST_COUNT; i++ )
+        {
+            size_t nameLength = strlen( SplpRequestNames[ i ] );
+            if ( 0 == strncmp( text, SplpRequestNames[ i ], nameLength ) && text[ nameLength ] == ':' )
+            {
+                text += nameLength + 1;
+                break;
+            }
+        }
+        if ( i == SPLP_REQUEST_COUNT )
+            return SPLP_STATUS_ERROR;
+
+        weight = strtoul( text, &end, 10 );
+        if ( end == text || weight > 1000000 || ( *end && *end != ',' ) )
+            return SPLP_STATUS_ERROR;
+        mix[ i ] = (unsigned int) weight;
+        total += (unsigned int) weight;
+        text = *end ? end + 1 : end;
+    }
+
+    return total ? SPLP_STATUS_OK : SPLP_STATUS_ERROR;
+}
+
+
+
+
+void SplpGenPrintUsage( )
+{
+    printf( "usage:\n"
+        "\tsplpgen [options] [output]  - generate a test file, \"" DEFAULT_OUTPUT_FILENAME "\" by default.\n"
+        "\toptions:\n"
+        "\t  --binary              - write a binary corpus instead of a text file.\n"
+        "\t  --connections=n       - write a capture of n connections open at once.\n"
+        "\t  --seed=n              - seed of the generator (1).\n"
+        "\t  --sessions=n          - amount of sessions (1000, no limit with --size).\n"
+        "\t  --size=n[K|M|G]       - stop after n bytes of messages.\n"
+        "\t  --invalid=ratio       - part of the messages to spoil (0.01).\n"
+        "\t  --mix=name:weight,... - relative frequency of ver, data, command,\n"
+        "\t                          file and b64 requests (1 each).\n"
+        "\t  --requests=dist       - requests per session (uniform:0:8).\n"
+        "\t  --data-length=dist    - data length of GET_xxx replies (uniform:0:32).\n"
+        "\t  --b64-length=dist     - base64 length of B64: replies (uniform:0:48).\n"
+        "\tdist is n, uniform:min:max or exp:mean[:max], max is 16*mean by default.\n" );
+}
+
+
+
+
+SPLP_STATUS SplpGenOptionsInitializeFromCmdLine(
+    PSPLP_GEN_OPTIONS pOptions,
+    int argc,
+    char* argv[ ] )
+{
+    SPLP_STATUS Status = SPLP_STATUS_OK;
+    int sessionsGiven = 0;
+    int argIdx;
+    unsigned int i;
+
+    pOptions->outputFileName = DEFAULT_OUTPUT_FILENAME;
+    pOptions->seed = 1;
+    pOptions->sessionCount = DEFAULT_SESSION_COUNT;
+    pOptions->invalidRatio = DEFAULT_INVALID_RATIO;
+    for ( i = 0; i < SPLP_REQUEST_COUNT; i++ )
+        pOptions->mix[ i ] = 1;
+    SplpParseDist( "uniform:0:8", &pOptions->requests );
+    SplpParseDist( "uniform:0:32", &pOptions->dataLength );
+    SplpParseDist( "uniform:0:48", &pOptions->b64Length );
+
+    for ( argIdx = 1; argIdx < argc && Status == SPLP_STATUS_OK; argIdx++ )
+    {
+        const char* arg = argv[ argIdx ];
+
+        if ( 0 == strcmp( arg, "--binary" ) )
+            pOptions->binary = 1;
+        else if ( 0 == strncmp( arg, "--connections=", 14 ) )
+        {
+            Status = SplpParseSize( arg + 14, NULL, &pOptions->connectionCount );
+            if ( !pOptions->connectionCount || pOptions->connectionCount > SPLP_GEN_MAX_CONNECTIONS )
+                Status = SPLP_STATUS_ERROR;
+        }
+        else if ( 0 == strncmp( arg, "--seed=", 7 ) )
+            Status = SplpParseSize( arg + 7, NULL, &pOptions->seed );
+        else if ( 0 == strncmp( arg, "--sessions=", 11 ) )
+        {
+            Status = SplpParseSize( arg + 11, NULL, &pOptions->sessionCount );
+            sessionsGiven = 1;
+        }
+        else if ( 0 == strncmp( arg, "--size=", 7 ) )
+            Status = SplpParseSize( arg + 7, NULL, &pOptions->sizeLimit );
+        else if ( 0 == strncmp( arg, "--invalid=", 10 ) )
+        {
+            char* end;
+            pOptions->invalidRatio = strtod( arg + 10, &end );
+            if ( end == arg + 10 || *end || pOptions->invalidRatio < 0.0 || pOptions->invalidRatio > 1.0 )
+                Status = SPLP_STATUS_ERROR;
+        }
+        else if ( 0 == strncmp( arg, "--mix=", 6 ) )
+            Status = SplpParseMix( arg + 6, pOptions->mix );
+        else if ( 0 == strncmp( arg, "--requests=", 11 ) )
+            Status = SplpParseDist( arg + 11, &pOptions->requests );
+        else if ( 0 == strncmp( arg, "--data-length=", 14 ) )
+            Status = SplpParseDist( arg + 14, &pOptions->dataLength );
+        else if ( 0 == strncmp( arg, "--b64-length=", 13 ) )
+            Status = SplpParseDist( arg + 13, &pOptions->b64Length );
+        else if ( 0 != strncmp( arg, "--", 2 ) )
+            pOptions->outputFileName = arg;
+        else
+            Status = SPLP_STATUS_ERROR;
+    }
+
+    // a size alone isn't limited by the default session count
+    if ( pOptions->sizeLimit && !sessionsGiven )
+        pOptions->sessionCount = 0;
+    if ( !pOptions->sessionCount && !pOptions->sizeLimit )
+        Status = SPLP_STATUS_ERROR;
+    // a binary corpus has no connection IDs
+    if ( pOptions->binary && pOptions->connectionCount )
+        Status = SPLP_STATUS_ERROR;
+
+    if ( Status != SPLP_STATUS_OK )
+    {
+        SplpGenPrintUsage( );
+    }
+
+    return Status;
+}
+
+
+
+
+int main( int argc, char* argv[ ] )
+{
+    SPLP_GEN_OPTIONS GenOptions = { 0 };
+
+    if ( SPLP_STATUS_OK != SplpGenOptionsInitializeFromCmdLine( &GenOptions, argc, argv ) ||
+        SPLP_STATUS_OK != SplpGenRun( &GenOptions ) )
+    {
+        return 1;
+    }
+
+    return 0;
+}
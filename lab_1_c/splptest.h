@@ -0,0 +1,25 @@
+/*
+ * splptest.h
+ * The file is part of practical task for System programming course.
+ * This file contains definitions shared by the test program modules.
+ */
+
+#ifndef SPLPTEST_H
+#define SPLPTEST_H
+
+#include <stdint.h>
+
+
+/* messages are counted with 64 bits, this index means "no message" */
+#define SPLP_INVALID_MSG_INDEX    UINT64_MAX
+
+
+
+
+typedef enum _SPLP_STATUS
+{
+    SPLP_STATUS_OK,
+    SPLP_STATUS_ERROR
+} SPLP_STATUS;
+
+#endif /* SPLPTEST_H */
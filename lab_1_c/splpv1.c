@@ -12,58 +12,175 @@
 
 
  /*
- ---------------------------------------------------------------------------------------------------------------------------
- # |      STATE      |         DESCRIPTION       |           ALLOWED MESSAGES            | NEW STATE | EXAMPLE
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 1 | INIT            | initial state             | A->B     CONNECT                      |     2     |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 2 | CONNECTING      | client is waiting for con-| A<-B     CONNECT_OK                   |     3     |
-   |                 | nection approval from srv |                                       |           |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 3 | CONNECTED       | Connection is established | A->B     GET_VER                      |     4     |
-   |                 |                           |        -------------------------------+-----------+----------------------
-   |                 |                           |          One of the following:        |     5     |
-   |                 |                           |          - GET_DATA                   |           |
-   |                 |                           |          - GET_FILE                   |           |
-   |                 |                           |          - GET_COMMAND                |           |
-   |                 |                           |        -------------------------------+-----------+----------------------
-   |                 |                           |          GET_B64                      |     6     |
-   |                 |                           |        ------------------------------------------------------------------
-   |                 |                           |          DISCONNECT                   |     7     |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 4 | WAITING_VER     | Client is waiting for     | A<-B     VERSION ver                  |     3     | VERSION 2
-   |                 | server to provide version |          Where ver is an integer (>0) |           |
-   |                 | information               |          value. Only a single space   |           |
-   |                 |                           |          is allowed in the message    |           |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 5 | WAITING_DATA    | Client is waiting for a   | A<-B     CMD data CMD                 |     3     | GET_DATA a GET_DATA
-   |                 | response from server      |                                       |           |
-   |                 |                           |          CMD - command sent by the    |           |
-   |                 |                           |           client in previous message  |           |
-   |                 |                           |          data - string which contains |           |
-   |                 |                           |           the following allowed cha-  |           |
-   |                 |                           |           racters: small latin letter,|           |
-   |                 |                           |           digits and '.'              |           |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 6 | WAITING_B64_DATA| Client is waiting for a   | A<-B     B64: data                    |     3     | B64: SGVsbG8=
-   |                 | response from server.     |          where data is a base64 string|           |
-   |                 |                           |          only 1 space is allowed      |           |
- --+-----------------+---------------------------+---------------------------------------+-----------+----------------------
- 7 | DISCONNECTING   | Client is waiting for     | A<-B     DISCONNECT_OK                |     1     |
-   |                 | server to close the       |                                       |           |
-   |                 | connection                |                                       |           |
- ---------------------------------------------------------------------------------------------------------------------------
-
- IN CASE OF INVALID MESSAGE THE STATE SHOULD BE RESET TO 1 (INIT)
-
+ The states of the protocol and the messages allowed in them are
+ described in splp_grammar.c. The validator runs on splp_tables.h,
+ which splpcompile generates from there.
  */
 
- 
+
 #include "splpv1.h"
+#include "splp_compiler.h"
+#include "splp_charclass.h"
+#include "splp_stats.h"
+#include "splp_tables.h"
 
 #include <string.h>
 
 
+/*
+ * Messages which consist of a keyword only are looked up with a perfect
+ * hash of their length and one of their bytes, so a lookup is the hash,
+ * a length compare and a compare of two overlapping words, no matter
+ * how many keywords the state allows. keyword_table[] holds the keywords
+ * in the slots KEYWORD_SLOT() gives for them; unused slots have length 0
+ * and match nothing. The other messages are checked against the rules
+ * of the session's state in turn: their keyword, the run of payload
+ * characters after it, the padding and the echo. Each state with such
+ * rules is a case of a switch in which they are inlined, so the compiler
+ * turns the rules of the state into code comparing constants, as a
+ * validator written by hand would.
+ */
+#define KEYWORD_SLOT(message, length) \
+	(((unsigned char)(message)[SPLP_TABLE_KEYWORD_BYTE] + ((unsigned int)(length) << SPLP_TABLE_KEYWORD_SHIFT)) & \
+	(SPLP_TABLE_KEYWORD_SLOTS - 1))
+
+struct keyword_entry {
+	const char* text;
+	unsigned char length;
+	unsigned char start;                    /* SPLP_TABLE_START() of the session it is expected in */
+	unsigned char new_state;
+	unsigned char new_command;
+	unsigned char type;                     /* enum splp_keyword */
+};
+
+struct payload_rule {
+	char keyword[SPLP_TABLE_TEXT_MAX];
+	unsigned char keyword_length;
+	unsigned char char_class;               /* SPLP_CLASS_*, 0 if nothing but the echo may follow the keyword */
+	unsigned char min;
+	unsigned char block;                    /* payload and padding are a multiple of it, a power of 2 */
+	char pad;
+	unsigned char pad_max;
+	char echo[SPLP_TABLE_TEXT_MAX];
+	unsigned char echo_length;              /* 0 if there is no echo */
+	unsigned char open_end;                 /* anything may follow the echo */
+	unsigned char new_state;
+	unsigned char new_command;
+	unsigned char type;                     /* enum splp_keyword */
+	unsigned char base64;                   /* the payload is what splp_base64_decode() accepts */
+	unsigned short next;                    /* next rule of the state, 0 if none */
+};
+
+static const struct keyword_entry keyword_table[SPLP_TABLE_KEYWORD_SLOTS] = { SPLP_TABLE_KEYWORDS };
+static const struct payload_rule payload_rules[] = { SPLP_TABLE_RULES };
+
+/* starts with rules in payload_rules[], a bit per SPLP_TABLE_START() */
+#define RULE_START_BIT(start, row) | ((uint64_t)1 << (start))
+#define RULE_STARTS (0 SPLP_TABLE_RULE_STARTS(RULE_START_BIT))
+
+/* compares length bytes, 4 to 16 of them with two overlapping loads from each side */
+static __inline int same_bytes(const char* a, const char* b, size_t length) {
+	if (length >= 8) {
+		uint64_t a0, a1, b0, b1;
+		memcpy(&a0, a, 8);
+		memcpy(&a1, a + length - 8, 8);
+		memcpy(&b0, b, 8);
+		memcpy(&b1, b + length - 8, 8);
+		return ((a0 ^ b0) | (a1 ^ b1)) == 0 && (length <= 16 || memcmp(a + 8, b + 8, length - 16) == 0);
+	}
+	else if (length >= 4) {
+		uint32_t a0, a1, b0, b1;
+		memcpy(&a0, a, 4);
+		memcpy(&a1, a + length - 4, 4);
+		memcpy(&b0, b, 4);
+		memcpy(&b1, b + length - 4, 4);
+		return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+	}
+	return memcmp(a, b, length) == 0;
+}
+
+/* entry of the keyword the message consists of, NULL if it isn't one expected in the start */
+static const struct keyword_entry* find_keyword(const char* message, size_t length, unsigned int start) {
+	const struct keyword_entry* entry;
+
+	if (length <= SPLP_TABLE_KEYWORD_BYTE)
+		return NULL;
+	entry = &keyword_table[KEYWORD_SLOT(message, length)];
+	return length == entry->length && start == entry->start && same_bytes(message, entry->text, length) ? entry : NULL;
+}
+
+/* rule of the state beginning at row whose keyword the message begins with, NULL if none */
+static SPLP_FORCE_INLINE const struct payload_rule* find_rule(unsigned int row, const char* message, size_t length) {
+	const struct payload_rule* rule = &payload_rules[row];
+
+	for (;;) {
+		if (length >= rule->keyword_length && same_bytes(message, rule->keyword, rule->keyword_length))
+			return rule;
+		if (!rule->next)
+			return NULL;
+		rule = &payload_rules[rule->next];
+	}
+}
+
+
+/* session used by validate_message() for callers tracking a single connection */
+static struct SplpSession DefaultSession = { 1, 0, 0 };
+
+void splp_session_init(struct SplpSession* session) {
+	session->state = 1;
+	session->command = 0;
+	session->position = 0;
+}
+
+enum test_status get_return_value_and_update_state(struct SplpSession* session, enum test_status result, int state, int command,
+	enum splp_keyword type) {
+	(void)type;     /* counted only with SPLP_STATS */
+	SPLP_STATS_MESSAGE(session->state, session->command, type);
+	session->state = (unsigned char)state;
+	session->command = (unsigned char)command;
+	return result;
+}
+
+
+/* rejects the message, counting the check which failed */
+static enum test_status reject_message(struct SplpSession* session, enum splp_reject reject) {
+	(void)reject;   /* counted only with SPLP_STATS */
+	SPLP_STATS_ADD(rejects[reject], 1);
+#if SPLP_TABLE_RESET_ON_INVALID
+	return get_return_value_and_update_state(session, MESSAGE_INVALID, 1, 0, SPLP_KEYWORD_COUNT);
+#else
+	return get_return_value_and_update_state(session, MESSAGE_INVALID, session->state, session->command, SPLP_KEYWORD_COUNT);
+#endif
+}
+
+
+/* accepts the message, describing it in result if the caller wants it */
+static enum test_status accept_message(struct SplpSession* session, struct SplpResult* result, int state, int command,
+	enum splp_keyword type, size_t payload_offset, size_t payload_length) {
+	if (result) {
+		result->type = type;
+		result->payload_offset = payload_offset;
+		result->payload_length = payload_length;
+		result->version = 0;
+	}
+	return get_return_value_and_update_state(session, MESSAGE_VALID, state, command, type);
+}
+
+/* value of a string of decimal digits, UINT64_MAX if it doesn't fit */
+static uint64_t parse_version(const char* digits, size_t length) {
+	uint64_t value = 0;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		unsigned int digit = (unsigned int)(digits[i] - '0');
+		if (value > (UINT64_MAX - digit) / 10)
+			return UINT64_MAX;
+		value = value * 10 + digit;
+	}
+	return value;
+}
+
+
  /* FUNCTION:  validate_message
    *
    * PURPOSE:
@@ -79,232 +196,269 @@
    *    MESSAGE_INVALID if the message is incorrect or out of protocol
    *    state
    */
+enum test_status validate_message(struct Message* msg) {
+	return splp_validate(&DefaultSession, msg);
+}
 
-const int base64_data[] =
-{
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-	0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 
-	1, 1, 1, 1, 1, 1, 1, 1, 0, 0,
-	0, 0, 0, 0, 0, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 0, 0, 0, 0, 0, 0, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 0, 0, 0, 0, 0
-};
 
-int validate_b64(char* message) {
-	if (strncmp("B64: ", message, 5) != 0)
-		return 0;
-	message += 5;
+ /* FUNCTION:  splp_validate
+   *
+   * PURPOSE:
+   *    Same as validate_message(), but the protocol state is taken from
+   *    and stored to the given session, so every connection (and every
+   *    thread) can be validated independently
+   *
+   * PARAMETERS:
+   *    session - state of the connection the message belongs to
+   *    msg - pointer to a structure which stores information about
+   *    message
+   *
+   * RETURN VALUE:
+   *    MESSAGE_VALID if the message is correct
+   *    MESSAGE_INVALID if the message is incorrect or out of protocol
+   *    state
+   */
+enum test_status splp_validate(struct SplpSession* session, const struct Message* msg) {
+	struct MessageView view;
+
+	view.direction = msg->direction;
+	view.text = msg->text_message;
+	view.length = strlen(msg->text_message);
+	return splp_validate_view(session, &view);
+}
+
 
-	char* t = message;
-	while (*t != '\0') {
-		if (!base64_data[*t])
-			break;
-		t++;
+/* validates what follows the keyword of the rule */
+static SPLP_FORCE_INLINE enum test_status validate_payload(struct SplpSession* session, const struct MessageView* view, struct SplpResult* result,
+	const struct payload_rule* rule) {
+	const char* payload = view->text + rule->keyword_length;
+	const char* end = view->text + view->length;
+	size_t run = rule->char_class ? splp_class_span(payload, end - payload, rule->char_class) : 0;
+	const char* p = payload + run;
+	unsigned int pads = 0;
+	enum test_status status;
+
+	while (pads < rule->pad_max && p != end && *p == rule->pad) {
+		p++;
+		pads++;
+	}
+	if (run < rule->min || ((run + pads) & (rule->block - 1)))
+		return reject_message(session, SPLP_REJECT_PAYLOAD);
+	if (rule->echo_length) {
+		if ((size_t)(end - p) < rule->echo_length || !same_bytes(p, rule->echo, rule->echo_length))
+			return reject_message(session, SPLP_REJECT_ECHO);
+		p += rule->echo_length;
 	}
+	if (p != end && !rule->open_end)
+		return reject_message(session, rule->echo_length ? SPLP_REJECT_ECHO : SPLP_REJECT_PAYLOAD);
+
+	status = accept_message(session, result, rule->new_state, rule->new_command, (enum splp_keyword)rule->type,
+		rule->keyword_length, run + pads);
+	if (result && rule->type == SPLP_KEYWORD_VERSION)
+		result->version = parse_version(payload, run);
+	return status;
+}
 
-	if (*t == '=') {
-		t++;
-		if (*t == '=') {
-			t++;
-			if (*t != '\0')
-				return 0;
-		}
-		else if (*t != '\0') 
-			return 0;
+
+/* validates the message, result is NULL if the caller doesn't need it */
+static enum test_status validate_view(struct SplpSession* session, const struct MessageView* view, struct SplpResult* result) {
+	unsigned int key = SPLP_TABLE_START(view->direction, session->state, session->command);
+	const struct payload_rule* rule;
+
+	/* the keyword table first: most messages are a keyword alone */
+	if ((SPLP_TABLE_KEYWORD_STARTS >> key) & 1) {
+		const struct keyword_entry* entry = find_keyword(view->text, view->length, key);
+
+		if (entry)
+			return accept_message(session, result, entry->new_state, entry->new_command, (enum splp_keyword)entry->type, 0, 0);
+	}
+
+	switch (key) {
+#define RULE_CASE(start, row) \
+	case start: \
+		rule = find_rule(row, view->text, view->length); \
+		if (rule) \
+			return validate_payload(session, view, result, rule); \
+		break;
+	SPLP_TABLE_RULE_STARTS(RULE_CASE)
+#undef RULE_CASE
 	}
-	else if (*t != '\0')
-		return 0;
+	return reject_message(session, ((SPLP_TABLE_KEYWORD_STARTS | RULE_STARTS) >> key) & 1 ? SPLP_REJECT_KEYWORD : SPLP_REJECT_DIRECTION);
+}
 
-	if ((t - message) % 4 != 0) 
-		return 0;
 
-	return 1;
+ /* FUNCTION:  splp_validate_view
+   *
+   * PURPOSE:
+   *    Same as splp_validate() for a message given by pointer and length,
+   *    e.g. a part of a receive buffer which isn't NUL-terminated
+   *
+   * PARAMETERS:
+   *    session - state of the connection the message belongs to
+   *    view - the message
+   *
+   * RETURN VALUE:
+   *    MESSAGE_VALID if the message is correct
+   *    MESSAGE_INVALID if the message is incorrect or out of protocol
+   *    state
+   */
+enum test_status splp_validate_view(struct SplpSession* session, const struct MessageView* view) {
+	return validate_view(session, view, NULL);
 }
 
-const int data[] =
-{
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 0, 0, 0, 0
-};
 
-const int numbers[] =
-{
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0
-};
+ /* FUNCTION:  splp_validate_view_ex
+   *
+   * PURPOSE:
+   *    Same as splp_validate_view(), and for a valid message the result
+   *    gets its type, its payload and the VERSION number, so the caller
+   *    doesn't have to parse the message again
+   *
+   * PARAMETERS:
+   *    session - state of the connection the message belongs to
+   *    view - the message
+   *    result - description of a valid message, not changed otherwise
+   *
+   * RETURN VALUE:
+   *    MESSAGE_VALID if the message is correct
+   *    MESSAGE_INVALID if the message is incorrect or out of protocol
+   *    state
+   */
+enum test_status splp_validate_view_ex(struct SplpSession* session, const struct MessageView* view, struct SplpResult* result) {
+	return validate_view(session, view, result);
+}
 
-int CurrentState = 1;
-int Command = 0;
 
-enum test_status get_return_value_and_update_state(enum test_status result, int state, int command) {
-	CurrentState = state;
-	Command = command;
-	return result;
+enum test_status splp_validate_ex(struct SplpSession* session, const struct Message* msg, struct SplpResult* result) {
+	struct MessageView view;
+
+	view.direction = msg->direction;
+	view.text = msg->text_message;
+	view.length = strlen(msg->text_message);
+	return validate_view(session, &view, result);
 }
 
 
-enum test_status validate_message(struct Message* msg) {
-	char* message = msg->text_message;
-	switch (msg->direction) {
-	case A_TO_B: {
-		switch (CurrentState) {
-		case 1: {
-			if (strcmp(message, "CONNECT") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 2, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-		}
-		case 3: {
-			if (strcmp(message, "GET_VER") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 4, 0);
-			}
-
-			if (strcmp(message, "GET_DATA") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 5, 1);
-			}
-
-			if (strcmp(message, "GET_COMMAND") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 5, 2);
-
-			}
-			if (strcmp(message, "GET_FILE") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 5, 3);
-			}
-
-			if (strcmp(message, "GET_B64") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 6, 0);
-			}
-
-			if (strcmp(message, "DISCONNECT") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 7, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-		}
-		} //switch CUR
+ /* FUNCTION:  splp_validate_view_decode
+   *
+   * PURPOSE:
+   *    Same as splp_validate_view(), but a valid B64: message is decoded
+   *    into the caller's buffer in the same pass over its payload
+   *
+   * PARAMETERS:
+   *    session - state of the connection the message belongs to
+   *    view - the message
+   *    decoded - SPLP_BASE64_DECODED_MAX(view->length) bytes receiving
+   *    the data of a B64: message
+   *    decoded_length - length of the decoded data, 0 for other messages
+   *
+   * RETURN VALUE:
+   *    MESSAGE_VALID if the message is correct
+   *    MESSAGE_INVALID if the message is incorrect or out of protocol
+   *    state
+   */
+enum test_status splp_validate_view_decode(struct SplpSession* session, const struct MessageView* view,
+	unsigned char* decoded, size_t* decoded_length) {
+	unsigned int key = SPLP_TABLE_START(view->direction, session->state, session->command);
+	const struct payload_rule* rule = NULL;
+	size_t length;
+
+	*decoded_length = 0;
+	switch (key) {
+#define DECODE_CASE(start, row) \
+	case start: \
+		rule = &payload_rules[row]; \
+		break;
+	SPLP_TABLE_RULE_STARTS(DECODE_CASE)
+#undef DECODE_CASE
 	}
-			   break;
-	case B_TO_A: {
-		switch (CurrentState) {
-		case 2: {
-			if (strcmp(message, "CONNECT_OK") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-		}
+	/* only a state whose single message is a keyword and base64 data is decoded */
+	if (!rule || rule->next || !rule->base64 || ((SPLP_TABLE_KEYWORD_STARTS >> key) & 1))
+		return splp_validate_view(session, view);
+
+	if (view->length < rule->keyword_length || !same_bytes(view->text, rule->keyword, rule->keyword_length))
+		return reject_message(session, SPLP_REJECT_KEYWORD);
+	length = splp_base64_decode(view->text + rule->keyword_length, view->length - rule->keyword_length, decoded);
+	if (length == SPLP_BASE64_INVALID)
+		return reject_message(session, SPLP_REJECT_PAYLOAD);
+
+	*decoded_length = length;
+	return get_return_value_and_update_state(session, MESSAGE_VALID, rule->new_state, rule->new_command,
+		(enum splp_keyword)rule->type);
+}
 
-		case 4: {
-			if (strncmp(message, "VERSION ", 8) == 0) {
-				int num = 8;
-				if (numbers[message[num]] != 1) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				num++;
-				while (message[num] != '\0') {
-					if (numbers[message[num]] != 1) {
-						return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-					}
-					num++;
-				}
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-		}
 
-		case 5: {
-			switch (Command) {
-			case 1: {
-				char* p = message;
-				if (strncmp(p, "GET_DATA ", 9) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				p += 9;
-				while (data[*p] != 0) {
-					++p;
-				}
-				if (strncmp(p, " GET_DATA", 9) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-
-			case 2: {
-				char* p = message;
-				if (strncmp(p, "GET_COMMAND ", 12) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				p += 12;
-				while (data[*p] != 0) {
-					++p;
-				}
-				if (strncmp(p, " GET_COMMAND", 12) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-
-			case 3: {
-				char* p = message;
-				if (strncmp(p, "GET_FILE ", 9) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				p += 9;
-				while (data[*p] != 0) {
-					++p;
-				}
-				if (strncmp(p, " GET_FILE", 9) != 0) {
-					return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-				}
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-
-			} //switch Command
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
+ /* FUNCTION:  splp_validate_batch
+   *
+   * PURPOSE:
+   *    Validates count consecutive messages of one connection and stores
+   *    the verdicts as a bitmap (see SPLP_VERDICT_WORDS in splpv1.h)
+   *
+   * PARAMETERS:
+   *    session - state of the connection, updated after the last message
+   *    messages - array of count messages
+   *    verdicts - SPLP_VERDICT_WORDS(count) words receiving the verdicts
+   */
+void splp_validate_batch(struct SplpSession* session, const struct Message* messages, size_t count, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	size_t i = 0;
+
+	while (i < count) {
+		size_t n = count - i < 64 ? count - i : 64;
+		uint64_t word = 0;
+		size_t bit;
+
+		for (bit = 0; bit < n; bit++) {
+			word |= (uint64_t)(splp_validate(&local, &messages[i + bit]) == MESSAGE_VALID) << bit;
 		}
+		*verdicts++ = word;
+		i += n;
+	}
+
+	*session = local;
+}
+
+
+void splp_validate_view_batch(struct SplpSession* session, const struct MessageView* messages, size_t count, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	size_t i = 0;
+
+	while (i < count) {
+		size_t n = count - i < 64 ? count - i : 64;
+		uint64_t word = 0;
+		size_t bit;
 
-		case 6: {
-			if (validate_b64(message)) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 3, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
+		for (bit = 0; bit < n; bit++) {
+			word |= (uint64_t)(splp_validate_view(&local, &messages[i + bit]) == MESSAGE_VALID) << bit;
 		}
+		*verdicts++ = word;
+		i += n;
+	}
+
+	*session = local;
+}
+
 
-		case 7: {
-			if (strcmp(message, "DISCONNECT_OK") == 0) {
-				return get_return_value_and_update_state(MESSAGE_VALID, 1, 0);
-			}
-			return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
+void splp_validate_block(struct SplpSession* session, const struct MessageBlock* block, uint64_t* verdicts) {
+	struct SplpSession local = *session;
+	struct MessageView view;
+	size_t i = 0;
+
+	while (i < block->count) {
+		size_t n = block->count - i < 64 ? block->count - i : 64;
+		uint64_t directions = block->directions[i / 64];
+		uint64_t word = 0;
+		size_t bit;
+
+		for (bit = 0; bit < n; bit++) {
+			view.direction = (directions >> bit) & 1 ? B_TO_A : A_TO_B;
+			view.text = block->text + block->offsets[i + bit];
+			view.length = (size_t)(block->offsets[i + bit + 1] - block->offsets[i + bit]);
+			word |= (uint64_t)(splp_validate_view(&local, &view) == MESSAGE_VALID) << bit;
 		}
-		} //switch CUR
+		*verdicts++ = word;
+		i += n;
 	}
-			   break;
-	} //switch direction
-	return get_return_value_and_update_state(MESSAGE_INVALID, 1, 0);
-}
\ No newline at end of file
+
+	*session = local;
+}
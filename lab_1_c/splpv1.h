@@ -5,6 +5,12 @@
  * declaration of handle_message() function
  */
 
+#ifndef SPLPV1_H
+#define SPLPV1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
 
 
 enum test_status 
@@ -28,4 +34,125 @@ struct Message /* message */
 };
 
 
+/* MessageView
+ * A message given by its address and length. The text doesn't have to
+ * be NUL-terminated, so a view can point straight into a buffer which
+ * holds several messages back to back.
+ */
+struct MessageView
+{
+	enum Direction	direction;
+	const char		*text;
+	size_t			length;
+};
+
+
+/* MessageBlock
+ * count messages stored as a structure of arrays: message i is the text
+ * between text + offsets[i] and text + offsets[i + 1], and bit (i % 64)
+ * of directions[i / 64] is set if the message goes B_TO_A.
+ */
+struct MessageBlock
+{
+	const char		*text;
+	const uint64_t	*offsets;
+	const uint64_t	*directions;
+	size_t			count;
+};
+
+
+/* splp_keyword
+ * Type of an accepted message, by the keyword it starts with. A reply
+ * to GET_DATA, GET_COMMAND or GET_FILE is named after its command.
+ */
+enum splp_keyword
+{
+	SPLP_KEYWORD_CONNECT,
+	SPLP_KEYWORD_CONNECT_OK,
+	SPLP_KEYWORD_GET_VER,
+	SPLP_KEYWORD_GET_DATA,
+	SPLP_KEYWORD_GET_COMMAND,
+	SPLP_KEYWORD_GET_FILE,
+	SPLP_KEYWORD_GET_B64,
+	SPLP_KEYWORD_DISCONNECT,
+	SPLP_KEYWORD_VERSION,
+	SPLP_KEYWORD_GET_DATA_REPLY,
+	SPLP_KEYWORD_GET_COMMAND_REPLY,
+	SPLP_KEYWORD_GET_FILE_REPLY,
+	SPLP_KEYWORD_B64,
+	SPLP_KEYWORD_DISCONNECT_OK,
+	SPLP_KEYWORD_COUNT
+};
+
+
+/* SplpResult
+ * What an accepted message carries. The payload is given by its offset
+ * and length inside the message text: the data of a GET_* reply, the
+ * number of VERSION or the base64 string of B64:, including the '='
+ * padding. Messages without a payload have an empty one at offset 0.
+ */
+struct SplpResult
+{
+	enum splp_keyword	type;
+	size_t			payload_offset;
+	size_t			payload_length;
+	uint64_t		version;          /* VERSION number, UINT64_MAX if it is larger; 0 for other messages */
+};
+
+
+/* SplpSession
+ * State of a single SPLPv1 connection. validate_message() keeps one
+ * such session internally; callers which track several connections
+ * keep a session per connection and use splp_validate().
+ */
+struct SplpSession
+{
+	unsigned char	state;            /* protocol state, 1 (INIT) .. 7 */
+	unsigned char	command;          /* pending GET_* request, 0 if none */
+	unsigned char	position;         /* position inside a streamed message (splp_dfa.h) */
+};
+
+
 extern enum test_status validate_message( struct Message* pMessage ); 
+
+extern void splp_session_init( struct SplpSession* pSession );
+
+extern enum test_status splp_validate( struct SplpSession* pSession, const struct Message* pMessage );
+
+extern enum test_status splp_validate_view( struct SplpSession* pSession, const struct MessageView* pView );
+
+/* Same as splp_validate() and splp_validate_view(), and for a valid
+ * message pResult is filled in; it is left as is for an invalid one.
+ */
+extern enum test_status splp_validate_ex( struct SplpSession* pSession, const struct Message* pMessage,
+	struct SplpResult* pResult );
+
+extern enum test_status splp_validate_view_ex( struct SplpSession* pSession, const struct MessageView* pView,
+	struct SplpResult* pResult );
+
+/* Same as splp_validate_view(), and the payload of a valid B64: message
+ * is decoded into pDecoded, which must hold
+ * SPLP_BASE64_DECODED_MAX( pView->length ) bytes (splp_charclass.h).
+ */
+extern enum test_status splp_validate_view_decode( struct SplpSession* pSession, const struct MessageView* pView,
+	unsigned char* pDecoded, size_t* pDecodedLength );
+
+
+/* Verdict bitmaps
+ * Batch validation stores one bit per message: bit (i % 64) of word
+ * (i / 64) is set when message i is MESSAGE_VALID. Unused bits of the
+ * last word are cleared.
+ */
+#define SPLP_VERDICT_WORDS( count )   ( ( ( count ) + 63 ) / 64 )
+
+extern void splp_validate_batch( struct SplpSession* pSession, const struct Message* pMessages,
+	size_t count, uint64_t* pVerdicts );
+
+extern void splp_validate_view_batch( struct SplpSession* pSession, const struct MessageView* pViews,
+	size_t count, uint64_t* pVerdicts );
+
+extern void splp_validate_block( struct SplpSession* pSession, const struct MessageBlock* pBlock,
+	uint64_t* pVerdicts );
+
+#endif /* SPLPV1_H */
+